@@ -1,11 +1,13 @@
 #include "cavs/frontend/cxx/sym.h"
 #include "cavs/frontend/cxx/graphsupport.h"
+#include "cavs/frontend/cxx/batch_sampler.h"
 #include "cavs/frontend/cxx/session.h"
 #include "cavs/proto/opt.pb.h"
 #include "cavs/util/timing.h"
 
 #include <iostream>
 #include <fstream>
+#include <numeric>
 #include <vector>
 
 using namespace std;
@@ -21,47 +23,69 @@ DEFINE_double(lr,          1.f,      "learning rate");
 DEFINE_string(file_docs,
     "/users/shizhenx/projects/Cavs/apps/lstm/data/train_to_idx.txt",
     "ptb_file");
+DEFINE_double(bucket_randomness, -1, "bucket the sentences by length, negative to disable");
 
 const int MAX_LENGTH = 83;
 
+//the samples of a batch are consecutive lines, or bucketed by length
+//with bucket_randomness >= 0 so that they take similar numbers of rounds
 void load(vector<vector<float>>* input_ph, vector<vector<float>>* label_ph, vector<vector<int>>* graph_ph) {
   ifstream file(FLAGS_file_docs);
   string s;
   CHECK(input_ph->empty());
   CHECK(label_ph->empty());
   CHECK(graph_ph->empty());
-  bool end = false;
-  while (!end) {
+  vector<vector<float>> sentences;
+  while (getline(file, s)) {
+    stringstream ss(s);
+    vector<float> sentence;
+    float idx = 0;
+    while (ss >> idx)
+      sentence.push_back(idx);
+    if (!sentence.empty())
+      sentences.push_back(std::move(sentence));
+  }
+
+  vector<vector<int>> batches;
+  if (FLAGS_bucket_randomness < 0) {
+    for (int b = 0; b+FLAGS_batch <= (int)sentences.size(); b += FLAGS_batch) {
+      batches.emplace_back(FLAGS_batch);
+      std::iota(batches.back().begin(), batches.back().end(), b);
+    }
+  }else {
+    vector<SampleShape> shapes;
+    for (auto& sentence : sentences)
+      shapes.push_back(SequenceShape(sentence.size()));
+    BatchSampler sampler(shapes, FLAGS_batch, FLAGS_bucket_randomness);
+    float efficiency = 0.f;
+    for (int b = 0; b < sampler.batches_per_epoch(); b++) {
+      BatchStats stats;
+      batches.push_back(sampler.Next(&stats));
+      efficiency += stats.efficiency;
+    }
+    LOG(INFO) << "Bucketed " << batches.size() << " batches, efficiency: "
+              << efficiency/batches.size();
+  }
+
+  for (auto& batch : batches) {
     vector<float> input_line(MAX_LENGTH*FLAGS_batch, -1);
     vector<float> label_line(MAX_LENGTH*FLAGS_batch, -1);
     vector<int>   graph_line(MAX_LENGTH*FLAGS_batch, -1);
     int outer_offset = 0;
     for (int sample_id = 0; sample_id < FLAGS_batch; sample_id++) {
-      if (!getline(file, s)) {
-        end = true;
-        break; 
-      }
-      stringstream ss(s);
-      float idx = 0;
-      int current_offset = 0;
-      while (ss >> idx) {
-        input_line[current_offset + outer_offset] = idx;
-        current_offset++;
-      }
+      const vector<float>& sentence = sentences[batch[sample_id]];
+      int current_offset = sentence.size();
+      CHECK(current_offset <= MAX_LENGTH);
+      std::copy(sentence.begin(), sentence.end(), input_line.begin()+outer_offset);
       memcpy(label_line.data()+outer_offset, input_line.data()+outer_offset+1, (current_offset-1)*sizeof(float));
       for (int i = 1; i < current_offset; i++) {
         graph_line[i-1+sample_id*MAX_LENGTH] = i;
       }
       outer_offset += current_offset;
     }
-
-    if (end) {
-      break;
-    }else {
-      input_ph->push_back(std::move(input_line));
-      label_ph->push_back(std::move(label_line));
-      graph_ph->push_back(std::move(graph_line));
-    }
+    input_ph->push_back(std::move(input_line));
+    label_ph->push_back(std::move(label_line));
+    graph_ph->push_back(std::move(graph_line));
   }
 }
 
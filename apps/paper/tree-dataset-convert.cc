@@ -0,0 +1,16 @@
+#include "cavs/frontend/cxx/tree_dataset.h"
+#include "cavs/util/logging.h"
+
+DEFINE_string(input_file,  "", "input sentences(sents_idx.txt)");
+DEFINE_string(label_file,  "", "labels(labels.txt)");
+DEFINE_string(graph_file,  "", "graph dependency(parents.txt)");
+DEFINE_string(output_file, "", "binary tree dataset");
+
+int main(int argc, char* argv[]) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  CHECK(!FLAGS_input_file.empty() && !FLAGS_label_file.empty() &&
+        !FLAGS_graph_file.empty() && !FLAGS_output_file.empty());
+  TreeDataset::Convert(FLAGS_input_file, FLAGS_label_file,
+                       FLAGS_graph_file, FLAGS_output_file);
+  return 0;
+}
@@ -1,10 +1,12 @@
 #include "cavs/frontend/cxx/sym.h"
 #include "cavs/frontend/cxx/graphsupport.h"
 #include "cavs/frontend/cxx/session.h"
+#include "cavs/frontend/cxx/tree_dataset.h"
 #include "cavs/proto/opt.pb.h"
 
 #include <iostream>
 #include <fstream>
+#include <memory>
 #include <vector>
 
 using namespace std;
@@ -26,6 +28,8 @@ int NUM_SAMPLES = 8544;
 DEFINE_string(input_file, "/users/shizhenx/projects/Cavs/apps/lstm/data/sst/train/sents_idx.txt", "input sentences");
 DEFINE_string(label_file, "/users/shizhenx/projects/Cavs/apps/lstm/data/sst/train/labels.txt",    "label sentences");
 DEFINE_string(graph_file, "/users/shizhenx/projects/Cavs/apps/lstm/data/sst/train/parents.txt",   "graph dependency");
+DEFINE_string(dataset_file, "", "binary dataset from tree-dataset-convert, replaces the text files");
+DEFINE_double(bucket_randomness, -1, "bucket the trees of the dataset_file by shape, negative to disable");
 
 class Reader {
  public:
@@ -212,9 +216,43 @@ int main(int argc, char* argv[]) {
   vector<int>   graph_data(FLAGS_batch_size*MAX_DEPENDENCY, -1);
   //for (int i = 0; i < 33; i++)
     //sst_reader.next_batch(&graph_data, &input_data, &label_data);
+  //the next batch is read ahead, so that its schedule is prepared
+  //while the current one executes
+  vector<float> next_input_data(input_data.size());
+  vector<float> next_label_data(label_data.size());
+  vector<int>   next_graph_data(graph_data.size());
+  //the binary dataset is parsed ahead on the loader thread
+  std::unique_ptr<TreeDataset> dataset;
+  std::unique_ptr<BatchSampler> sampler;
+  std::unique_ptr<TreeBatchLoader> loader;
+  if (!FLAGS_dataset_file.empty()) {
+    dataset.reset(new TreeDataset(FLAGS_dataset_file));
+    if (FLAGS_bucket_randomness >= 0) {
+      sampler.reset(new BatchSampler(dataset->Shapes(), FLAGS_batch_size, FLAGS_bucket_randomness));
+      loader.reset(new TreeBatchLoader(dataset.get(), sampler.get(), MAX_DEPENDENCY));
+    }else {
+      loader.reset(new TreeBatchLoader(dataset.get(), FLAGS_batch_size, MAX_DEPENDENCY));
+    }
+  }
+  const TreeBatch* batch = loader ? &loader->Next() : NULL;
+  if (!loader)
+    sst_reader.next_batch(&next_graph_data, &next_input_data, &next_label_data);
   for (int i = 0; i < FLAGS_epoch; i++) {
     for (int j = 0; j < iterations; j++) {
-      sst_reader.next_batch(&graph_data, &input_data, &label_data);
+      if (loader) {
+        //the batch is released by the next call of Next
+        graph_data = batch->graph;
+        input_data = batch->vertex;
+        label_data = batch->label;
+        batch = &loader->Next();
+        sess.Prefetch(graph, const_cast<int*>(batch->graph.data()));
+      }else {
+        graph_data.swap(next_graph_data);
+        input_data.swap(next_input_data);
+        label_data.swap(next_label_data);
+        sst_reader.next_batch(&next_graph_data, &next_input_data, &next_label_data);
+        sess.Prefetch(graph, next_graph_data.data());
+      }
       sess.Run({train}, {{graph,    graph_data.data()},
                          {label,    label_data.data()},
                          {word_idx, input_data.data()}});
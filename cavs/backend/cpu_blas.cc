@@ -0,0 +1,473 @@
+#include "cavs/backend/cpu_blas.h"
+#include "cavs/util/logging.h"
+#include "cavs/util/thread_pool.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CAVS_CPU_BLAS_X86
+#endif
+
+#include <string.h>
+#include <vector>
+#include <algorithm>
+
+using std::vector;
+
+namespace backend {
+
+namespace {
+
+//blocking sizes: a kKC*NR panel of B stays in L1,
+//a kMC*kKC block of A in L2
+const int kMC = 96;
+const int kKC = 256;
+const int kNC = 4096;
+//column panels handed to one task in the packed path
+const int kPanelsPerTask = 4;
+//op(A) with at most so many rows skips packing,
+//B would be streamed through once anyway
+const int kSkinnyRows = 8;
+//below this many flops the threading overhead dominates
+const int kParallelFlops = 1 << 16;
+
+template <typename T>
+struct GemmKernel {
+  int mr;
+  int nr;
+  //c[mr*nr] (leading dimension ldc) += alpha * a[kc*mr] * b[kc*nr]
+  void (*run)(int kc, const T* a, const T* b, T* c, int ldc, T alpha);
+};
+
+template <typename T, int MR, int NR>
+void KernelGeneric(int kc, const T* a, const T* b, T* c, int ldc, T alpha) {
+  T acc[MR][NR] = {};
+  for (int k = 0; k < kc; k++) {
+    for (int r = 0; r < MR; r++) {
+      const T av = a[k*MR+r];
+      for (int j = 0; j < NR; j++)
+        acc[r][j] += av * b[k*NR+j];
+    }
+  }
+  for (int r = 0; r < MR; r++)
+    for (int j = 0; j < NR; j++)
+      c[r*ldc+j] += alpha * acc[r][j];
+}
+
+template <typename T>
+void AxpyGeneric(int n, T alpha, const T* x, T* y) {
+  for (int i = 0; i < n; i++)
+    y[i] += alpha * x[i];
+}
+
+template <typename T>
+T DotGeneric(int n, const T* x, const T* y) {
+  T sum = 0;
+  for (int i = 0; i < n; i++)
+    sum += x[i] * y[i];
+  return sum;
+}
+
+#ifdef CAVS_CPU_BLAS_X86
+__attribute__((target("avx2,fma")))
+void SgemmKernelAVX2(int kc, const float* a, const float* b,
+    float* c, int ldc, float alpha) {
+  //6x16 tile, 12 ymm accumulators
+  __m256 acc[6][2];
+  for (int r = 0; r < 6; r++) {
+    acc[r][0] = _mm256_setzero_ps();
+    acc[r][1] = _mm256_setzero_ps();
+  }
+  for (int k = 0; k < kc; k++) {
+    const __m256 b0 = _mm256_loadu_ps(b);
+    const __m256 b1 = _mm256_loadu_ps(b+8);
+    for (int r = 0; r < 6; r++) {
+      const __m256 av = _mm256_broadcast_ss(a+r);
+      acc[r][0] = _mm256_fmadd_ps(av, b0, acc[r][0]);
+      acc[r][1] = _mm256_fmadd_ps(av, b1, acc[r][1]);
+    }
+    a += 6;
+    b += 16;
+  }
+  const __m256 va = _mm256_set1_ps(alpha);
+  for (int r = 0; r < 6; r++) {
+    float* cr = c + r*ldc;
+    _mm256_storeu_ps(cr,   _mm256_fmadd_ps(va, acc[r][0], _mm256_loadu_ps(cr)));
+    _mm256_storeu_ps(cr+8, _mm256_fmadd_ps(va, acc[r][1], _mm256_loadu_ps(cr+8)));
+  }
+}
+
+__attribute__((target("avx512f")))
+void SgemmKernelAVX512(int kc, const float* a, const float* b,
+    float* c, int ldc, float alpha) {
+  //6x32 tile, 12 zmm accumulators
+  __m512 acc[6][2];
+  for (int r = 0; r < 6; r++) {
+    acc[r][0] = _mm512_setzero_ps();
+    acc[r][1] = _mm512_setzero_ps();
+  }
+  for (int k = 0; k < kc; k++) {
+    const __m512 b0 = _mm512_loadu_ps(b);
+    const __m512 b1 = _mm512_loadu_ps(b+16);
+    for (int r = 0; r < 6; r++) {
+      const __m512 av = _mm512_set1_ps(a[r]);
+      acc[r][0] = _mm512_fmadd_ps(av, b0, acc[r][0]);
+      acc[r][1] = _mm512_fmadd_ps(av, b1, acc[r][1]);
+    }
+    a += 6;
+    b += 32;
+  }
+  const __m512 va = _mm512_set1_ps(alpha);
+  for (int r = 0; r < 6; r++) {
+    float* cr = c + r*ldc;
+    _mm512_storeu_ps(cr,    _mm512_fmadd_ps(va, acc[r][0], _mm512_loadu_ps(cr)));
+    _mm512_storeu_ps(cr+16, _mm512_fmadd_ps(va, acc[r][1], _mm512_loadu_ps(cr+16)));
+  }
+}
+
+//the skinny path is memory bound, wider vectors buy little there
+__attribute__((target("avx2,fma")))
+void SaxpyAVX2(int n, float alpha, const float* x, float* y) {
+  const __m256 va = _mm256_set1_ps(alpha);
+  int i = 0;
+  for (; i+8 <= n; i += 8)
+    _mm256_storeu_ps(y+i, _mm256_fmadd_ps(va, _mm256_loadu_ps(x+i), _mm256_loadu_ps(y+i)));
+  for (; i < n; i++)
+    y[i] += alpha * x[i];
+}
+
+__attribute__((target("avx2,fma")))
+float SdotAVX2(int n, const float* x, const float* y) {
+  __m256 acc0 = _mm256_setzero_ps();
+  __m256 acc1 = _mm256_setzero_ps();
+  int i = 0;
+  for (; i+16 <= n; i += 16) {
+    acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(x+i),   _mm256_loadu_ps(y+i),   acc0);
+    acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(x+i+8), _mm256_loadu_ps(y+i+8), acc1);
+  }
+  acc0 = _mm256_add_ps(acc0, acc1);
+  float buf[8];
+  _mm256_storeu_ps(buf, acc0);
+  float sum = 0;
+  for (int j = 0; j < 8; j++)
+    sum += buf[j];
+  for (; i < n; i++)
+    sum += x[i] * y[i];
+  return sum;
+}
+
+bool HasAVX2() {
+  return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+}
+
+bool HasAVX512() {
+  return __builtin_cpu_supports("avx512f");
+}
+#endif
+
+template <typename T>
+struct VectorOps {
+  void (*axpy)(int n, T alpha, const T* x, T* y);
+  T (*dot)(int n, const T* x, const T* y);
+};
+
+template <typename T>
+GemmKernel<T> SelectKernel() {
+  return GemmKernel<T>{4, 8, KernelGeneric<T, 4, 8>};
+}
+
+template <>
+GemmKernel<float> SelectKernel<float>() {
+#ifdef CAVS_CPU_BLAS_X86
+  if (HasAVX512()) {
+    VLOG(V_DEBUG) << "sgemm with the avx512 micro-kernel";
+    return GemmKernel<float>{6, 32, SgemmKernelAVX512};
+  }
+  if (HasAVX2()) {
+    VLOG(V_DEBUG) << "sgemm with the avx2 micro-kernel";
+    return GemmKernel<float>{6, 16, SgemmKernelAVX2};
+  }
+#endif
+  return GemmKernel<float>{4, 8, KernelGeneric<float, 4, 8>};
+}
+
+template <typename T>
+VectorOps<T> SelectVectorOps() {
+  return VectorOps<T>{AxpyGeneric<T>, DotGeneric<T>};
+}
+
+template <>
+VectorOps<float> SelectVectorOps<float>() {
+#ifdef CAVS_CPU_BLAS_X86
+  if (HasAVX2())
+    return VectorOps<float>{SaxpyAVX2, SdotAVX2};
+#endif
+  return VectorOps<float>{AxpyGeneric<float>, DotGeneric<float>};
+}
+
+//C = beta*C, with beta == 0 overwriting NaNs as BLAS does
+template <typename T>
+void ScaleC(int M, int N, T beta, T* C) {
+  if (beta == T(1)) return;
+  const int grain = std::max(1, kParallelFlops / std::max(N, 1));
+  ThreadPool::Get()->ParallelFor(M, grain, [=](int begin, int end) {
+    for (int i = begin; i < end; i++) {
+      T* c = C + (size_t)i*N;
+      if (beta == T(0))
+        memset(c, 0, N*sizeof(T));
+      else
+        for (int j = 0; j < N; j++) c[j] *= beta;
+    }
+  });
+}
+
+//rows [i0, i0+rows) and columns [k0, k0+kc) of op(A),
+//laid out k-major in an mr-wide panel padded with zeros
+template <typename T>
+void PackAPanel(bool TransA, int M, int K, const T* A,
+    int i0, int rows, int k0, int kc, int mr, T* dst) {
+  if (!TransA) {
+    for (int r = 0; r < rows; r++) {
+      const T* src = A + (size_t)(i0+r)*K + k0;
+      for (int k = 0; k < kc; k++)
+        dst[k*mr+r] = src[k];
+    }
+  }else {
+    for (int k = 0; k < kc; k++) {
+      const T* src = A + (size_t)(k0+k)*M + i0;
+      for (int r = 0; r < rows; r++)
+        dst[k*mr+r] = src[r];
+    }
+  }
+  for (int k = 0; k < kc && rows < mr; k++)
+    for (int r = rows; r < mr; r++)
+      dst[k*mr+r] = 0;
+}
+
+//rows [k0, k0+kc) and columns [j0, j0+cols) of op(B),
+//laid out k-major in an nr-wide panel padded with zeros
+template <typename T>
+void PackBPanel(bool TransB, int N, int K, const T* B,
+    int k0, int kc, int j0, int cols, int nr, T* dst) {
+  if (!TransB) {
+    for (int k = 0; k < kc; k++) {
+      const T* src = B + (size_t)(k0+k)*N + j0;
+      memcpy(dst+k*nr, src, cols*sizeof(T));
+      for (int j = cols; j < nr; j++)
+        dst[k*nr+j] = 0;
+    }
+  }else {
+    for (int j = 0; j < cols; j++) {
+      const T* src = B + (size_t)(j0+j)*K + k0;
+      for (int k = 0; k < kc; k++)
+        dst[k*nr+j] = src[k];
+    }
+    for (int k = 0; k < kc && cols < nr; k++)
+      for (int j = cols; j < nr; j++)
+        dst[k*nr+j] = 0;
+  }
+}
+
+//the rows of op(A) and C of one product, several of them
+//sharing the same B are run as a single stacked product
+template <typename T>
+struct RowBlock {
+  const T* A;
+  T* C;
+  int M;
+};
+
+template <typename T>
+void GemmPacked(bool TransA, bool TransB, const vector<RowBlock<T>>& blocks,
+    int N, int K, T alpha, const T* B) {
+  static const GemmKernel<T> kernel = SelectKernel<T>();
+  const int mr = kernel.mr;
+  const int nr = kernel.nr;
+  //row panels never straddle two blocks, their C differ
+  vector<std::pair<int, int>> panels;
+  for (size_t b = 0; b < blocks.size(); b++)
+    for (int i0 = 0; i0 < blocks[b].M; i0 += mr)
+      panels.emplace_back(b, i0);
+  const int m_panels = panels.size();
+  const int panels_per_block = std::max(1, kMC/mr);
+  const int m_blocks = (m_panels+panels_per_block-1)/panels_per_block;
+  const std::pair<int, int>* pl = panels.data();
+  const RowBlock<T>* bl = blocks.data();
+  ThreadPool* pool = ThreadPool::Get();
+
+  //the packing buffers are reused across calls on the same thread
+  thread_local vector<T> packed_a;
+  thread_local vector<T> packed_b;
+  for (int jc = 0; jc < N; jc += kNC) {
+    const int nc = std::min(kNC, N-jc);
+    const int n_panels = (nc+nr-1)/nr;
+    const int n_groups = (n_panels+kPanelsPerTask-1)/kPanelsPerTask;
+    for (int pc = 0; pc < K; pc += kKC) {
+      const int kc = std::min(kKC, K-pc);
+      packed_b.resize((size_t)n_panels*kc*nr);
+      packed_a.resize((size_t)m_panels*kc*mr);
+      T* pb = packed_b.data();
+      T* pa = packed_a.data();
+      pool->ParallelFor(n_panels, 8, [=](int begin, int end) {
+        for (int q = begin; q < end; q++) {
+          const int j0 = q*nr;
+          PackBPanel(TransB, N, K, B, pc, kc, jc+j0,
+              std::min(nr, nc-j0), nr, pb+(size_t)q*kc*nr);
+        }
+      });
+      pool->ParallelFor(m_panels, 8, [=](int begin, int end) {
+        for (int p = begin; p < end; p++) {
+          const RowBlock<T>& blk = bl[pl[p].first];
+          const int i0 = pl[p].second;
+          PackAPanel(TransA, blk.M, K, blk.A, i0, std::min(mr, blk.M-i0),
+              pc, kc, mr, pa+(size_t)p*kc*mr);
+        }
+      });
+
+      //tiles are (row block, column group) pairs, so a skinny
+      //op(A) still spreads over the threads through the columns
+      pool->ParallelFor(m_blocks*n_groups, 1, [=](int begin, int end) {
+        vector<T> edge(mr*nr);
+        for (int t = begin; t < end; t++) {
+          const int mb = t / n_groups;
+          const int ng = t % n_groups;
+          const int q_end = std::min(n_panels, (ng+1)*kPanelsPerTask);
+          const int p_end = std::min(m_panels, (mb+1)*panels_per_block);
+          for (int q = ng*kPanelsPerTask; q < q_end; q++) {
+            const int cols = std::min(nr, nc-q*nr);
+            const T* b = pb + (size_t)q*kc*nr;
+            for (int p = mb*panels_per_block; p < p_end; p++) {
+              const RowBlock<T>& blk = bl[pl[p].first];
+              const int i0 = pl[p].second;
+              const int rows = std::min(mr, blk.M-i0);
+              const T* a = pa + (size_t)p*kc*mr;
+              T* c = blk.C + (size_t)i0*N + jc + q*nr;
+              if (rows == mr && cols == nr) {
+                kernel.run(kc, a, b, c, N, alpha);
+              }else {
+                std::fill(edge.begin(), edge.end(), T(0));
+                kernel.run(kc, a, b, edge.data(), nr, alpha);
+                for (int r = 0; r < rows; r++)
+                  for (int j = 0; j < cols; j++)
+                    c[(size_t)r*N+j] += edge[r*nr+j];
+              }
+            }
+          }
+        }
+      });
+    }
+  }
+}
+
+//few rows of op(A): stream B once without packing,
+//axpy over rows of B or dots against rows of B^T
+template <typename T>
+void GemmSkinny(bool TransA, bool TransB, const vector<RowBlock<T>>& blocks,
+    int N, int K, T alpha, const T* B) {
+  static const VectorOps<T> ops = SelectVectorOps<T>();
+  //gather the rows of op(A) so that they are contiguous
+  int M = 0;
+  for (auto& blk : blocks)
+    M += blk.M;
+  vector<T> a_rows;
+  vector<RowBlock<T>> rows(blocks);
+  if (TransA) {
+    a_rows.resize((size_t)M*K);
+    T* dst = a_rows.data();
+    for (auto& blk : rows) {
+      for (int k = 0; k < K; k++)
+        for (int i = 0; i < blk.M; i++)
+          dst[(size_t)i*K+k] = blk.A[(size_t)k*blk.M+i];
+      blk.A = dst;
+      dst += (size_t)blk.M*K;
+    }
+  }
+  const RowBlock<T>* bl = rows.data();
+  const int n_blocks = rows.size();
+  const int grain = std::max(64, kParallelFlops / std::max(M*K, 1));
+  //the column slice of B stays in cache across all the blocks
+  ThreadPool::Get()->ParallelFor(N, grain, [=](int begin, int end) {
+    for (int b = 0; b < n_blocks; b++) {
+      for (int i = 0; i < bl[b].M; i++) {
+        const T* ai = bl[b].A + (size_t)i*K;
+        T* ci = bl[b].C + (size_t)i*N;
+        if (!TransB) {
+          for (int k = 0; k < K; k++) {
+            if (ai[k] != T(0))
+              ops.axpy(end-begin, alpha*ai[k], B+(size_t)k*N+begin, ci+begin);
+          }
+        }else {
+          for (int j = begin; j < end; j++)
+            ci[j] += alpha * ops.dot(K, ai, B+(size_t)j*K);
+        }
+      }
+    }
+  });
+}
+
+template <typename T>
+void Gemm(bool TransA, bool TransB, const vector<RowBlock<T>>& blocks,
+    int N, int K, T alpha, const T* B, T beta) {
+  CHECK(N >= 0 && K >= 0);
+  int M = 0;
+  for (auto& blk : blocks) {
+    CHECK(blk.M >= 0);
+    M += blk.M;
+  }
+  if (M == 0 || N == 0) return;
+  for (auto& blk : blocks)
+    ScaleC(blk.M, N, beta, blk.C);
+  if (K == 0 || alpha == T(0)) return;
+  if (M <= kSkinnyRows)
+    GemmSkinny(TransA, TransB, blocks, N, K, alpha, B);
+  else
+    GemmPacked(TransA, TransB, blocks, N, K, alpha, B);
+}
+
+template <typename T>
+void GemmStacked(bool TransB, int count, const int* M, int N, int K,
+    T alpha, const T* const* A, const T* B, T beta, T* const* C) {
+  vector<RowBlock<T>> blocks;
+  for (int i = 0; i < count; i++)
+    blocks.push_back(RowBlock<T>{A[i], C[i], M[i]});
+  Gemm<T>(false, TransB, blocks, N, K, alpha, B, beta);
+}
+
+} //namespace
+
+template <>
+void MatMulMatCpuWrapper<float>(
+    const bool TransA, const bool TransB,
+    const int M, const int N, const int K,
+    const float alpha, const float* A, const float* B,
+    const float beta, float* C) {
+  Gemm<float>(TransA, TransB, {RowBlock<float>{A, C, M}}, N, K, alpha, B, beta);
+}
+
+template <>
+void MatMulMatCpuWrapper<double>(
+    const bool TransA, const bool TransB,
+    const int M, const int N, const int K,
+    const double alpha, const double* A, const double* B,
+    const double beta, double* C) {
+  Gemm<double>(TransA, TransB, {RowBlock<double>{A, C, M}}, N, K, alpha, B, beta);
+}
+
+template <>
+void MatMulMatStackedCpuWrapper<float>(
+    const bool TransB, const int count,
+    const int* M, const int N, const int K,
+    const float alpha, const float* const* A, const float* B,
+    const float beta, float* const* C) {
+  GemmStacked<float>(TransB, count, M, N, K, alpha, A, B, beta, C);
+}
+
+template <>
+void MatMulMatStackedCpuWrapper<double>(
+    const bool TransB, const int count,
+    const int* M, const int N, const int K,
+    const double alpha, const double* const* A, const double* B,
+    const double beta, double* const* C) {
+  GemmStacked<double>(TransB, count, M, N, K, alpha, A, B, beta, C);
+}
+
+} //namespace backend
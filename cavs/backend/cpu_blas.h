@@ -0,0 +1,27 @@
+#ifndef CAVS_BACKEND_CPU_BLAS_H_
+#define CAVS_BACKEND_CPU_BLAS_H_
+
+namespace backend {
+
+//host counterpart of MatMulMatCublasWrapper, row-major as well.
+//C = alpha*op(A)*op(B) + beta*C, op(A) is M*K and op(B) is K*N
+template <typename T>
+void MatMulMatCpuWrapper(
+    const bool TransA, const bool TransB,
+    const int M, const int N, const int K,
+    const T alpha, const T* A, const T* B,
+    const T beta, T* C);
+
+//C[i] = alpha*A[i]*op(B) + beta*C[i] for count products sharing B,
+//A[i] is M[i]*K. op(B) is packed once and the rows of all
+//the products are spread over the threads as one gemm
+template <typename T>
+void MatMulMatStackedCpuWrapper(
+    const bool TransB, const int count,
+    const int* M, const int N, const int K,
+    const T alpha, const T* const* A, const T* B,
+    const T beta, T* const* C);
+
+} //namespace backend
+
+#endif
@@ -1,11 +1,14 @@
 #ifndef CAVS_BACKEND_CUDARTC_WRAPPER_H_
 #define CAVS_BACKEND_CUDARTC_WRAPPER_H_
 
+#include "cavs/backend/kernel_cache.h"
 #include "cavs/util/macros_gpu.h"
+#include "cavs/util/thread_pool.h"
 
 #include <cuda.h>
 #include <nvrtc.h>
 #include <vector>
+#include <string>
 
 #define checkNVRTCError(stmt)                   \
     do {                                        \
@@ -35,42 +38,34 @@ class CudaRTCWrapper {
  public:
   CudaRTCWrapper() : module_loaded_(false), kernel_(NULL) {}
   ~CudaRTCWrapper() {
+    if (compilation_.valid()) compilation_.Wait();
     if (module_loaded_) {
       checkCUDADriverError(cuModuleUnload(module_));
     }
   }
   void Compile(const std::string& name, const std::string& src) {
-    nvrtcProgram prog;
-    checkNVRTCError(nvrtcCreateProgram(&prog, src.c_str(),
-                                       ("cavs_" + name + ".cu").c_str(),
-                                       0, NULL, NULL));
-    const int flags_num = 2;
-    const char *compiler_flags[] =
-      {"--gpu-architecture=compute_52", "--fmad=false"};
-    nvrtcResult compile_result = nvrtcCompileProgram(prog, flags_num, compiler_flags);
-    if (compile_result != NVRTC_SUCCESS) {
-      size_t log_size;
-      checkNVRTCError(nvrtcGetProgramLogSize(prog, &log_size));
-      std::vector<char> nvrtc_log(log_size);
-      checkNVRTCError(nvrtcGetProgramLog(prog, nvrtc_log.data()));
-      LOG(FATAL) << "Compile Error:\n"
-                 << nvrtcGetErrorString(compile_result)
-                 << "\nKernel Source:\n"
-                 << nvrtc_log.data();
-    }
-
-    size_t ptx_size;
-    checkNVRTCError(nvrtcGetPTXSize(prog, &ptx_size));
-    std::vector<char> nvrtc_ptx(ptx_size);
-    checkNVRTCError(nvrtcGetPTX(prog, nvrtc_ptx.data()));
-    checkNVRTCError(nvrtcDestroyProgram(&prog));
-
+    CompileAsync(name, src);
+    Wait();
+  }
+  //only the ptx is generated on the thread pool, the module is
+  //loaded by the thread calling Wait(), which holds the cuda context
+  void CompileAsync(const std::string& name, const std::string& src) {
+    name_ = name;
+    compilation_ = ThreadPool::Get()->Async(
+        [this, src]() { ptx_ = GeneratePTX(name_, src); });
+  }
+  void Wait() {
+    if (!compilation_.valid())
+      return;
+    compilation_.Wait();
+    compilation_ = AsyncTask();
     if (module_loaded_) {
       checkCUDADriverError(cuModuleUnload(module_));
     }
-    checkCUDADriverError(cuModuleLoadDataEx(&module_, nvrtc_ptx.data(), 0, 0, 0));
+    checkCUDADriverError(cuModuleLoadDataEx(&module_, ptx_.data(), 0, 0, 0));
     module_loaded_ = true;
-    checkCUDADriverError(cuModuleGetFunction(&kernel_, module_, name.c_str()));
+    checkCUDADriverError(cuModuleGetFunction(&kernel_, module_, name_.c_str()));
+    ptx_.clear();
   }
 
   void Launch(const std::vector<void*>& outputs,
@@ -99,9 +94,55 @@ class CudaRTCWrapper {
   }
 
  private:
+  static std::string GeneratePTX(const std::string& name, const std::string& src) {
+    const int flags_num = 2;
+    const char *compiler_flags[] =
+      {"--gpu-architecture=compute_52", "--fmad=false"};
+    int major, minor;
+    checkNVRTCError(nvrtcVersion(&major, &minor));
+    const std::string key = KernelCache::Key(src,
+        std::string(compiler_flags[0]) + " " + compiler_flags[1],
+        "nvrtc-" + std::to_string(major) + "." + std::to_string(minor));
+    std::string ptx;
+    if (!KernelCache::Get()->Lookup(key, &ptx)) {
+      ptx = CompileToPTX(name, src, flags_num, compiler_flags);
+      KernelCache::Get()->Insert(key, ptx);
+    }
+    return ptx;
+  }
+  static std::string CompileToPTX(const std::string& name, const std::string& src,
+                                  int flags_num, const char** compiler_flags) {
+    nvrtcProgram prog;
+    checkNVRTCError(nvrtcCreateProgram(&prog, src.c_str(),
+                                       ("cavs_" + name + ".cu").c_str(),
+                                       0, NULL, NULL));
+    nvrtcResult compile_result = nvrtcCompileProgram(prog, flags_num, compiler_flags);
+    if (compile_result != NVRTC_SUCCESS) {
+      size_t log_size;
+      checkNVRTCError(nvrtcGetProgramLogSize(prog, &log_size));
+      std::vector<char> nvrtc_log(log_size);
+      checkNVRTCError(nvrtcGetProgramLog(prog, nvrtc_log.data()));
+      LOG(FATAL) << "Compile Error:\n"
+                 << nvrtcGetErrorString(compile_result)
+                 << "\nKernel Source:\n"
+                 << nvrtc_log.data();
+    }
+
+    size_t ptx_size;
+    checkNVRTCError(nvrtcGetPTXSize(prog, &ptx_size));
+    std::vector<char> nvrtc_ptx(ptx_size);
+    checkNVRTCError(nvrtcGetPTX(prog, nvrtc_ptx.data()));
+    checkNVRTCError(nvrtcDestroyProgram(&prog));
+    //the ptx is null terminated, which cuModuleLoadDataEx relies on
+    return std::string(nvrtc_ptx.data(), ptx_size);
+  }
+
   CUmodule module_;
   bool module_loaded_;
   CUfunction kernel_;
+  std::string name_;
+  std::string ptx_;
+  AsyncTask compilation_;
 };
 
 } //namespace RTC
@@ -0,0 +1,92 @@
+#ifndef CAVS_BACKEND_FUNCTOR_BATCHED_MEMCPY_CPU_H_
+#define CAVS_BACKEND_FUNCTOR_BATCHED_MEMCPY_CPU_H_
+
+#include "cavs/util/macros.h"
+#include "cavs/util/thread_pool.h"
+
+#include <string.h>
+#include <algorithm>
+
+namespace backend {
+
+//host counterparts of the kernels in functor_batched_memcpy.cuh.
+//the tensor ids are taken from the graph scheduler as they are,
+//every selected row is one memcpy, and the source row a few
+//iterations ahead is prefetched since the ids are scattered.
+//rows are split over the thread pool once the batch is big enough.
+const int kRowPrefetchDistance = 4;
+const size_t kRowCopyParallelBytes = 1 << 16;
+
+template <typename FUNC>
+FORCE_INLINE void RowParallelFor(int rows, size_t row_bytes, const FUNC& func) {
+  const int grain = std::max<size_t>(1, kRowCopyParallelBytes/std::max<size_t>(row_bytes, 1));
+  if (rows < 2*grain) {
+    func(0, rows);
+  }else {
+    ThreadPool::Get()->ParallelFor(rows, grain,
+        [&func](int begin, int end) { func(begin, end); });
+  }
+}
+
+FORCE_INLINE void PrefetchRow(const void* row, size_t bytes) {
+  //the first lines are enough for the hardware prefetcher to pick up the rest
+  const char* p = (const char*)row;
+  const size_t lines = std::min<size_t>((bytes+63)/64, 4);
+  for (size_t l = 0; l < lines; l++)
+    __builtin_prefetch(p + l*64);
+}
+
+//contiguous copy of n elements, split for big buffers
+template <typename T>
+void ContinuousMemcpyCpu(T* out, const T* inp, size_t n) {
+  const size_t chunk = kRowCopyParallelBytes/sizeof(T);
+  RowParallelFor((n+chunk-1)/chunk, chunk*sizeof(T), [=](int begin, int end) {
+    const size_t b = begin*chunk;
+    const size_t e = std::min(n, end*chunk);
+    memcpy(out+b, inp+b, (e-b)*sizeof(T));
+  });
+}
+
+//out[i] = inp[ids[i]], for i in [0, n)
+template <typename T>
+void BatchedDynamicSelectedInputSliceCopyCpu(
+    T* out, int out_stride, const T* inp, int inp_stride,
+    const int* ids, int n, int copy_length) {
+  const size_t bytes = copy_length*sizeof(T);
+  RowParallelFor(n, bytes, [=](int begin, int end) {
+    for (int i = begin; i < end; i++) {
+      if (i + kRowPrefetchDistance < end)
+        PrefetchRow(inp + (size_t)ids[i+kRowPrefetchDistance]*inp_stride, bytes);
+      memcpy(out + (size_t)i*out_stride, inp + (size_t)ids[i]*inp_stride, bytes);
+    }
+  });
+}
+
+//out[ids[i]] = inp[i], for i in [0, n)
+template <typename T>
+void BatchedDynamicSelectedOutputSliceCopyCpu(
+    T* out, int out_stride, const int* ids, const T* inp, int inp_stride,
+    int n, int copy_length) {
+  const size_t bytes = copy_length*sizeof(T);
+  RowParallelFor(n, bytes, [=](int begin, int end) {
+    for (int i = begin; i < end; i++) {
+      if (i + kRowPrefetchDistance < end)
+        PrefetchRow(out + (size_t)ids[i+kRowPrefetchDistance]*out_stride, bytes);
+      memcpy(out + (size_t)ids[i]*out_stride, inp + (size_t)i*inp_stride, bytes);
+    }
+  });
+}
+
+//zeroes the first n rows
+template <typename T>
+void BatchedDynamicAssignZeroCpu(T* out, int out_stride, int n, int copy_length) {
+  const size_t bytes = copy_length*sizeof(T);
+  RowParallelFor(n, bytes, [=](int begin, int end) {
+    for (int i = begin; i < end; i++)
+      memset(out + (size_t)i*out_stride, 0, bytes);
+  });
+}
+
+} //namespace backend
+
+#endif
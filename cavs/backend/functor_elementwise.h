@@ -10,7 +10,8 @@ namespace math {
 template <typename T>
 struct Abs {
   FORCE_INLINE __DEVICE__ static T Compute(T inp) {
-    return abs(inp);
+    //the host abs() only has the integer overload
+    return (inp < 0) ? -inp : inp;
   }
 };
 
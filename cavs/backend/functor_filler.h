@@ -2,7 +2,7 @@
 #define CAVS_BACKEND_FUNCTOR_FILLER_H_
 
 #include "cavs/util/macros.h"
-#include "cavs/util/macros_gpu.h"
+#include "cavs/util/logging.h"
 
 #include <random>
 #include <boost/random.hpp>
@@ -0,0 +1,174 @@
+#ifndef CAVS_BACKEND_HOSTRTC_WRAPPER_H_
+#define CAVS_BACKEND_HOSTRTC_WRAPPER_H_
+
+#include "cavs/backend/kernel_cache.h"
+#include "cavs/util/op_util.h"
+#include "cavs/util/logging.h"
+#include "cavs/util/thread_pool.h"
+
+#include <dlfcn.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+
+#ifndef CAVS_HOST_CXX
+#define CAVS_HOST_CXX "c++"
+#endif
+
+namespace backend {
+namespace RTC {
+
+//host counterpart of CudaRTCWrapper.
+//the source is built into a shared object by the host compiler
+//(CAVS_HOST_CXX, with CAVS_HOST_CXXFLAGS) and loaded with dlopen,
+//the shared objects are kept in the KernelCache.
+class HostRTCWrapper {
+ public:
+  typedef void (*KernelFunc)(void**, const void**, const int*, const int*,
+                             const void**, const int**, const int*,
+                             const int, const int, const int);
+  HostRTCWrapper() : handle_(NULL), kernel_(NULL) {}
+  ~HostRTCWrapper() {
+    Wait();
+    if (handle_) dlclose(handle_);
+  }
+  //compiles on the thread pool, Wait() before the first Launch
+  void CompileAsync(const std::string& name, const std::string& src) {
+    compilation_ = ThreadPool::Get()->Async(
+        [this, name, src]() { Compile(name, src); });
+  }
+  void Wait() {
+    if (compilation_.valid()) {
+      compilation_.Wait();
+      compilation_ = AsyncTask();
+    }
+  }
+  void Compile(const std::string& name, const std::string& src) {
+    char dir[] = "/tmp/cavs_rtc_XXXXXX";
+    CHECK(mkdtemp(dir)) << "Failed to create a directory for " << name;
+    const std::string base = std::string(dir) + "/cavs_" + name;
+    const std::string& target = Target();
+    const std::string key =
+      KernelCache::Key(src, Compiler() + " " + Flags(), target);
+    std::string so;
+    if (!target.empty() && KernelCache::Get()->Lookup(key, &so)) {
+      std::ofstream f(base + ".so", std::ios::binary);
+      f.write(so.data(), so.size());
+      CHECK(f.good()) << "Failed to write " << base << ".so";
+    }else {
+      {
+        std::ofstream f(base + ".cc");
+        f << src;
+        CHECK(f.good()) << "Failed to write " << base << ".cc";
+      }
+      const std::string cmd = Compiler() + " " + Flags() +
+        " -fPIC -shared -o " + base + ".so " + base + ".cc > " + base + ".log 2>&1";
+      VLOG(V_DEBUG) << cmd;
+      if (system(cmd.c_str()) != 0) {
+        std::ifstream f(base + ".log");
+        std::stringstream log;
+        log << f.rdbuf();
+        LOG(FATAL) << "Compile Error:\n"
+                   << log.str()
+                   << "\nKernel Source:\n"
+                   << src;
+      }
+      std::ifstream f(base + ".so", std::ios::binary);
+      std::stringstream bytes;
+      bytes << f.rdbuf();
+      if (!target.empty())
+        KernelCache::Get()->Insert(key, bytes.str());
+    }
+
+    if (handle_) dlclose(handle_);
+    handle_ = dlopen((base + ".so").c_str(), RTLD_NOW | RTLD_LOCAL);
+    CHECK(handle_) << dlerror();
+    kernel_ = (KernelFunc)dlsym(handle_, name.c_str());
+    CHECK(kernel_) << dlerror();
+    //the mapping stays valid after the files are gone
+    unlink((base + ".cc").c_str());
+    unlink((base + ".so").c_str());
+    unlink((base + ".log").c_str());
+    rmdir(dir);
+  }
+
+  void Launch(const std::vector<void*>& outputs,
+              const std::vector<const void*>& inputs,
+              const std::vector<int>& outputs_size,
+              const std::vector<int>& inputs_size,
+              const std::vector<const void*>& sources,
+              const std::vector<const int*>& indices,
+              const std::vector<int>& indices_size,
+              int num_elements, int begin, int end) {
+    CHECK(kernel_);
+    kernel_(const_cast<void**>(outputs.data()),
+            const_cast<const void**>(inputs.data()),
+            outputs_size.data(), inputs_size.data(),
+            const_cast<const void**>(sources.data()),
+            const_cast<const int**>(indices.data()),
+            indices_size.data(),
+            num_elements, begin, end);
+  }
+
+ private:
+  static std::string Compiler() {
+    const char* env = getenv("CAVS_HOST_CXX");
+    return env ? env : CAVS_HOST_CXX;
+  }
+  static std::string Flags() {
+    //no fast-math, the fused kernels should match the unfused ops
+    const char* env = getenv("CAVS_HOST_CXXFLAGS");
+    return env ? env : "-O3 -march=native";
+  }
+  //the flags name no ISA(-march=native) and the compiler may be upgraded,
+  //so the target is what the compiler makes of them on this host:
+  //the machine, the version and a fingerprint of the predefined macros,
+  //which list the enabled instruction sets.
+  //empty if it can not be resolved, the cache is not used then
+  static const std::string& Target() {
+    static const std::string target = ResolveTarget();
+    return target;
+  }
+  static std::string Run(const std::string& cmd) {
+    std::string out;
+    FILE* pipe = popen((cmd + " 2>/dev/null").c_str(), "r");
+    if (!pipe)
+      return out;
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), pipe)) > 0)
+      out.append(buf, n);
+    return (pclose(pipe) == 0) ? out : std::string();
+  }
+  static std::string ResolveTarget() {
+    const std::string cxx = Compiler() + " " + Flags();
+    const std::string machine = Run(Compiler() + " -dumpmachine");
+    const std::string macros = Run(cxx + " -dM -E -x c++ - < /dev/null");
+    if (machine.empty() || macros.empty()) {
+      LOG(WARNING) << "Can not resolve the target of " << cxx
+                   << ", the kernel cache is not used";
+      return std::string();
+    }
+    std::string version;
+    const size_t pos = macros.find("#define __VERSION__ ");
+    if (pos != std::string::npos)
+      version = macros.substr(pos, macros.find('\n', pos) - pos);
+    const std::string target = "host " + machine.substr(0, machine.find('\n'))
+      + " " + version + " " + GetFingerprint(macros);
+    VLOG(V_DEBUG) << "Host kernel target: " << target;
+    return target;
+  }
+
+  void* handle_;
+  KernelFunc kernel_;
+  AsyncTask compilation_;
+};
+
+} //namespace RTC
+} //namespace backend
+
+#endif
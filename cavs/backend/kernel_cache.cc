@@ -0,0 +1,140 @@
+#include "cavs/backend/kernel_cache.h"
+#include "cavs/util/op_util.h"
+#include "cavs/util/logging.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <thread>
+#include <fstream>
+#include <sstream>
+#include <functional>
+
+using std::string;
+
+namespace backend {
+namespace RTC {
+
+namespace {
+
+const char kMagic[] = "CAVSKC";
+
+bool MakeDirs(const string& path) {
+  for (size_t pos = 1; pos != string::npos; pos++) {
+    pos = path.find('/', pos);
+    const string prefix = path.substr(0, pos);
+    if (mkdir(prefix.c_str(), 0755) != 0 && errno != EEXIST)
+      return false;
+    if (pos == string::npos)
+      break;
+  }
+  return true;
+}
+
+} //namespace
+
+KernelCache::KernelCache() {
+  const char* env = getenv("CAVS_KERNEL_CACHE_DIR");
+  if (env) {
+    dir_ = env;
+  }else if (getenv("HOME")) {
+    dir_ = string(getenv("HOME")) + "/.cache/cavs/kernels";
+  }else {
+    dir_ = "/tmp/cavs_kernels";
+  }
+  if (!dir_.empty() && !MakeDirs(dir_)) {
+    LOG(WARNING) << "Kernel cache disabled, can not create " << dir_;
+    dir_.clear();
+  }
+  VLOG(V_DEBUG) << "Kernel cache directory: " << dir_;
+}
+
+string KernelCache::Key(const string& source,
+                        const string& flags,
+                        const string& target) {
+  return "version: " + std::to_string(kVersion) + "\n"
+       + "target: "  + target + "\n"
+       + "flags: "   + flags  + "\n"
+       + source;
+}
+
+string KernelCache::EntryPath(const string& key) const {
+  return dir_ + "/" + GetFingerprint(key) + ".kernel";
+}
+
+//an entry is the magic, the version, the key and the artifact,
+//the key is kept in full so that fingerprint collisions are detected
+bool KernelCache::Lookup(const string& key, string* artifact) {
+  if (!enabled())
+    return false;
+  std::ifstream f(EntryPath(key), std::ios::binary | std::ios::ate);
+  if (!f.is_open())
+    return false;
+  const uint64_t file_size = f.tellg();
+  f.seekg(0);
+  char magic[sizeof(kMagic)];
+  int version;
+  uint64_t key_size, artifact_size;
+  f.read(magic, sizeof(magic));
+  f.read((char*)&version, sizeof(version));
+  f.read((char*)&key_size, sizeof(key_size));
+  if (!f.good() || string(magic, sizeof(magic)) != string(kMagic, sizeof(kMagic)) ||
+      version != kVersion || key_size != key.size()) {
+    VLOG(V_DEBUG) << "Stale kernel cache entry " << EntryPath(key);
+    return false;
+  }
+  string stored_key(key_size, '\0');
+  f.read(&stored_key[0], key_size);
+  f.read((char*)&artifact_size, sizeof(artifact_size));
+  if (!f.good() || stored_key != key)
+    return false;
+  //a truncated or corrupt entry must not make us allocate its size
+  if (artifact_size != file_size - (uint64_t)f.tellg()) {
+    VLOG(V_DEBUG) << "Corrupt kernel cache entry " << EntryPath(key);
+    return false;
+  }
+  artifact->resize(artifact_size);
+  f.read(&(*artifact)[0], artifact_size);
+  if (!f.good())
+    return false;
+  VLOG(V_DEBUG) << "Kernel cache hit " << EntryPath(key);
+  return true;
+}
+
+void KernelCache::Insert(const string& key, const string& artifact) {
+  if (!enabled())
+    return;
+  const string path = EntryPath(key);
+  //readers only ever see complete entries, the rename is atomic
+  std::stringstream tmp;
+  tmp << path << ".tmp." << getpid() << "."
+      << std::hash<std::thread::id>()(std::this_thread::get_id());
+  {
+    std::ofstream f(tmp.str(), std::ios::binary | std::ios::trunc);
+    const int version = kVersion;
+    const uint64_t key_size = key.size();
+    const uint64_t artifact_size = artifact.size();
+    f.write(kMagic, sizeof(kMagic));
+    f.write((const char*)&version, sizeof(version));
+    f.write((const char*)&key_size, sizeof(key_size));
+    f.write(key.data(), key_size);
+    f.write((const char*)&artifact_size, sizeof(artifact_size));
+    f.write(artifact.data(), artifact_size);
+    f.close();
+    if (!f.good()) {
+      LOG(WARNING) << "Failed to write the kernel cache entry " << tmp.str();
+      unlink(tmp.str().c_str());
+      return;
+    }
+  }
+  if (rename(tmp.str().c_str(), path.c_str()) != 0) {
+    LOG(WARNING) << "Failed to publish the kernel cache entry " << path;
+    unlink(tmp.str().c_str());
+  }
+}
+
+} //namespace RTC
+} //namespace backend
@@ -0,0 +1,39 @@
+#ifndef CAVS_BACKEND_KERNEL_CACHE_H_
+#define CAVS_BACKEND_KERNEL_CACHE_H_
+
+#include <string>
+
+namespace backend {
+namespace RTC {
+
+//content-addressed store of the compiled fused kernels (ptx or host
+//shared objects), shared by all processes that point at the same
+//directory (CAVS_KERNEL_CACHE_DIR, empty to disable).
+//an entry is keyed by the source, the compiler flags and the target,
+//and written atomically, so concurrent ranks can fill the cache.
+class KernelCache {
+ public:
+  static KernelCache* Get() { static KernelCache cache; return &cache; }
+  inline bool enabled() const { return !dir_.empty(); }
+  inline const std::string& dir() const { return dir_; }
+
+  //the full description of a compilation, which is stored in the entry
+  static std::string Key(const std::string& source,
+                         const std::string& flags,
+                         const std::string& target);
+  bool Lookup(const std::string& key, std::string* artifact);
+  void Insert(const std::string& key, const std::string& artifact);
+
+  //bump whenever the entry layout or the generated code changes
+  static const int kVersion = 1;
+
+ private:
+  KernelCache();
+  std::string EntryPath(const std::string& key) const;
+  std::string dir_;
+};
+
+} //namespace RTC
+} //namespace backend
+
+#endif
@@ -0,0 +1,135 @@
+#include "cavs/backend/kernel_cache.h"
+#include "cavs/backend/hostRTC_wrapper.h"
+#include "cavs/util/op_util.h"
+#include "cavs/util/logging.h"
+
+#include <dirent.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace backend::RTC;
+using std::string;
+using std::vector;
+
+string EntryPath(const string& dir, const string& key) {
+  return dir + "/" + GetFingerprint(key) + ".kernel";
+}
+
+string ReadFile(const string& path) {
+  std::ifstream f(path, std::ios::binary);
+  return string(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+}
+
+void WriteFile(const string& path, const string& bytes) {
+  std::ofstream f(path, std::ios::binary | std::ios::trunc);
+  f.write(bytes.data(), bytes.size());
+  CHECK(f.good()) << path;
+}
+
+int CountEntries(const string& dir) {
+  int count = 0;
+  DIR* d = opendir(dir.c_str());
+  CHECK(d) << dir;
+  while (struct dirent* e = readdir(d)) {
+    const string name = e->d_name;
+    if (name.size() > 7 && name.substr(name.size()-7) == ".kernel")
+      count++;
+  }
+  closedir(d);
+  return count;
+}
+
+//the entry layout: magic(7 bytes), version(int), key size(uint64),
+//key, artifact size(uint64), artifact
+const size_t kVersionOffset = 7;
+const size_t kHeaderBytes = kVersionOffset + sizeof(int) + sizeof(uint64_t);
+
+void TestEntries(KernelCache* cache) {
+  const string key = KernelCache::Key("void f() {}", "-O3", "host test");
+  const string other = KernelCache::Key("void f() {}", "-O2", "host test");
+  const string artifact = "\x7f" "ELF shared object";
+  string found;
+  CHECK(!cache->Lookup(key, &found));
+
+  cache->Insert(key, artifact);
+  CHECK(cache->Lookup(key, &found));
+  CHECK(found == artifact);
+  //the flags are part of the key
+  CHECK(!cache->Lookup(other, &found));
+
+  const string path = EntryPath(cache->dir(), key);
+  const string entry = ReadFile(path);
+  CHECK(entry.size() == kHeaderBytes + key.size() + sizeof(uint64_t) + artifact.size());
+
+  //an entry written by another version of the layout
+  string stale = entry;
+  int version = KernelCache::kVersion + 1;
+  memcpy(&stale[kVersionOffset], &version, sizeof(int));
+  WriteFile(path, stale);
+  CHECK(!cache->Lookup(key, &found));
+
+  //a fingerprint collision, the stored key differs
+  string collision = entry;
+  collision[kHeaderBytes] ^= 1;
+  WriteFile(path, collision);
+  CHECK(!cache->Lookup(key, &found));
+
+  //a truncated entry, whose artifact size is bigger than what is left
+  WriteFile(path, entry.substr(0, entry.size()-4));
+  CHECK(!cache->Lookup(key, &found));
+
+  //a corrupt artifact size must not be allocated
+  string corrupt = entry;
+  const uint64_t huge = (uint64_t)1 << 60;
+  memcpy(&corrupt[kHeaderBytes + key.size()], &huge, sizeof(huge));
+  WriteFile(path, corrupt);
+  CHECK(!cache->Lookup(key, &found));
+
+  //inserting again replaces the broken entry
+  cache->Insert(key, artifact);
+  CHECK(cache->Lookup(key, &found) && found == artifact);
+  LOG(INFO) << "Kernel cache entries passed";
+}
+
+//a host kernel compiled once is loaded from the cache by the next wrapper
+void TestHostKernel(KernelCache* cache) {
+  const string name = "kernel_cache_test_add";
+  const string src = "extern \"C\" void " + name +
+    "(void** outputs, const void** inputs, "
+    "const int* outputs_count, const int* inputs_count, "
+    "const void** sources, const int** indices, const int* indices_count, "
+    "const int n_elements, const int begin, const int end) {\n"
+    "  float* out = (float*)outputs[0];\n"
+    "  const float* inp = (const float*)inputs[0];\n"
+    "  for (int i = begin; i < end; i++) out[i] = inp[i] + 1.f;\n"
+    "}\n";
+  vector<float> inp = {1, 2, 3, 4};
+  const int entries = CountEntries(cache->dir());
+  for (int round = 0; round < 2; round++) {
+    vector<float> out(inp.size(), 0.f);
+    HostRTCWrapper wrapper;
+    wrapper.Compile(name, src);
+    wrapper.Launch({out.data()}, {inp.data()}, {4}, {4}, {}, {}, {}, 4, 0, 4);
+    for (size_t i = 0; i < inp.size(); i++)
+      CHECK(out[i] == inp[i] + 1.f) << round << "\t" << i;
+    //the first compilation adds the entry the second one loads
+    CHECK(CountEntries(cache->dir()) == entries + 1) << round;
+  }
+  LOG(INFO) << "Cached host kernel passed";
+}
+
+int main() {
+  char dir[] = "/tmp/cavs_kernel_cache_test_XXXXXX";
+  CHECK(mkdtemp(dir));
+  //the cache reads it when it is first used
+  setenv("CAVS_KERNEL_CACHE_DIR", dir, 1);
+  KernelCache* cache = KernelCache::Get();
+  CHECK(cache->enabled() && cache->dir() == dir);
+  TestEntries(cache);
+  TestHostKernel(cache);
+  return 0;
+}
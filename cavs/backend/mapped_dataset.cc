@@ -0,0 +1,102 @@
+#include "cavs/backend/mapped_dataset.h"
+#include "cavs/util/logging.h"
+
+#include <algorithm>
+#include <numeric>
+#include <random>
+
+using std::string;
+using std::vector;
+
+namespace backend {
+
+MappedDataset::MappedDataset(const string& filename, size_t offset,
+    int num_items, size_t item_bytes, int batch,
+    bool shuffle, int seed, int prefetch)
+    : file_(filename, offset, num_items*item_bytes),
+      batch_bytes_(batch*item_bytes), num_batches_(num_items/batch),
+      shuffle_(shuffle), seed_(seed), prefetch_(prefetch),
+      epoch_(-1), served_(-1), round_(-1), stop_(false) {
+  CHECK(batch > 0 && num_batches_ > 0) << filename;
+  if (prefetch_ > 0)
+    prefetcher_ = std::thread(&MappedDataset::Prefetch, this);
+  VLOG(V_DEBUG) << filename << ": " << num_batches_ << " batches of "
+                << batch_bytes_ << " Bytes, shuffle: " << shuffle_
+                << ", prefetch: " << prefetch_;
+}
+
+MappedDataset::~MappedDataset() {
+  if (prefetcher_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(mu_);
+      stop_ = true;
+    }
+    cv_.notify_one();
+    prefetcher_.join();
+  }
+}
+
+void MappedDataset::Order(int epoch, vector<int>* order) const {
+  order->resize(num_batches_);
+  std::iota(order->begin(), order->end(), 0);
+  if (shuffle_) {
+    std::seed_seq seq{seed_, epoch};
+    std::mt19937 gen(seq);
+    std::shuffle(order->begin(), order->end(), gen);
+  }
+}
+
+int MappedDataset::BatchIndex(int round, int* epoch, vector<int>* order) const {
+  if (round/num_batches_ != *epoch) {
+    *epoch = round/num_batches_;
+    Order(*epoch, order);
+  }
+  return (*order)[round%num_batches_];
+}
+
+const char* MappedDataset::Batch(int round) {
+  CHECK(round >= 0);
+  const int idx = BatchIndex(round, &epoch_, &order_);
+  if (prefetch_ > 0) {
+    {
+      std::lock_guard<std::mutex> lock(mu_);
+      round_ = round;
+    }
+    cv_.notify_one();
+  }
+  //a dataset within the prefetch window stays resident anyway
+  if (served_ >= 0 && served_ != idx && num_batches_ > prefetch_+1)
+    file_.DontNeed(served_*batch_bytes_, batch_bytes_);
+  served_ = idx;
+  return file_.data() + idx*batch_bytes_;
+}
+
+//the thread keeps the next prefetch_ batches resident,
+//each of them is faulted in only once unless the rounds start over
+void MappedDataset::Prefetch() {
+  int epoch = -1;
+  vector<int> order;
+  int seen = -1;
+  int ahead = -1;
+  while (true) {
+    int round;
+    {
+      std::unique_lock<std::mutex> lock(mu_);
+      cv_.wait(lock, [this, seen]{ return stop_ || round_ != seen; });
+      if (stop_) return;
+      round = round_;
+    }
+    if (round < seen)
+      ahead = round;
+    seen = round;
+    const int first = std::max(ahead+1, round+1);
+    const int last = round+prefetch_;
+    for (int r = first; r <= last; r++)
+      file_.WillNeed(BatchIndex(r, &epoch, &order)*batch_bytes_, batch_bytes_);
+    for (int r = first; r <= last; r++)
+      file_.FaultIn(BatchIndex(r, &epoch, &order)*batch_bytes_, batch_bytes_);
+    ahead = last;
+  }
+}
+
+} //namespace backend
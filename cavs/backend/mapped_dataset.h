@@ -0,0 +1,62 @@
+#ifndef CAVS_BACKEND_MAPPED_DATASET_H_
+#define CAVS_BACKEND_MAPPED_DATASET_H_
+
+#include "cavs/util/mapped_file.h"
+
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <string>
+#include <vector>
+
+namespace backend {
+
+//Serves the batches of a binary file of fixed-size items through a
+//read-only mapping, so neither the startup time nor the resident memory
+//grows with the size of the dataset.
+//The batch of round r is the (r%num_batches())-th one in the order of
+//its epoch. With shuffling, the order is a permutation of the batches
+//seeded by (seed, epoch), so the Data ops of the images and the labels
+//built with the same seed stay aligned. The items are not moved.
+//A background thread faults in the pages of the next prefetch batches,
+//and the pages of a batch are released once the next one is served.
+class MappedDataset {
+ public:
+  MappedDataset(const std::string& filename, size_t offset,
+      int num_items, size_t item_bytes, int batch,
+      bool shuffle, int seed, int prefetch);
+  ~MappedDataset();
+  //valid until the batch of the next round is requested
+  const char* Batch(int round);
+  inline int num_batches() const { return num_batches_; }
+  inline size_t batch_bytes() const { return batch_bytes_; }
+
+ private:
+  void Order(int epoch, std::vector<int>* order) const;
+  int BatchIndex(int round, int* epoch, std::vector<int>* order) const;
+  void Prefetch();
+
+  MappedFile file_;
+  size_t batch_bytes_;
+  int num_batches_;
+  bool shuffle_;
+  int seed_;
+  int prefetch_;
+
+  //the order of the epoch being served
+  int epoch_;
+  std::vector<int> order_;
+  int served_;
+
+  std::thread prefetcher_;
+  std::mutex mu_;
+  std::condition_variable cv_;
+  //the last round requested, -1 before the first one
+  int round_;
+  bool stop_;
+};
+
+} //namespace backend
+
+#endif
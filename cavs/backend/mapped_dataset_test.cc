@@ -0,0 +1,53 @@
+#include "cavs/backend/mapped_dataset.h"
+#include "cavs/util/logging.h"
+
+#include <stdio.h>
+#include <set>
+#include <vector>
+
+using backend::MappedDataset;
+
+int main() {
+  const int num = 1000;
+  const int item = 300;
+  const int batch = 10;
+  const char* filename = "mapped_dataset_test.bin";
+  std::vector<float> data(num*item);
+  for (int i = 0; i < num*item; i++)
+    data[i] = i/item;
+  FILE* fp = fopen(filename, "wb");
+  CHECK(fp);
+  CHECK(fwrite(data.data(), sizeof(float), data.size(), fp) == data.size());
+  fclose(fp);
+
+  {
+    MappedDataset dataset(filename, 0, num, item*sizeof(float), batch, false, 0, 2);
+    for (int r = 0; r < 250; r++) {
+      const float* b = reinterpret_cast<const float*>(dataset.Batch(r));
+      CHECK(b[0] == (r%100)*batch) << b[0];
+    }
+  }
+
+  {
+    //the second half(the second of two workers) in shuffled orders,
+    //the same seed gives the same orders
+    const size_t offset = num/2*item*sizeof(float);
+    MappedDataset a(filename, offset, num/2, item*sizeof(float), batch, true, 7, 2);
+    MappedDataset b(filename, offset, num/2, item*sizeof(float), batch, true, 7, 0);
+    std::set<float> epochs[2];
+    for (int r = 0; r < 100; r++) {
+      const float* x = reinterpret_cast<const float*>(a.Batch(r));
+      const float* y = reinterpret_cast<const float*>(b.Batch(r));
+      CHECK(x[0] == y[0]) << r;
+      CHECK(x[batch*item-1] == x[0]+batch-1) << r;
+      epochs[r/50].insert(x[0]);
+    }
+    for (auto& e : epochs) {
+      CHECK(e.size() == 50);
+      CHECK(*e.begin() == num/2);
+    }
+  }
+  remove(filename);
+  LOG(INFO) << "MappedDataset passed";
+  return 0;
+}
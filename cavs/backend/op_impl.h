@@ -16,6 +16,15 @@ class OpImpl {
   explicit OpImpl(const OpDef& def) : op_def_(def) {}
   //explicit Op(const OpDef& def): name_(def.name()) {}
   virtual void Compute(OpContext* context) = 0;
+  //called once before the first Compute, for the ops that finish
+  //their construction in the background (e.g. jit-compiled kernels)
+  virtual void Prepare() {}
+  //whether Output(0) may share the buffer of an equal-sized Input(i),
+  //i.e. each element is read before the same element is written
+  virtual bool TolerateAliasing(int i) const { return false; }
+  //whether Output(i) carries its contents over to the next iteration,
+  //e.g. a row-sparse gradient, which only clears the rows touched before
+  virtual bool KeepsOutputState(int i) const { return false; }
   std::string DebugInfo(int level=V_DEBUG) const {
     if (level == V_DEBUG)
       return op_def_.DebugString(); 
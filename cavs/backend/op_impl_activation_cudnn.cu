@@ -48,6 +48,8 @@ class ActivationOpCudnn : public ActivationOpCudnnBase<mode> {
   explicit ActivationOpCudnn(const OpDef& def) 
       : ActivationOpCudnnBase<mode>(def) {}
   void Compute(OpContext* context) override;
+  //cudnn computes the activation in place
+  bool TolerateAliasing(int i) const override { return true; }
 
   using ActivationOpCudnnBase<mode>::x_desc_;
   using ActivationOpCudnnBase<mode>::y_desc_;
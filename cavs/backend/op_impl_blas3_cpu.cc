@@ -0,0 +1,119 @@
+#include "cavs/backend/op_impl.h"
+#include "cavs/backend/cpu_blas.h"
+#include "cavs/proto/tensor_shape.pb.h"
+#include "cavs/util/logging.h"
+
+#include <vector>
+
+namespace backend {
+
+using ::midend::Tensor;
+using std::vector;
+
+template <typename T>
+class MatMulMatOpCpu : public OpImpl {
+ public:
+  explicit MatMulMatOpCpu(const OpDef& def);
+  void Compute(OpContext* context) override;
+
+ private:
+  bool TransA;
+  bool TransB;
+};
+
+template <typename T>
+MatMulMatOpCpu<T>::MatMulMatOpCpu(const OpDef& def)
+    : OpImpl(def), TransA(false), TransB(false) {
+  for (auto& t : GetListArg<int>(op_def_, "Transpose")) {
+    if (t == 0) TransA = true;
+    if (t == 1) TransB = true;
+  }
+}
+
+template <typename T>
+void MatMulMatOpCpu<T>::Compute(OpContext* context) {
+  const Tensor& A = context->Input(0);
+  const Tensor& B = context->Input(1);
+  Tensor* C = context->Output(0);
+
+  int MA = (TransA == false)? A.dims(0) : A.dims(1);
+  int KA = (TransA == false)? A.dims(1) : A.dims(0);
+  int KB = (TransB == false)? B.dims(0) : B.dims(1);
+  int NB = (TransB == false)? B.dims(1) : B.dims(0);
+  CHECK(KA == KB);
+  CHECK(C->dims(0) == MA)
+    << "C.dims(0): " << C->dims(0)
+    << "\tMA: "      << MA;
+  CHECK(C->dims(1) == NB)
+    << "C.dims(1): " << C->dims(1)
+    << "\tNB: "      << NB;
+
+  MatMulMatCpuWrapper<T>(TransA, TransB,
+      MA, NB, KA, 1.f, A.data<T>(), B.data<T>(),
+      0, C->mutable_data<T>());
+  A.DebugNumerical<T>();
+  B.DebugNumerical<T>();
+  C->DebugNumerical<T>();
+}
+
+//the MatMuls merged by the horizontal batching pass,
+//inputs are A_0...A_{n-1} and the shared B, outputs C_0...C_{n-1}
+template <typename T>
+class MatMulStackedOpCpu : public OpImpl {
+ public:
+  explicit MatMulStackedOpCpu(const OpDef& def);
+  void Compute(OpContext* context) override;
+
+ private:
+  bool TransB;
+};
+
+template <typename T>
+MatMulStackedOpCpu<T>::MatMulStackedOpCpu(const OpDef& def)
+    : OpImpl(def), TransB(false) {
+  for (auto& t : GetListArg<int>(op_def_, "Transpose")) {
+    CHECK(t == 1) << "Only B can be transposed in " << op_def_.DebugString();
+    TransB = true;
+  }
+}
+
+template <typename T>
+void MatMulStackedOpCpu<T>::Compute(OpContext* context) {
+  const int count = context->OutputSize();
+  CHECK(context->InputSize() == count+1);
+  const Tensor& B = context->Input(count);
+  int KB = (TransB == false)? B.dims(0) : B.dims(1);
+  int NB = (TransB == false)? B.dims(1) : B.dims(0);
+
+  vector<const T*> A_ptr(count);
+  vector<T*> C_ptr(count);
+  vector<int> M(count);
+  for (int i = 0; i < count; i++) {
+    const Tensor& A = context->Input(i);
+    Tensor* C = context->Output(i);
+    CHECK(A.dims(1) == KB);
+    CHECK(C->dims(0) == A.dims(0))
+      << "C.dims(0): " << C->dims(0)
+      << "\tMA: "      << A.dims(0);
+    CHECK(C->dims(1) == NB)
+      << "C.dims(1): " << C->dims(1)
+      << "\tNB: "      << NB;
+    A_ptr[i] = A.data<T>();
+    C_ptr[i] = C->mutable_data<T>();
+    M[i] = A.dims(0);
+  }
+
+  MatMulMatStackedCpuWrapper<T>(TransB, count,
+      M.data(), NB, KB, 1.f, A_ptr.data(), B.data<T>(),
+      0, C_ptr.data());
+  for (int i = 0; i < count; i++) {
+    context->Input(i).DebugNumerical<T>();
+    context->Output(i)->DebugNumerical<T>();
+  }
+  B.DebugNumerical<T>();
+}
+
+REGISTER_OP_IMPL_BUILDER(Key("MatMul").Device("CPU"), MatMulMatOpCpu<float>);
+REGISTER_OP_IMPL_BUILDER(Key("MatMulStacked").Device("CPU"), MatMulStackedOpCpu<float>);
+
+} //namespace backend
@@ -0,0 +1,143 @@
+#include "cavs/midend/op_test.h"
+#include "cavs/midend/op_context.h"
+#include "cavs/util/logging.h"
+#include "cavs/util/op_def_builder.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <memory>
+
+using namespace midend;
+using namespace backend;
+using namespace midend::test;
+
+class MatMulCpuOptest : public OpTest {
+ public:
+  MatMulCpuOptest(const OpDef& def) : OpTest(def) {}
+};
+
+//the skinny path(M <= 8)
+void TestSkinny() {
+  OpDef op_def;
+  OpDefBuilder("MatMul").Input("A").Input("B").Output("C")
+    .Device("CPU").AttrList("Transpose", vector<int>{1}).Finalize(&op_def);
+  MatMulCpuOptest matmul_test(op_def);
+  //A is 2x3, B is 2x3 and transposed
+  matmul_test.AddTensorFromVector<float>("A",
+      TensorShape(vector<int>{2, 3}), {1.f, 2.f, 3.f, 4.f, 5.f, 6.f});
+  matmul_test.AddTensorFromVector<float>("B",
+      TensorShape(vector<int>{2, 3}), {1.f, 0.f, 1.f, 0.f, 1.f, 0.f});
+  CHECK(matmul_test.RunTest());
+  vector<float> output;
+  matmul_test.FetchTensor("C", &output);
+
+  vector<float> expected = {4.f, 2.f, 10.f, 5.f};
+  CHECK(output.size() == expected.size());
+  for (size_t i = 0; i < output.size(); i++) {
+    LOG(INFO) << output[i];
+    CHECK(output[i] == expected[i]);
+  }
+}
+
+//the packed micro-kernel path, K and N are not multiples of the blocking
+//sizes(kKC=256, NR=16/32) so that the tails are exercised as well
+void TestPacked() {
+  const int M = 37, K = 300, N = 45;
+  OpDef op_def;
+  OpDefBuilder("MatMul").Input("PA").Input("PB").Output("PC")
+    .Device("CPU").Finalize(&op_def);
+  MatMulCpuOptest matmul_test(op_def);
+  vector<float> a(M*K), b(K*N);
+  srand(0);
+  for (auto& v : a) v = float(rand()%7 - 3);
+  for (auto& v : b) v = float(rand()%5 - 2);
+  matmul_test.AddTensorFromVector<float>("PA",
+      TensorShape(vector<int>{M, K}), a);
+  matmul_test.AddTensorFromVector<float>("PB",
+      TensorShape(vector<int>{K, N}), b);
+  CHECK(matmul_test.RunTest());
+  vector<float> output;
+  matmul_test.FetchTensor("PC", &output);
+
+  CHECK(output.size() == M*N);
+  for (int i = 0; i < M; i++) {
+    for (int j = 0; j < N; j++) {
+      float expected = 0.f;
+      for (int k = 0; k < K; k++)
+        expected += a[i*K+k]*b[k*N+j];
+      CHECK(fabs(output[i*N+j] - expected) < 1e-3f)
+        << i << "\t" << j << "\t" << output[i*N+j] << "\t" << expected;
+    }
+  }
+}
+
+Tensor RandomTensor(const string& name, int rows, int cols) {
+  Tensor t(name, GetAllocator(DeviceTypeToString(CPU)), DT_FLOAT,
+           TensorShape(vector<int>{rows, cols}));
+  vector<float> vals(rows*cols);
+  for (auto& v : vals) v = float(rand()%7 - 3);
+  FillValues<float>(&t, vals);
+  return t;
+}
+
+//the MatMulStacked of the horizontal batching pass must give
+//what the MatMuls it replaces give one by one
+void TestStacked(bool trans_b) {
+  const int K = 300, N = 45;
+  const vector<int> M = {1, 37, 6};
+  srand(1);
+  Tensor B = trans_b ? RandomTensor("SB", N, K) : RandomTensor("SB", K, N);
+  vector<Tensor> A, stacked, unstacked;
+  vector<string> A_names, C_names;
+  for (size_t i = 0; i < M.size(); i++) {
+    A_names.push_back("SA" + std::to_string(i));
+    C_names.push_back("SC" + std::to_string(i));
+    A.push_back(RandomTensor(A_names.back(), M[i], K));
+    stacked.push_back(RandomTensor(C_names.back(), M[i], N));
+    unstacked.push_back(RandomTensor(C_names.back() + "_ref", M[i], N));
+  }
+  vector<int> trans = trans_b ? vector<int>{1} : vector<int>{};
+
+  OpDef stacked_def;
+  vector<string> inputs = A_names;
+  inputs.push_back("SB");
+  OpDefBuilder("MatMulStacked").Input(inputs).Output(C_names)
+    .Device("CPU").Dtype(DT_FLOAT).AttrList("Transpose", trans)
+    .Finalize(&stacked_def);
+  std::unique_ptr<OpImpl> stacked_op(CreateOp(stacked_def));
+  OpContext stacked_ctxt;
+  for (auto& a : A) stacked_ctxt.AppendInput(&a);
+  stacked_ctxt.AppendInput(&B);
+  for (auto& c : stacked) stacked_ctxt.AppendOutput(&c);
+  stacked_op->Compute(&stacked_ctxt);
+
+  OpDef matmul_def;
+  OpDefBuilder("MatMul").Input("SA").Input("SB").Output("SC")
+    .Device("CPU").Dtype(DT_FLOAT).AttrList("Transpose", trans)
+    .Finalize(&matmul_def);
+  std::unique_ptr<OpImpl> matmul_op(CreateOp(matmul_def));
+  for (size_t i = 0; i < M.size(); i++) {
+    OpContext ctxt;
+    ctxt.AppendInput(&A[i]);
+    ctxt.AppendInput(&B);
+    ctxt.AppendOutput(&unstacked[i]);
+    matmul_op->Compute(&ctxt);
+
+    vector<float> lhs, rhs;
+    FetchValues<float>(&lhs, stacked[i]);
+    FetchValues<float>(&rhs, unstacked[i]);
+    CHECK(lhs.size() == rhs.size());
+    for (size_t j = 0; j < lhs.size(); j++)
+      CHECK(lhs[j] == rhs[j]) << trans_b << "\t" << i << "\t" << j
+                              << "\t" << lhs[j] << "\t" << rhs[j];
+  }
+}
+
+int main() {
+  TestSkinny();
+  TestPacked();
+  TestStacked(false);
+  TestStacked(true);
+  LOG(INFO) << "MatMul CPU tests passed";
+  return 0;
+}
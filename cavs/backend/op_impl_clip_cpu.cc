@@ -0,0 +1,86 @@
+#include "cavs/backend/op_impl.h"
+#include "cavs/backend/op_impl_elementwise_cpu.h"
+#include "cavs/backend/row_sparse_index.h"
+#include "cavs/util/logging.h"
+
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+namespace backend {
+
+using ::midend::Tensor;
+using std::vector;
+
+//the untouched rows of a row-sparse gradient are zero,
+//so they neither add to the norm nor need scaling
+template <typename T>
+class ClipOpCpu : public OpImpl {
+ public:
+  explicit ClipOpCpu(const OpDef& def) : OpImpl(def) {
+    clip_ = GetSingleArg<float>(def, "clip");
+    CHECK(clip_ > 0);
+  }
+  void Compute(OpContext* context) override;
+
+ private:
+  float clip_;
+};
+
+template <typename T>
+void ClipOpCpu<T>::Compute(OpContext* context) {
+  vector<RowSparseIndex*> indices(context->InputSize());
+  T sum = 0;
+  for (int i = 0; i < context->InputSize(); i++) {
+    const Tensor& value = context->Input(i);
+    const T* v = value.data<T>();
+    indices[i] = RowSparseIndex::Find(value);
+    T sq = 0;
+    if (indices[i]) {
+      const int width = indices[i]->row_width();
+      for (int r : indices[i]->rows()) {
+        for (int j = 0; j < width; j++)
+          sq += v[size_t(r)*width+j]*v[size_t(r)*width+j];
+      }
+    }else {
+      for (int j = 0; j < value.count(); j++)
+        sq += v[j]*v[j];
+    }
+    //the same as the gpu version, the norms of the tensors are added
+    sum += sqrt(sq);
+  }
+
+  CHECK(sum > 0);
+  const T scale = clip_/std::max(sum, T(clip_));
+  for (int i = 0; i < context->OutputSize(); i++) {
+    const Tensor& in = context->Input(i);
+    Tensor* out = context->Output(i);
+    const T* src = in.data<T>();
+    T* dst = out->mutable_data<T>();
+    if (indices[i] && src == dst) {
+      const int width = indices[i]->row_width();
+      const int* r = indices[i]->rows().data();
+      ElementwiseParallelFor(indices[i]->rows().size(), width,
+          [=](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; k++) {
+          T* row = dst + size_t(r[k])*width;
+          for (int j = 0; j < width; j++)
+            row[j] *= scale;
+        }
+      });
+    }else {
+      ElementwiseParallelFor(out->count(), 1, [=](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; k++)
+          dst[k] = src[k]*scale;
+      });
+    }
+    VLOG(V_EXHAUSTIVE_DEBUG) << "clip: " << clip_ << "\tsum: " << sum
+                             << "\tscale: " << scale;
+    in.DebugNumerical<T>();
+    out->DebugNumerical<T>();
+  }
+}
+
+REGISTER_OP_IMPL_BUILDER(Key("Clip").Device("CPU"), ClipOpCpu<float>);
+
+} //namespace backend
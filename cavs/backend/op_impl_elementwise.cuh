@@ -215,7 +215,7 @@ struct CUDABinaryStridedFunctor {
 #define CudaBinaryOpInstance(math, dtype)   \
     BinaryOp<CUDABinaryFunctor<math<dtype>, dtype>, dtype>
 #define CudaAccumulateBinaryOpInstance(math, dtype)    \
-    UnaryOp<CUDAUnaryStatefulFunctor<math<dtype>, dtype>, dtype>
+    AccumulateUnaryOp<CUDAUnaryStatefulFunctor<math<dtype>, dtype>, dtype>
 #define CudaPartialAccumulateBinaryOpInstance(math, dtype)    \
     PartialAccumulateBinaryOp<CUDABinaryStridedFunctor<math<dtype>, dtype>, CUDABinaryFunctor<math<dtype>, dtype>, dtype>
 
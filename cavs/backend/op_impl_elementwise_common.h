@@ -11,11 +11,27 @@ using ::midend::Tensor;
 
 namespace backend {
 
+//the functors take the stream as their last argument,
+//host functors just ignore it
+#ifdef CAVS_WITH_CUDA
+typedef cudaStream_t ElementwiseStream;
+const ElementwiseStream kDefaultElementwiseStream = cudaStreamDefault;
+inline ElementwiseStream GetElementwiseStream(int stream_id) {
+  return StreamEventHandlePool::GetCudaStream(stream_id);
+}
+#else
+typedef void* ElementwiseStream;
+const ElementwiseStream kDefaultElementwiseStream = NULL;
+inline ElementwiseStream GetElementwiseStream(int stream_id) {
+  return NULL;
+}
+#endif
+
 template <typename FUNCTOR, typename T>//mathop, dtype
 class UnaryOp : public OpImpl {
  public:
   explicit UnaryOp(const OpDef& def) :
-    OpImpl(def), stream_(cudaStreamDefault) {}
+    OpImpl(def), stream_(kDefaultElementwiseStream) {}
 
   void Compute(OpContext* context) override {
     const Tensor& inp = context->Input(0);
@@ -23,7 +39,7 @@ class UnaryOp : public OpImpl {
     Tensor* out = context->Output(0);
 
     if (!stream_ && context->GetStreamID() != -1) {
-      stream_ = StreamEventHandlePool::GetCudaStream(context->GetStreamID());
+      stream_ = GetElementwiseStream(context->GetStreamID());
       VLOG(V_DEBUG) << "[Unary] Assign new stream with ID " << context->GetStreamID();
     }
 
@@ -31,16 +47,17 @@ class UnaryOp : public OpImpl {
         inp.data<T>(), inp.count(), stream_);
     out->DebugNumerical<T>();
   }
+  bool TolerateAliasing(int i) const override { return true; }
 
  private:
-  cudaStream_t stream_;
+  ElementwiseStream stream_;
 };
 
 template <typename FUNCTOR, typename T>
 class BinaryOp : public OpImpl {
  public:
   explicit BinaryOp(const OpDef& def) :
-    OpImpl(def), stream_(cudaStreamDefault) {}
+    OpImpl(def), stream_(kDefaultElementwiseStream) {}
 
   void Compute(OpContext* context) override {
     const Tensor& inp0 = context->Input(0);
@@ -50,7 +67,7 @@ class BinaryOp : public OpImpl {
     Tensor* out = context->Output(0);
 
     if (!stream_ && context->GetStreamID() != -1) {
-      stream_ = StreamEventHandlePool::GetCudaStream(context->GetStreamID());
+      stream_ = GetElementwiseStream(context->GetStreamID());
       VLOG(V_DEBUG) << "[Binary] Assign new stream with ID " << context->GetStreamID();
     }
 
@@ -58,16 +75,25 @@ class BinaryOp : public OpImpl {
         inp0.data<T>(), inp0.count(), inp1.data<T>(), inp1.count(), stream_);
     out->DebugNumerical<T>();
   }
+  bool TolerateAliasing(int i) const override { return true; }
 
  private:
-  cudaStream_t stream_;
+  ElementwiseStream stream_;
+};
+
+//the output is also the augend, an aliased input would overwrite it
+template <typename FUNCTOR, typename T>
+class AccumulateUnaryOp : public UnaryOp<FUNCTOR, T> {
+ public:
+  explicit AccumulateUnaryOp(const OpDef& def) : UnaryOp<FUNCTOR, T>(def) {}
+  bool TolerateAliasing(int i) const override { return false; }
 };
 
 template <typename FUNCTORDYN, typename FUNCTOR, typename T>
 class PartialAccumulateBinaryOp : public OpImpl {
  public:
   explicit PartialAccumulateBinaryOp(const OpDef& def) : OpImpl(def),
-      split_(-1), index_(-1), offset_(-1), stride_(-1), stream_(cudaStreamDefault) {
+      split_(-1), index_(-1), offset_(-1), stride_(-1), stream_(kDefaultElementwiseStream) {
     if (GetSingleArg(def, "Split", 0) != 0) {
       //dynamic slicing
       split_ = GetSingleArg<int>(def, "Split"); 
@@ -90,7 +116,7 @@ class PartialAccumulateBinaryOp : public OpImpl {
     out->DebugNumerical<T>();
 
     if (!stream_ && context->GetStreamID() != -1) {
-      stream_ = StreamEventHandlePool::GetCudaStream(context->GetStreamID());
+      stream_ = GetElementwiseStream(context->GetStreamID());
       VLOG(V_DEBUG) << "[PartialAccumulate] Assign new stream with ID " << context->GetStreamID();
     }
 
@@ -149,7 +175,7 @@ class PartialAccumulateBinaryOp : public OpImpl {
   int stride_;
   int split_;
   int index_;
-  cudaStream_t stream_;
+  ElementwiseStream stream_;
 };
 
 } //namespace backend
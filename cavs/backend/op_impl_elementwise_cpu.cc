@@ -0,0 +1,82 @@
+#include "cavs/backend/op_impl_elementwise_cpu.h"
+#include "cavs/backend/op_impl_elementwise_common.h"
+#include "cavs/backend/functor_elementwise.h"
+#include "cavs/backend/row_sparse_index.h"
+
+namespace backend {
+
+//the gradients of the Mirrors of an embedding matrix are row-sparse,
+//so is their sum: only the indexed rows are added
+template <typename T>
+class AccumulateOpCpu : public OpImpl {
+ public:
+  explicit AccumulateOpCpu(const OpDef& def) : OpImpl(def), dense_(def) {}
+
+  void Compute(OpContext* context) override {
+    const Tensor& inp = context->Input(0);
+    Tensor* out = context->Output(0);
+    RowSparseIndex* inp_index = RowSparseIndex::Find(inp);
+    RowSparseIndex* out_index = RowSparseIndex::Find(*out);
+    if (inp_index && inp.count() == out->count() && out->dims() == 2) {
+      out_index = RowSparseIndex::Get(out, sizeof(T), context->round());
+      out_index->Begin(context->round());
+      const int width = inp_index->row_width();
+      const T* src = inp.data<T>();
+      T* dst = out->mutable_data<T>();
+      for (int r : inp_index->rows()) {
+        out_index->Touch(r);
+        const size_t offset = size_t(r)*width;
+        for (int j = 0; j < width; j++)
+          dst[offset+j] += src[offset+j];
+      }
+      out->DebugNumerical<T>();
+    }else {
+      //a dense contribution touches every row
+      if (out_index) {
+        out_index->Begin(context->round());
+        for (int r = 0; r < out_index->num_rows(); r++)
+          out_index->Touch(r);
+      }
+      dense_.Compute(context);
+    }
+  }
+  //the sum becomes row-sparse with its first sparse input
+  bool KeepsOutputState(int i) const override { return true; }
+
+ private:
+  CpuAccumulateBinaryOpInstance(math::Add, T) dense_;
+};
+
+REGISTER_OP_IMPL_BUILDER(Key("Abs").Device("CPU"),
+    CpuUnaryOpInstance(math::Abs, float));
+REGISTER_OP_IMPL_BUILDER(Key("Neg").Device("CPU"),
+    CpuUnaryOpInstance(math::Neg, float));
+REGISTER_OP_IMPL_BUILDER(Key("Assign").Device("CPU"),
+    CpuUnaryOpInstance(math::Assign, float));
+
+REGISTER_OP_IMPL_BUILDER(Key("Add").Device("CPU"),
+    CpuBinaryOpInstance(math::Add, float));
+REGISTER_OP_IMPL_BUILDER(Key("Sub").Device("CPU"),
+    CpuBinaryOpInstance(math::Sub, float));
+REGISTER_OP_IMPL_BUILDER(Key("Mul").Device("CPU"),
+    CpuBinaryOpInstance(math::Mul, float));
+REGISTER_OP_IMPL_BUILDER(Key("Div").Device("CPU"),
+    CpuBinaryOpInstance(math::Div, float));
+REGISTER_OP_IMPL_BUILDER(Key("Square").Device("CPU"),
+    CpuUnaryOpInstance(math::Square, float));
+REGISTER_OP_IMPL_BUILDER(Key("Scal").Device("CPU"),
+    CpuBinaryOpInstance(math::Mul, float));
+//Fill is the backward operator of reduction operator
+REGISTER_OP_IMPL_BUILDER(Key("Fill").Device("CPU"),
+    CpuUnaryOpInstance(math::Assign, float));
+
+REGISTER_OP_IMPL_BUILDER(Key("Equal").Device("CPU"),
+    CpuBinaryOpInstance(math::Equal, float));
+
+//For partial-add, we have reset the augend tensor to 0 in each iteration
+REGISTER_OP_IMPL_BUILDER(Key("Accumulate").Device("CPU"),
+    AccumulateOpCpu<float>);
+REGISTER_OP_IMPL_BUILDER(Key("PartialAccumulate").Device("CPU"),
+    CpuPartialAccumulateBinaryOpInstance(math::Add, float));
+
+} //namespace backend
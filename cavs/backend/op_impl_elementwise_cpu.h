@@ -0,0 +1,204 @@
+#ifndef CAVS_BACKEND_OP_IMPL_ELEMENTWISE_CPU_H_
+#define CAVS_BACKEND_OP_IMPL_ELEMENTWISE_CPU_H_
+
+#include "cavs/util/logging.h"
+#include "cavs/util/macros.h"
+#include "cavs/util/thread_pool.h"
+
+#include <stddef.h>
+#include <algorithm>
+
+namespace backend {
+
+//host counterparts of the functors in op_impl_elementwise.cuh,
+//with the same calling convention so that they plug into
+//UnaryOp/BinaryOp/PartialAccumulateBinaryOp.
+//the loops are kept branch-free and unit-stride for the vectorizer,
+//and tensors above the threshold are split over the thread pool.
+const size_t kElementwiseParallelThreshold = 1 << 15;
+
+template <typename FUNC>
+FORCE_INLINE void ElementwiseParallelFor(size_t n, size_t cost_per_item,
+    const FUNC& func) {
+  const size_t grain =
+      std::max<size_t>(1, kElementwiseParallelThreshold/std::max<size_t>(cost_per_item, 1));
+  if (n < 2*grain) {
+    func(0, n);
+  }else {
+    ThreadPool::Get()->ParallelFor(n, grain,
+        [&func](int begin, int end) { func(begin, end); });
+  }
+}
+
+template <typename OP, typename T, typename U=T>
+struct CPUUnaryFunctor {
+  static void Compute(T* out, size_t n_out, const U* inp, size_t n_inp, void* stream) {
+    if (n_out == n_inp){
+      ElementwiseParallelFor(n_out, 1, [=](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++)
+          out[i] = OP::Compute(inp[i]);
+      });
+    }else if (n_inp == 1) {
+      const T value = OP::Compute(*inp);
+      ElementwiseParallelFor(n_out, 1, [=](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++)
+          out[i] = value;
+      });
+    }else if (n_inp > n_out && n_inp % n_out == 0) {
+      //this is specific for the backward of broadcasting binary operators
+      //for user defined operator, this configuration will not be generated.
+      const size_t dim0 = n_inp/n_out;
+      ElementwiseParallelFor(n_out, dim0, [=](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++)
+          out[i] = 0;
+        for (size_t j = 0; j < dim0; j++) {
+          const U* row = inp + j*n_out;
+          for (size_t i = begin; i < end; i++)
+            out[i] += OP::Compute(row[i]);
+        }
+      });
+    }else {
+      LOG(FATAL) << "Unrecognized Pattern:";
+    }
+  }
+};
+
+template <typename OP, typename T, typename U=T>
+struct CPUUnaryConstScalarFunctor {
+  static void Compute(T* out, const U value, size_t n, void* stream) {
+    const T ret = OP::Compute(value);
+    ElementwiseParallelFor(n, 1, [=](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; i++)
+        out[i] = ret;
+    });
+  }
+};
+
+template <typename OP, typename T, typename U=T>
+struct CPUUnaryStatefulFunctor {
+  static void Compute(T* out, size_t n_out, const U* inp, size_t n_inp, void* stream) {
+    if (n_out == n_inp) {
+      ElementwiseParallelFor(n_out, 1, [=](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++)
+          out[i] = OP::Compute(out[i], inp[i]);
+      });
+    }else if (n_out < n_inp && n_inp % n_out == 0) {
+      //this is specific for the backward of broadcasting unary operators such as mirror
+      //for user defined operator, this configuration will not be generated.
+      //the original value is folded in once per slice, as the gpu kernel does.
+      const size_t dim0 = n_inp/n_out;
+      ElementwiseParallelFor(n_out, dim0, [=](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+          const U inp0 = out[i];
+          T ret = 0;
+          for (size_t j = 0; j < dim0; j++)
+            ret += OP::Compute(inp0, inp[i+j*n_out]);
+          out[i] = ret;
+        }
+      });
+    }else {
+      LOG(FATAL) << "Unrecognized Pattern:";
+    }
+  }
+};
+
+template <typename OP, typename T, typename U=T>
+struct CPUBinaryFunctor {
+  static void Compute(T* out, size_t n_out,
+      const U* inp0, size_t n_inp0, const U* inp1, size_t n_inp1, void* stream) {
+    VLOG(V_DEBUG) << "BinaryFunctior";
+    VLOG(V_DEBUG) << n_out << "\t" << n_inp0 << "\t" << n_inp1;
+    if (n_out == n_inp0 && n_inp0 == n_inp1) {
+      ElementwiseParallelFor(n_out, 1, [=](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++)
+          out[i] = OP::Compute(inp0[i], inp1[i]);
+      });
+    }else if (n_inp1 == 1 && n_out == n_inp0) {
+      const U value = *inp1;
+      ElementwiseParallelFor(n_out, 1, [=](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++)
+          out[i] = OP::Compute(inp0[i], value);
+      });
+    }else if (n_inp0 == 1 && n_out == n_inp1) {
+      const U value = *inp0;
+      ElementwiseParallelFor(n_out, 1, [=](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++)
+          out[i] = OP::Compute(value, inp1[i]);
+      });
+    }else if (n_out == n_inp0) {
+      CHECK(n_out > n_inp1 && n_out % n_inp1 == 0) << n_out << "\t" << n_inp1;
+      //inp1 repeats along the 1st dimension,
+      //walk it row by row instead of taking i%stride per element
+      const size_t stride = n_inp1;
+      ElementwiseParallelFor(n_out/stride, stride, [=](size_t begin, size_t end) {
+        for (size_t r = begin; r < end; r++) {
+          T* o = out + r*stride;
+          const U* a = inp0 + r*stride;
+          for (size_t i = 0; i < stride; i++)
+            o[i] = OP::Compute(a[i], inp1[i]);
+        }
+      });
+      VLOG(V_DEBUG) << "Broadcasting inp1";
+    }else if (n_out == n_inp1) {
+      CHECK(n_out > n_inp0 && n_out % n_inp0 == 0);
+      const size_t stride = n_inp0;
+      ElementwiseParallelFor(n_out/stride, stride, [=](size_t begin, size_t end) {
+        for (size_t r = begin; r < end; r++) {
+          T* o = out + r*stride;
+          const U* b = inp1 + r*stride;
+          for (size_t i = 0; i < stride; i++)
+            o[i] = OP::Compute(inp0[i], b[i]);
+        }
+      });
+      VLOG(V_DEBUG) << "Broadcasting inp0";
+    }else {
+      LOG(FATAL) << "Unrecognized Pattern:\t"
+                 << n_out << "\t" << n_inp0 << "\t" << n_inp1;
+    }
+  }
+};
+
+template <typename OP, typename T, typename U=T>
+struct CPUBinaryConstScalarFunctor {
+  static void Compute(T* out, size_t n_out, const U* inp0, size_t n_inp0,
+      const U inp1, void* stream) {
+    CHECK(n_out == n_inp0);
+    ElementwiseParallelFor(n_out, 1, [=](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; i++)
+        out[i] = OP::Compute(inp0[i], inp1);
+    });
+  }
+};
+
+template <typename OP, typename T, typename U=T>
+struct CPUBinaryStridedFunctor {
+  static void Compute(T* out, size_t stride_out,
+      const U* inp0, size_t stride_inp0,
+      const U* inp1, size_t stride_inp1,
+      int num_blocks, int workload_of_one_block, void* stream) {
+    CHECK(num_blocks > 0);
+    const size_t len = workload_of_one_block;
+    ElementwiseParallelFor(num_blocks, len, [=](size_t begin, size_t end) {
+      for (size_t b = begin; b < end; b++) {
+        T* o = out + b*stride_out;
+        const U* a = inp0 + b*stride_inp0;
+        const U* c = inp1 + b*stride_inp1;
+        for (size_t i = 0; i < len; i++)
+          o[i] = OP::Compute(a[i], c[i]);
+      }
+    });
+  }
+};
+
+#define CpuUnaryOpInstance(math, dtype)    \
+    UnaryOp<CPUUnaryFunctor<math<dtype>, dtype>, dtype>
+#define CpuBinaryOpInstance(math, dtype)   \
+    BinaryOp<CPUBinaryFunctor<math<dtype>, dtype>, dtype>
+#define CpuAccumulateBinaryOpInstance(math, dtype)    \
+    AccumulateUnaryOp<CPUUnaryStatefulFunctor<math<dtype>, dtype>, dtype>
+#define CpuPartialAccumulateBinaryOpInstance(math, dtype)    \
+    PartialAccumulateBinaryOp<CPUBinaryStridedFunctor<math<dtype>, dtype>, CPUBinaryFunctor<math<dtype>, dtype>, dtype>
+
+} //namespace backend
+
+#endif
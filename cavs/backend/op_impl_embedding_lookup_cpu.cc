@@ -0,0 +1,106 @@
+#include "cavs/backend/op_impl.h"
+#include "cavs/backend/op_impl_elementwise_cpu.h"
+#include "cavs/backend/row_sparse_index.h"
+#include "cavs/proto/tensor_shape.pb.h"
+#include "cavs/util/logging.h"
+
+namespace backend {
+
+using ::midend::Tensor;
+
+template <typename T>
+class EmbeddingLookupOpCpu: public OpImpl {
+ public:
+  explicit EmbeddingLookupOpCpu(const OpDef& def) : OpImpl(def) {}
+  void Compute(OpContext* context) override;
+};
+
+template <typename T>
+void EmbeddingLookupOpCpu<T>::Compute(OpContext* context) {
+  const Tensor& input = context->Input(0);
+  const Tensor& embedding_matrix = context->Input(1);
+  Tensor* embedding = context->Output(0);
+
+  CHECK(embedding_matrix.dims() == 2);
+  const int vocabulary_size = embedding_matrix.dims(0);
+  const int embedding_size  = embedding_matrix.dims(1);
+  //the same relaxations for the batching as the gpu version
+  CHECK(embedding->dims() == input.dims()+1 ||
+      (embedding->dims() == input.dims() && input.IsDynamicShape()));
+  CHECK(embedding->dims(embedding->dims()-1) == embedding_size);
+
+  const int slices = input.count();
+  const T* ids = input.data<T>();
+  const T* matrix = embedding_matrix.data<T>();
+  T* out = embedding->mutable_data<T>();
+  ElementwiseParallelFor(slices, embedding_size, [=](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      const int id = ids[i];
+      CHECK(id >= 0 && id < vocabulary_size) << id;
+      std::copy(matrix + id*embedding_size, matrix + (id+1)*embedding_size,
+                out + i*embedding_size);
+    }
+  });
+
+  input.DebugNumerical<T>();
+  embedding_matrix.DebugNumerical<T>();
+  embedding->DebugNumerical<T>();
+}
+
+//The gradient of the embedding matrix is row-sparse:
+//only the rows looked up in this iteration are written and indexed,
+//the rows of duplicate ids are accumulated.
+template <typename T>
+class EmbeddingLookupGradOpCpu: public OpImpl {
+ public:
+  explicit EmbeddingLookupGradOpCpu(const OpDef& def) : OpImpl(def) {}
+  void Compute(OpContext* context) override;
+  bool KeepsOutputState(int i) const override { return true; }
+};
+
+template <typename T>
+void EmbeddingLookupGradOpCpu<T>::Compute(OpContext* context) {
+  const Tensor& dY = context->Input(0);
+  const Tensor& input = context->Input(1);
+  Tensor* dMatrix = context->Output(0);
+  //we don't calculate the dX, because dX is not passed backward
+
+  CHECK(dMatrix->dims() == 2);
+  const int vocabulary_size = dMatrix->dims(0);
+  const int embedding_size  = dMatrix->dims(1);
+  CHECK(dY.dims() == input.dims()+1 ||
+       (dY.dims() == input.dims() && input.IsDynamicShape()));
+  CHECK(dY.dims(dY.dims()-1) == embedding_size);
+
+  RowSparseIndex* index = RowSparseIndex::Get(dMatrix, sizeof(T), context->round());
+  index->Begin(context->round());
+  const int slices = input.count();
+  const T* ids = input.data<T>();
+  for (int i = 0; i < slices; i++) {
+    const int id = ids[i];
+    CHECK(id >= 0 && id < vocabulary_size) << id;
+    index->Touch(id);
+  }
+
+  //split along the columns, so that the duplicate ids
+  //are accumulated by the same thread
+  const T* grad = dY.data<T>();
+  T* dm = dMatrix->mutable_data<T>();
+  ElementwiseParallelFor(embedding_size, slices, [=](size_t begin, size_t end) {
+    for (int i = 0; i < slices; i++) {
+      T* row = dm + int(ids[i])*embedding_size;
+      const T* g = grad + i*embedding_size;
+      for (size_t j = begin; j < end; j++)
+        row[j] += g[j];
+    }
+  });
+
+  dY.DebugNumerical<T>();
+  input.DebugNumerical<T>();
+  dMatrix->DebugNumerical<T>();
+}
+
+REGISTER_OP_IMPL_BUILDER(Key("EmbeddingLookup").Device("CPU"), EmbeddingLookupOpCpu<float>);
+REGISTER_OP_IMPL_BUILDER(Key(GetGradientName("EmbeddingLookup")).Device("CPU"), EmbeddingLookupGradOpCpu<float>);
+
+} //namespace backend
@@ -0,0 +1,120 @@
+#include "cavs/backend/op_impl.h"
+#include "cavs/backend/cpu_blas.h"
+#include "cavs/proto/tensor_shape.pb.h"
+#include "cavs/util/logging.h"
+
+#include <string.h>
+
+namespace backend {
+
+using ::midend::Tensor;
+
+template <typename T>
+class FullyConnectedOpCpu : public OpImpl {
+ public:
+  explicit FullyConnectedOpCpu(const OpDef& def) : OpImpl(def) {}
+  void Compute(OpContext* context) override;
+};
+
+template <typename T>
+void FullyConnectedOpCpu<T>::Compute(OpContext* context) {
+  const Tensor& X = context->Input(0);
+  const Tensor& W = context->Input(1);
+  const Tensor& B = context->Input(2);
+  Tensor* Y = context->Output(0);
+
+  CHECK(X.dims() == 2);
+  CHECK(W.dims() == 2);
+  CHECK(B.dims() == 2);
+  CHECK(Y->dims() == 2);
+  int batchN = X.dims(0);
+  int K = X.dims(1);
+  CHECK(K == W.dims(1));
+  int Out = W.dims(0);
+  CHECK(Y->dims(0) == batchN);
+  CHECK(Y->dims(1) == Out);
+  CHECK(B.dims(0) == 1);
+  CHECK(B.dims(1) == Out);
+
+  //broadcast the bias into Y and accumulate X*W^T on top of it,
+  //which saves the ones vector the cublas version needs
+  T* y = Y->mutable_data<T>();
+  for (int i = 0; i < batchN; i++)
+    memcpy(y+i*Out, B.data<T>(), Out*sizeof(T));
+  MatMulMatCpuWrapper<T>(false, true,
+      batchN, Out, K, 1.f, X.data<T>(), W.data<T>(),
+      1, y);
+
+  X.DebugNumerical<T>();
+  W.DebugNumerical<T>();
+  B.DebugNumerical<T>();
+  Y->DebugNumerical<T>();
+}
+
+template <typename T>
+class FullyConnectedGradOpCpu : public OpImpl {
+ public:
+  explicit FullyConnectedGradOpCpu(const OpDef& def) : OpImpl(def) {}
+  void Compute(OpContext* context) override;
+};
+
+template <typename T>
+void FullyConnectedGradOpCpu<T>::Compute(OpContext* context) {
+  const Tensor& dY = context->Input(0);
+  const Tensor& X = context->Input(1);
+  const Tensor& W = context->Input(2);
+  const Tensor& B = context->Input(3);
+  Tensor* dW = context->Output(0);
+  Tensor* dB = context->Output(1);
+  Tensor* dX = context->Output(2);
+
+  CHECK(dY.dims()  == 2);
+  CHECK(X.dims()   == 2);
+  CHECK(W.dims()   == 2);
+  CHECK(B.dims()   == 2);
+  CHECK(dW->dims() == 2);
+  CHECK(dB->dims() == 2);
+  CHECK(dX->dims() == 2);
+  for (int i = 0; i < 2; i++) {
+    CHECK(X.dims(i) == dX->dims(i));
+    CHECK(W.dims(i) == dW->dims(i));
+    CHECK(B.dims(i) == dB->dims(i));
+  }
+  int batchN = X.dims(0);
+  int K = X.dims(1);
+  CHECK(K == W.dims(1));
+  int Out = W.dims(0);
+  CHECK(dY.dims(0) == batchN);
+  CHECK(dY.dims(1) == Out);
+  CHECK(B.dims(0) == 1);
+  CHECK(B.dims(1) == Out);
+
+  MatMulMatCpuWrapper<T>(true, false,
+      Out, K, batchN, 1.f, dY.data<T>(), X.data<T>(),
+      0, dW->mutable_data<T>());
+
+  //dB is the column sum of dY
+  T* db = dB->mutable_data<T>();
+  const T* dy = dY.data<T>();
+  memset(db, 0, Out*sizeof(T));
+  for (int i = 0; i < batchN; i++)
+    for (int j = 0; j < Out; j++)
+      db[j] += dy[i*Out+j];
+
+  MatMulMatCpuWrapper<T>(false, false,
+      batchN, K, Out, 1.f, dY.data<T>(), W.data<T>(),
+      0, dX->mutable_data<T>());
+
+  dY.DebugNumerical<T>();
+  X.DebugNumerical<T>();
+  W.DebugNumerical<T>();
+  B.DebugNumerical<T>();
+  dW->DebugNumerical<T>();
+  dB->DebugNumerical<T>();
+  dX->DebugNumerical<T>();
+}
+
+REGISTER_OP_IMPL_BUILDER(Key("FullyConnected").Device("CPU"), FullyConnectedOpCpu<float>);
+REGISTER_OP_IMPL_BUILDER(Key(GetGradientName("FullyConnected")).Device("CPU"), FullyConnectedGradOpCpu<float>);
+
+} //namespace backend
@@ -21,9 +21,11 @@ class FusedKernelOpImpl : public OpImpl {
     : OpImpl(def), stream_(cudaStreamDefault)  {
     const string& kernel_name = GetSingleArg<string>(def, "KernelName"); 
     const string& kernel_src  = GetSingleArg<string>(def, "KernelSource"); 
-    wrapper_.Compile(kernel_name, kernel_src);
+    //the kernels of a session are compiled concurrently
+    wrapper_.CompileAsync(kernel_name, kernel_src);
   }
 
+  void Prepare() override { wrapper_.Wait(); }
   void Compute(OpContext* context) override;
 
  private:
@@ -0,0 +1,114 @@
+#include "cavs/backend/op_impl.h"
+#include "cavs/backend/op_impl_elementwise_cpu.h"
+#include "cavs/backend/hostRTC_wrapper.h"
+#include "cavs/midend/graph_scheduler.h"
+
+#include <string>
+#include <set>
+#include <vector>
+#include <algorithm>
+
+namespace backend {
+
+using ::midend::Tensor;
+using ::midend::GraphSchedulerBase;
+using std::string;
+using std::vector;
+using std::set;
+
+template <typename T>
+class FusedKernelOpImplCpu : public OpImpl {
+ public:
+  explicit FusedKernelOpImplCpu(const OpDef& def) : OpImpl(def) {
+    const string& kernel_name = GetSingleArg<string>(def, "KernelName");
+    const string& kernel_src  = GetSingleArg<string>(def, "KernelSource");
+    //the kernels of a session are compiled concurrently
+    wrapper_.CompileAsync(kernel_name, kernel_src);
+    source_ops_ = GetListArg<string>(def, "IndirectSources");
+    source_children_ = GetListArg<int>(def, "IndirectChildren");
+    CHECK(source_ops_.size() == source_children_.size());
+  }
+
+  void Prepare() override { wrapper_.Wait(); }
+  void Compute(OpContext* context) override;
+
+ private:
+  RTC::HostRTCWrapper wrapper_;
+  //the gathers and pulls fused into the kernel,
+  //their rows are read through the tensor ids of the round
+  vector<string> source_ops_;
+  vector<int> source_children_;
+};
+
+template <typename T>
+void FusedKernelOpImplCpu<T>::Compute(OpContext* context) {
+  vector<void*> outputs;
+  vector<const void*> inputs;
+  vector<int> outputs_size;
+  vector<int> inputs_size;
+  set<int> size_conf;
+  vector<const void*> sources;
+  vector<const int*> indices;
+  vector<int> indices_size;
+  if (!source_ops_.empty()) {
+    //the fused gathers and pulls decide the batch size of the round,
+    //as the unfused ones do
+    GraphSchedulerBase* gs = context->graph_scheduler();
+    CHECK_NOTNULL(gs);
+    const vector<int>& gids = gs->GetJobId();
+    context->SetDynDim(gids.size());
+    context->ScaleInputTensor();
+    context->ScaleOutputTensor();
+    for (size_t i = 0; i < source_ops_.size(); i++) {
+      if (source_ops_[i] == "Gather") {
+        const vector<int>& ids = gs->CurrentRoundTensorIdsForGather(source_children_[i]);
+        sources.push_back((const void*)gs->GetMessagePasser(0).data<T>());
+        indices.push_back(ids.data());
+        indices_size.push_back(ids.size());
+      }else {
+        CHECK(source_ops_[i] == "Pull");
+        sources.push_back((const void*)gs->GetFuncArg().data<T>());
+        indices.push_back(gids.data());
+        indices_size.push_back(gids.size());
+      }
+    }
+  }
+  for (int i = 0; i < context->OutputSize(); i++) {
+    outputs.push_back((void*)(context->Output(i)->mutable_data<T>()));
+    int count = context->Output(i)->count();
+    outputs_size.push_back(count);
+    size_conf.insert(count);
+  }
+  for (int i = 0; i < context->InputSize(); i++) {
+    inputs.push_back((const void*)context->Input(i).data<T>());
+    int count = context->Input(i).count();
+    inputs_size.push_back(count);
+    size_conf.insert(count);
+  }
+  CHECK(size_conf.size() <= 2);
+  const int num_elements = *(size_conf.rbegin());
+  //the outputs smaller than num_elements are reductions,
+  //which the kernel accumulates without atomics
+  const bool reduction = std::any_of(outputs_size.begin(), outputs_size.end(),
+      [num_elements](int count) { return count < num_elements; });
+  if (reduction) {
+    wrapper_.Launch(outputs, inputs, outputs_size, inputs_size,
+                    sources, indices, indices_size, num_elements, 0, num_elements);
+  }else {
+    ElementwiseParallelFor(num_elements, inputs.size()+outputs.size(),
+        [&](size_t begin, size_t end) {
+          wrapper_.Launch(outputs, inputs, outputs_size, inputs_size,
+                          sources, indices, indices_size, num_elements, begin, end);
+        });
+  }
+  for (int i = 0; i < context->InputSize(); i++) {
+    context->Input(i).DebugNumerical<T>();
+  }
+  for (int i = 0; i < context->OutputSize(); i++) {
+    context->Output(i)->DebugNumerical<T>();
+  }
+}
+
+REGISTER_OP_IMPL_BUILDER(Key("FusedKernel").Device("CPU"), FusedKernelOpImplCpu<float>);
+
+} //namespace backend
@@ -0,0 +1,212 @@
+#include "cavs/backend/op_impl.h"
+#include "cavs/backend/functor_batched_memcpy_cpu.h"
+#include "cavs/midend/graph_scheduler.h"
+#include "cavs/midend/tensor.h"
+#include "cavs/util/logging.h"
+#include "cavs/util/op_util.h"
+
+#include <string>
+
+using ::midend::Tensor;
+using ::midend::GraphSchedulerBase;
+using std::vector;
+using std::string;
+
+namespace backend {
+
+//host versions of the operators in op_impl_graphop.cu,
+//the tensor ids are read from the scheduler directly
+//instead of being uploaded into gpu_idx_buf() first.
+template <typename T>
+class GraphGatherOpCpu : public OpImpl {
+ public:
+  explicit GraphGatherOpCpu(const OpDef& def) : OpImpl(def), count_(1) {
+    CHECK(def.input_size()  == 0);
+    CHECK(def.output_size() == 1);
+    CHECK(def.shape_size()  == 1);
+    for (auto d : def.shape(0).dim())
+      count_ *= d;
+    child_offset_ = GetSingleArg<int>(def, "Child");
+    CHECK(child_offset_ >= 0);
+  }
+
+  void Compute(OpContext* context) override {
+    Tensor* out = context->Output(0);
+    GraphSchedulerBase* gs = context->graph_scheduler();
+    const Tensor& inp = gs->GetMessagePasser(0);
+
+    const vector<int>& gids = gs->GetJobId();
+    context->SetDynDim(gids.size());
+    context->ScaleOutputTensor();
+    int stride = out->count()/out->dims(0);
+    CHECK(stride == count_) << out->debug_info() << op_def_.DebugString();
+    VLOG(V_DEBUG) << "Batching jobs of this round: " << gids.size();
+
+    const vector<int>& tensor_ids_for_gather = gs->CurrentRoundTensorIdsForGather(child_offset_);
+    //for skewed batched trees, in the backward pass, 
+    //the root of one tree does not need to gather,
+    //but the inode of other tree have to gather
+    if (!tensor_ids_for_gather.empty()) {
+      BatchedDynamicSelectedInputSliceCopyCpu<T>(
+          out->mutable_data<T>(), stride, inp.data<T>(), stride,
+          tensor_ids_for_gather.data(), tensor_ids_for_gather.size(), stride);
+    }else {
+      BatchedDynamicAssignZeroCpu<T>(out->mutable_data<T>(), stride,
+          gs->CurrentRoundTensorIdsForGatherInitialization().size(), stride);
+    }
+
+    out->DebugNumerical<T>();
+  }
+
+ private:
+  int count_;
+  int child_offset_;
+};
+
+template <typename T>
+class GraphScatterOpCpu : public OpImpl {
+ public:
+  explicit GraphScatterOpCpu(const OpDef& def) : OpImpl(def) {
+    child_offset_ = GetSingleArg<int>(def, "Child");
+    CHECK(child_offset_ >= 0);
+  }
+
+  void Compute(OpContext* context) override {
+    const Tensor& inp = context->Input(0);
+    Tensor* out = context->Output(0);
+    CHECK(out->count() == inp.count())
+          << "Input count:\t" << inp.count()
+          << "\t" << inp.debug_size() << "Bytes\n"
+          << "Output count:\t" << out->count() 
+          << "\t" << out->debug_size() << "Bytes";
+    CHECK(inp.IsDynamicShape());
+    CHECK(out->IsDynamicShape());
+    CHECK(out->dims(0) == inp.dims(0));
+    int stride = out->count()/out->dims(0);
+    CHECK(stride == inp.count()/inp.dims(0));
+
+    out->SetOffsetWithId(0);
+    GraphSchedulerBase* gs = context->graph_scheduler();
+    VLOG(V_DEBUG) << "Batching jobs of this round: " << gs->GetJobId().size();
+
+    const vector<int>& tensor_ids_for_scatter = gs->CurrentRoundTensorIdsForScatter(child_offset_);
+    VLOG(V_DEBUG) << "tensor ids for scatter: " << tensor_ids_for_scatter.size();
+    //for skewed batched trees, the root of one tree does not need to scatter,
+    //but the inode of other tree have to scatter
+    if (!tensor_ids_for_scatter.empty()) {
+      BatchedDynamicSelectedOutputSliceCopyCpu<T>(
+          out->mutable_data<T>(), stride, tensor_ids_for_scatter.data(),
+          inp.data<T>(), stride, tensor_ids_for_scatter.size(), stride);
+    }
+
+    out->DebugNumerical<T>();
+  }
+
+ private:
+  int child_offset_;
+};
+
+template <typename T>
+class GraphPushOpCpu : public OpImpl {
+ public:
+  explicit GraphPushOpCpu(const OpDef& def) : OpImpl(def) {}
+
+  void Compute(OpContext* context) override {
+    GraphSchedulerBase* gs = context->graph_scheduler();
+    CHECK_NOTNULL(gs);
+    const Tensor& inp = context->Input(0);
+    Tensor* out = context->Output(0);
+    VLOG(V_DEBUG) << "Input count:\t" << inp.count()
+                  << "\t" << inp.debug_size() << "Bytes\n"
+                  << "Output count:\t" << out->count() 
+                  << "\t" << out->debug_size() << "Bytes";
+    CHECK(!out->IsFullShape());
+
+    ContinuousMemcpyCpu<T>(out->mutable_data<T>(), inp.data<T>(), inp.count());
+    gs->SetFuncRet(*out);
+
+    inp.DebugNumerical<T>();
+    out->DebugNumerical<T>();
+  }
+};
+
+template <typename T>
+class GraphPullOpCpu : public OpImpl {
+ public:
+  explicit GraphPullOpCpu(const OpDef& def) : OpImpl(def) {}
+
+  void Compute(OpContext* context) override {
+    GraphSchedulerBase* gs = context->graph_scheduler();
+    CHECK_NOTNULL(gs);
+    const Tensor& inp = gs->GetFuncArg();
+    Tensor* out = context->Output(0);
+    CHECK(inp.count() >= out->count())
+          << "Input count:\t" << inp.count()
+          << "\t" << inp.debug_size() << "Bytes\n"
+          << "Output count:\t" << out->count() 
+          << "\t" << out->debug_size() << "Bytes";
+
+    const vector<int>& gids = gs->GetJobId();
+    context->SetDynDim(gids.size());
+    context->ScaleOutputTensor();
+    int stride = out->count()/out->dims(0);
+    CHECK(out->dims(0) == (int)gids.size());
+
+    BatchedDynamicSelectedInputSliceCopyCpu<T>(
+        out->mutable_data<T>(), stride, inp.data<T>(), stride,
+        gids.data(), gids.size(), stride);
+
+    inp.DebugNumerical<T>();
+    out->DebugNumerical<T>();
+  }
+};
+
+template <typename T>
+class FunctionPushArgOpCpu : public OpImpl {
+ public:
+  explicit FunctionPushArgOpCpu(const OpDef& def) : OpImpl(def) {}
+  void Compute(OpContext* context) override {
+    const Tensor& inp = context->Input(0);
+    GraphSchedulerBase* gs = context->graph_scheduler();
+    CHECK_NOTNULL(gs);
+    gs->SetFuncArg(inp);
+    inp.DebugNumerical<T>();
+  }
+};
+
+template <typename T>
+class FunctionPopRetOpCpu : public OpImpl {
+ public:
+  explicit FunctionPopRetOpCpu(const OpDef& def) : OpImpl(def) {}
+
+  void Compute(OpContext* context) override {
+    GraphSchedulerBase* gs = context->graph_scheduler();
+    CHECK_NOTNULL(gs);
+    const Tensor& inp = gs->GetFuncRet();
+    Tensor* out = context->Output(0);
+    CHECK(inp.count() <= out->count())
+      << inp.count() << "\t" << out->count();
+    CHECK(inp.debug_size() >= out->debug_size())
+        << inp.debug_size() << "\t" << out->debug_size();
+    CHECK(inp.IsDynamicShape());
+    //for the backward, the shape of lower layer output is arbitrary,
+    //so only the stride of the input is used, as the gpu version does
+    int stride = inp.count()/inp.dims(0);
+    const vector<int>& tids2gids = gs->TensorIdsToJobIds();
+    BatchedDynamicSelectedOutputSliceCopyCpu<T>(
+        out->mutable_data<T>(), stride, tids2gids.data(),
+        inp.data<T>(), stride, tids2gids.size(), stride);
+
+    inp.DebugNumerical<T>();
+    out->DebugNumerical<T>();
+  }
+};
+
+REGISTER_OP_IMPL_BUILDER(Key("Pull").Device("CPU"),    GraphPullOpCpu<float>);
+REGISTER_OP_IMPL_BUILDER(Key("Push").Device("CPU"),    GraphPushOpCpu<float>);
+REGISTER_OP_IMPL_BUILDER(Key("Scatter").Device("CPU"), GraphScatterOpCpu<float>);
+REGISTER_OP_IMPL_BUILDER(Key("Gather").Device("CPU"),  GraphGatherOpCpu<float>);
+REGISTER_OP_IMPL_BUILDER(Key("FunctionPushArg").Device("CPU"), FunctionPushArgOpCpu<float>);
+REGISTER_OP_IMPL_BUILDER(Key("FunctionPopRet").Device("CPU"), FunctionPopRetOpCpu<float>);
+
+} //namespace backend
@@ -0,0 +1,144 @@
+#include "cavs/backend/op_impl.h"
+#include "cavs/midend/allocator.h"
+#include "cavs/midend/graph_scheduler.h"
+#include "cavs/midend/op_context.h"
+#include "cavs/midend/tensor_test.h"
+#include "cavs/util/logging.h"
+#include "cavs/util/op_def_builder.h"
+
+#include <memory>
+
+using namespace midend;
+using namespace backend;
+using namespace midend::test;
+
+const int kWidth = 2;
+
+Allocator* HostAllocator() {
+  return GetAllocator(DeviceTypeToString(CPU));
+}
+
+//row r holds base+r in every column
+Tensor RowTensor(const string& name, int rows, float base) {
+  Tensor t(name, HostAllocator(), DT_FLOAT, TensorShape(vector<int>{rows, kWidth}));
+  vector<float> vals(rows*kWidth);
+  for (int i = 0; i < rows*kWidth; i++)
+    vals[i] = base + i/kWidth;
+  FillValues<float>(&t, vals);
+  return t;
+}
+
+//a dynamic tensor of capacity rows, seen with rows rows
+Tensor DynamicTensor(const string& name, int capacity, int rows) {
+  Tensor t(name, HostAllocator(), DT_FLOAT, TensorShape(vector<int>{capacity, kWidth}));
+  t.SetAsDynamic();
+  vector<float> zeros(capacity*kWidth, 0.f);
+  FillValues<float>(&t, zeros);
+  t.ScaleDynamicDimension(rows);
+  return t;
+}
+
+void CheckRows(const Tensor& t, const vector<float>& expected) {
+  const float* data = t.data<float>();
+  CHECK(t.count() == (int)expected.size()*kWidth) << t.count();
+  for (size_t i = 0; i < expected.size(); i++) {
+    for (int j = 0; j < kWidth; j++)
+      CHECK(data[i*kWidth+j] == expected[i])
+        << t.name() << "[" << i << "]: " << data[i*kWidth+j] << " vs " << expected[i];
+  }
+}
+
+OpImpl* Create(const string& name, int child = -1) {
+  OpDefBuilder builder(name);
+  builder.Output(name + "_out").Device("CPU").Dtype(DT_FLOAT)
+         .Shape(vector<int>{kWidth});
+  if (child >= 0)
+    builder.AttrSingle("Child", child);
+  OpDef def;
+  builder.Finalize(&def);
+  return CreateOp(def);
+}
+
+void Run(OpImpl* op, GraphSchedulerBase* gs,
+    const vector<const Tensor*>& inputs, const vector<Tensor*>& outputs) {
+  OpContext ctxt;
+  ctxt.SetGraphScheduler(gs);
+  for (auto* t : inputs)  ctxt.AppendInput(t);
+  for (auto* t : outputs) ctxt.AppendOutput(t);
+  op->Compute(&ctxt);
+}
+
+//two trees in parent-idx form:
+//  sample 0: nodes 0 and 1 under the root 2(global ids 0, 1, 2)
+//  sample 1: node 0 under the root 1(global ids 3, 4)
+//round 0 runs the leaves 0, 1, 3 as tensor ids 0, 1, 2,
+//round 1 runs the roots 2, 4 as tensor ids 3, 4
+int main() {
+  Tensor graph("graph", HostAllocator(), DT_INT32, TensorShape(vector<int>{2, 3}));
+  FillValues<int>(&graph, {2, 2, -1, 1, -1, -1});
+  BatchGraphScheduler gs;
+  CHECK(gs.LoadGraph(graph) == 5);
+  gs.Initialize();
+  gs.PlanAhead();
+  CHECK(gs.GetJobId() == vector<int>({0, 1, 3}));
+
+  std::unique_ptr<OpImpl> push_arg(Create("FunctionPushArg"));
+  std::unique_ptr<OpImpl> pull(Create("Pull"));
+  std::unique_ptr<OpImpl> scatter(Create("Scatter", 0));
+  std::unique_ptr<OpImpl> gather0(Create("Gather", 0));
+  std::unique_ptr<OpImpl> gather1(Create("Gather", 1));
+  std::unique_ptr<OpImpl> push(Create("Push"));
+  std::unique_ptr<OpImpl> pop_ret(Create("FunctionPopRet"));
+
+  //the argument is indexed by job(global) id
+  Tensor arg = RowTensor("arg", 5, 100.f);
+  Run(push_arg.get(), &gs, {&arg}, {});
+
+  //Pull: out[i] = arg[job_ids[i]]
+  Tensor pulled = DynamicTensor("pulled", 5, 1);
+  Run(pull.get(), &gs, {}, {&pulled});
+  CheckRows(pulled, {100.f, 101.f, 103.f});
+
+  //Scatter: passer[tensor_ids[i]] = inp[i], the leaves fill tensor ids 0-2
+  Tensor leaves = RowTensor("leaves", 3, 10.f);
+  leaves.SetAsDynamic();
+  Tensor passer = DynamicTensor("passer", 5, 3);
+  Run(scatter.get(), &gs, {&leaves}, {&passer});
+  passer.SetOffsetWithId(0);
+  CheckRows(passer, {10.f, 11.f, 12.f});
+  gs.SetMessagePasser(passer);
+
+  //Push: the outputs of the round go to the returned tensor in tensor id order
+  Tensor ret = DynamicTensor("ret", 5, 3);
+  Tensor leaves_ret = RowTensor("leaves_ret", 3, 200.f);
+  Run(push.get(), &gs, {&leaves_ret}, {&ret});
+
+  gs.ActivateNext();
+  CHECK(gs.GetJobId() == vector<int>({2, 4}));
+
+  //Gather: out[i] = passer[tensor_ids of the child-th children[i]],
+  //both roots have a first child(leaves 0 and 3), only root 2 a second one
+  Tensor child0 = DynamicTensor("child0", 5, 1);
+  Run(gather0.get(), &gs, {}, {&child0});
+  CheckRows(child0, {10.f, 12.f});
+  Tensor child1 = DynamicTensor("child1", 5, 1);
+  Run(gather1.get(), &gs, {}, {&child1});
+  CHECK(child1.dims(0) == 2);
+  CHECK(child1.data<float>()[0] == 11.f) << child1.data<float>()[0];
+
+  Tensor roots_ret = RowTensor("roots_ret", 2, 203.f);
+  ret.SetOffsetWithId(3);
+  Run(push.get(), &gs, {&roots_ret}, {&ret});
+
+  gs.ActivateNext();
+  CHECK(gs.Terminate());
+
+  //FunctionPopRet: out[job_ids of tensor id i] = ret[i], back in global id order
+  Tensor popped("popped", HostAllocator(), DT_FLOAT, TensorShape(vector<int>{5, kWidth}));
+  Run(pop_ret.get(), &gs, {}, {&popped});
+  //tensor ids 0-4 are the jobs 0, 1, 3, 2, 4
+  CheckRows(popped, {200.f, 201.f, 203.f, 202.f, 204.f});
+
+  LOG(INFO) << "CPU graph operators passed";
+  return 0;
+}
@@ -8,12 +8,17 @@
 #include "cavs/util/op_util.h"
 #include "cavs/util/stream_event_handle_pool.h"
 
+#include <string.h>
+#include <mutex>
+#include <unordered_map>
+
 namespace backend {
 
 using ::midend::Allocator;
 //using ::midend::DeviceTypeToString;
 using ::midend::Tensor;
 using std::vector;
+using std::string;
 
 //MPI is currently run on CPU and the communication is global
 //CUDA-aware MPI will be supported later
@@ -48,6 +53,95 @@ void MPIAllReduceOpImpl<T>::Compute(OpContext* context) {
   }
 }
 
+//The gradients of a bucket are packed into a persistent host buffer
+//and reduced with one non-blocking call by MPIAllReduceStart,
+//MPIAllReduceWait completes the call and unpacks the buffer.
+//The two ops find the bucket by its name.
+template <typename T>
+struct MPIBucket {
+  vector<T> buffer;
+  CommRequest request;
+  bool pending = false;
+
+  static MPIBucket* Get(const string& name) {
+    static std::mutex mu;
+    static std::unordered_map<string, MPIBucket*> buckets;
+    std::lock_guard<std::mutex> lock(mu);
+    MPIBucket*& b = buckets[name];
+    if (!b) b = new MPIBucket();
+    return b;
+  }
+};
+
+template <typename T>
+class MPIAllReduceStartOpImpl: public OpImpl {
+ public:
+  explicit MPIAllReduceStartOpImpl(const OpDef& def)
+    : OpImpl(def) {
+    bucket_ = MPIBucket<T>::Get(GetSingleArg<string>(def, "Bucket"));
+  }
+  void Compute(OpContext* context) override;
+
+ private:
+  MPIBucket<T>* bucket_;
+};
+
+template <typename T>
+void MPIAllReduceStartOpImpl<T>::Compute(OpContext* context) {
+  CHECK(!bucket_->pending);
+  int total = 0;
+  for (int i = 0; i < context->InputSize(); i++)
+    total += context->Input(i).count();
+  if (bucket_->buffer.size() < total)
+    bucket_->buffer.resize(total);
+  T* buf = bucket_->buffer.data();
+  for (int i = 0; i < context->InputSize(); i++) {
+    const Tensor& inp = context->Input(i);
+    if (inp.device_type() != CPU) {
+      checkCudaError(cudaMemcpy(buf, inp.data<T>(),
+            inp.count()*sizeof(T), cudaMemcpyDeviceToHost));
+    }else {
+      memcpy(buf, inp.data<T>(), inp.count()*sizeof(T));
+    }
+    buf += inp.count();
+  }
+  MPIAllReduceAsyncFunctor<T>::Compute(bucket_->buffer.data(),
+      total, &bucket_->request);
+  bucket_->pending = true;
+}
+
+template <typename T>
+class MPIAllReduceWaitOpImpl: public OpImpl {
+ public:
+  explicit MPIAllReduceWaitOpImpl(const OpDef& def)
+    : OpImpl(def) {
+    bucket_ = MPIBucket<T>::Get(GetSingleArg<string>(def, "Bucket"));
+  }
+  void Compute(OpContext* context) override;
+
+ private:
+  MPIBucket<T>* bucket_;
+};
+
+template <typename T>
+void MPIAllReduceWaitOpImpl<T>::Compute(OpContext* context) {
+  CHECK(bucket_->pending);
+  CHECK(context->InputSize() == context->OutputSize());
+  MPIWaitFunctor::Compute(&bucket_->request);
+  bucket_->pending = false;
+  const T* buf = bucket_->buffer.data();
+  for (int i = 0; i < context->OutputSize(); i++) {
+    Tensor* out = context->Output(i);
+    if (out->device_type() != CPU) {
+      checkCudaError(cudaMemcpy(out->mutable_data<T>(), buf,
+            out->count()*sizeof(T), cudaMemcpyHostToDevice));
+    }else {
+      memcpy(out->mutable_data<T>(), buf, out->count()*sizeof(T));
+    }
+    buf += out->count();
+  }
+}
+
 template <typename T>
 class MPIBcastOpImpl: public OpImpl {
  public:
@@ -73,31 +167,76 @@ void MPIBcastOpImpl<T>::Compute(OpContext* context) {
   }
 }
 
+//The sufficient factors(A and B of C=Matmul(A, B)) of all the ranks
+//are exchanged point-to-point into persistent pinned buffers.
+//The factors of each rank are copied to the device as soon as they arrive,
+//so that the gemm of the ones already received runs on the stream
+//while the others are still on the wire.
+//When the factors are stacked along K in the receive buffers
+//(A transposed and B not, as in the gradient of a weight),
+//the ranks are summed up by one gemm over K*size instead.
 template <typename T>
 class MPISFBOpImpl: public OpImpl {
  public:
   explicit MPISFBOpImpl(const OpDef& def)
     : OpImpl(def), TransA_(false), TransB_(false), handle_(NULL),
-      workspaceA(NULL), workspaceB(NULL),
-      workspaceAInBytes(0), workspaceBInBytes(0) {
+      stream_(cudaStreamDefault), copied_(NULL),
+      hostA_(NULL), hostB_(NULL), workspaceA_(NULL), workspaceB_(NULL),
+      capacityA_(0), capacityB_(0) {
     for (auto& t : GetListArg<int>(op_def_, "Transpose")) {
       LOG(INFO) << "Transpose: " << t;
       if (t == 0) TransA_ = true;
       if (t == 1) TransB_ = true;
     }
     alloc_ = ::midend::GetAllocator(DeviceTypeToString(GPU));
+    checkCudaError(cudaEventCreateWithFlags(&copied_, cudaEventDisableTiming));
   }
+  ~MPISFBOpImpl();
   void Compute(OpContext* context) override;
 
  private:
+  void Reserve(size_t countA, size_t countB);
   bool TransA_;
   bool TransB_;
   cublasHandle_t handle_;
+  cudaStream_t stream_;
+  //the host buffers are not refilled until their last copy is done
+  cudaEvent_t copied_;
   Allocator* alloc_;
-  void *workspaceA, *workspaceB;
-  size_t workspaceAInBytes, workspaceBInBytes;
+  T *hostA_, *hostB_;
+  T *workspaceA_, *workspaceB_;
+  size_t capacityA_, capacityB_;
 };
 
+template <typename T>
+MPISFBOpImpl<T>::~MPISFBOpImpl() {
+  if (hostA_) checkCudaError(cudaFreeHost(hostA_));
+  if (hostB_) checkCudaError(cudaFreeHost(hostB_));
+  if (workspaceA_) alloc_->Deallocate<T>(workspaceA_);
+  if (workspaceB_) alloc_->Deallocate<T>(workspaceB_);
+  checkCudaError(cudaEventDestroy(copied_));
+}
+
+//the buffers only grow, and hold the factors of all the ranks
+template <typename T>
+void MPISFBOpImpl<T>::Reserve(size_t countA, size_t countB) {
+  if (capacityA_ < countA) {
+    if (hostA_) checkCudaError(cudaFreeHost(hostA_));
+    if (workspaceA_) alloc_->Deallocate<T>(workspaceA_);
+    checkCudaError(cudaMallocHost((void**)&hostA_, countA*sizeof(T)));
+    workspaceA_ = alloc_->Allocate<T>(countA);
+    capacityA_ = countA;
+  }
+  if (capacityB_ < countB) {
+    if (hostB_) checkCudaError(cudaFreeHost(hostB_));
+    if (workspaceB_) alloc_->Deallocate<T>(workspaceB_);
+    checkCudaError(cudaMallocHost((void**)&hostB_, countB*sizeof(T)));
+    workspaceB_ = alloc_->Allocate<T>(countB);
+    capacityB_ = countB;
+  }
+  CHECK(hostA_ && hostB_ && workspaceA_ && workspaceB_);
+}
+
 //C = Matmul(A, B)
 template <typename T>
 void MPISFBOpImpl<T>::Compute(OpContext* context) {
@@ -114,69 +253,109 @@ void MPISFBOpImpl<T>::Compute(OpContext* context) {
   CHECK(C->dims() == 2);
   CHECK(C->dims(0) == MA);
   CHECK(C->dims(1) == NB);
-
-  //MatMulMatCublasWrapper<T>(TransA_, TransB_,
-      //MA, NB, KA, 1.f, A.data<T>(), B.data<T>(),
-      //0, C->mutable_data<T>());
-
-  int size = 0;
-  checkMPIError(MPI_Comm_size(MPI_COMM_WORLD, &size));
-  vector<T> recvbufA(A.count()*size);
-  vector<T> recvbufB(B.count()*size);
-  CHECK(A.device_type() == B.device_type());
-  if (A.device_type() != CPU) {
-    Tensor cpubufA;
-    cpubufA.Rebase(::midend::GetAllocator(DeviceTypeToString(CPU)), A);
-    cpubufA.SyncWith(A);
-    MPIAllgatherFunctor<T>::Compute(cpubufA.data<T>(), A.count(),
-        recvbufA.data(), A.count());
-    Tensor cpubufB;
-    cpubufB.Rebase(::midend::GetAllocator(DeviceTypeToString(CPU)), B);
-    cpubufB.SyncWith(B);
-    MPIAllgatherFunctor<T>::Compute(cpubufB.data<T>(), B.count(),
-        recvbufB.data(), B.count());
-  }else {
-    MPIAllgatherFunctor<T>::Compute(A.data<T>(), A.count(),
-        recvbufA.data(), A.count());
-    MPIAllgatherFunctor<T>::Compute(B.data<T>(), B.count(),
-        recvbufB.data(), B.count());
-  }
-
-  if (workspaceAInBytes < A.count()*sizeof(T)) {
-    if (workspaceA)
-      alloc_->Deallocate<char>((char*)workspaceA);
-    workspaceA = alloc_->Allocate<char>(A.count()*sizeof(T));
-    workspaceAInBytes = A.count()*sizeof(T);
-  }
-  if (workspaceBInBytes < B.count()*sizeof(T)) {
-    if (workspaceB)
-      alloc_->Deallocate<char>((char*)workspaceB);
-    workspaceB = alloc_->Allocate<char>(B.count()*sizeof(T));
-    workspaceBInBytes = B.count()*sizeof(T);
-  }
-  CHECK(workspaceA);
-  CHECK(workspaceB);
+  CHECK(A.device_type() == GPU);
+  CHECK(B.device_type() == GPU);
   CHECK(C->device_type() == GPU);
 
   if (!handle_) {
     if (context->GetStreamID() != -1) {
       handle_ = StreamEventHandlePool::GetCublasHandle(context->GetStreamID());
+      stream_ = StreamEventHandlePool::GetCudaStream(context->GetStreamID());
     }else {
       handle_ = CudaCommon::cublasHandle();
     }
   }
-  for (int i = 0; i < size; i++) {
-    checkCudaError(cudaMemcpy(workspaceA, recvbufA.data()+A.count()*i,
-          A.count()*sizeof(T), cudaMemcpyHostToDevice));
-    checkCudaError(cudaMemcpy(workspaceB, recvbufB.data()+B.count()*i,
-          B.count()*sizeof(T), cudaMemcpyHostToDevice));
+
+  Communicator* comm = Communicator::Get();
+  const int size = comm->size();
+  const int rank = comm->rank();
+  const int countA = A.count();
+  const int countB = B.count();
+  checkCudaError(cudaEventSynchronize(copied_));
+  Reserve(size_t(countA)*size, size_t(countB)*size);
+
+  //the local factors are sent from the host and used on the device
+  checkCudaError(cudaMemcpyAsync(hostA_+countA*rank, A.data<T>(),
+        countA*sizeof(T), cudaMemcpyDeviceToHost, stream_));
+  checkCudaError(cudaMemcpyAsync(hostB_+countB*rank, B.data<T>(),
+        countB*sizeof(T), cudaMemcpyDeviceToHost, stream_));
+  checkCudaError(cudaMemcpyAsync(workspaceA_+countA*rank, A.data<T>(),
+        countA*sizeof(T), cudaMemcpyDeviceToDevice, stream_));
+  checkCudaError(cudaMemcpyAsync(workspaceB_+countB*rank, B.data<T>(),
+        countB*sizeof(T), cudaMemcpyDeviceToDevice, stream_));
+  checkCudaError(cudaStreamSynchronize(stream_));
+
+  vector<MPI_Request> recvs, sends;
+  vector<int> peers;
+  if (comm->IsThreaded()) {
+    //the workers share the memory, there is nothing to overlap with
+    MPIAllgatherFunctor<T>::Compute(hostA_+countA*rank, countA, hostA_, countA);
+    MPIAllgatherFunctor<T>::Compute(hostB_+countB*rank, countB, hostB_, countB);
+  }
+  for (int i = 1; i < size && !comm->IsThreaded(); i++) {
+    //the ring order spreads the first messages over all the ranks
+    const int from = (rank + size - i) % size;
+    const int to   = (rank + i) % size;
+    recvs.emplace_back();
+    checkMPIError(MPI_Irecv(hostA_+countA*from, countA, DataTypeToMPIType<T>::value,
+          from, 0, MPI_COMM_WORLD, &recvs.back()));
+    recvs.emplace_back();
+    checkMPIError(MPI_Irecv(hostB_+countB*from, countB, DataTypeToMPIType<T>::value,
+          from, 1, MPI_COMM_WORLD, &recvs.back()));
+    peers.push_back(from);
+    sends.emplace_back();
+    checkMPIError(MPI_Isend(hostA_+countA*rank, countA, DataTypeToMPIType<T>::value,
+          to, 0, MPI_COMM_WORLD, &sends.back()));
+    sends.emplace_back();
+    checkMPIError(MPI_Isend(hostB_+countB*rank, countB, DataTypeToMPIType<T>::value,
+          to, 1, MPI_COMM_WORLD, &sends.back()));
+  }
+
+  const bool stacked = TransA_ && !TransB_;
+  if (!stacked) {
+    MatMulMatCublasWrapper<T>(handle_, TransA_, TransB_,
+        MA, NB, KA, 1.f, workspaceA_+countA*rank, workspaceB_+countB*rank,
+        0.f, C->mutable_data<T>());
+  }
+  auto arrive = [&](int from) {
+    checkCudaError(cudaMemcpyAsync(workspaceA_+countA*from, hostA_+countA*from,
+          countA*sizeof(T), cudaMemcpyHostToDevice, stream_));
+    checkCudaError(cudaMemcpyAsync(workspaceB_+countB*from, hostB_+countB*from,
+          countB*sizeof(T), cudaMemcpyHostToDevice, stream_));
+    if (!stacked) {
+      MatMulMatCublasWrapper<T>(handle_, TransA_, TransB_,
+          MA, NB, KA, 1.f, workspaceA_+countA*from, workspaceB_+countB*from,
+          1.f, C->mutable_data<T>());
+    }
+  };
+  if (comm->IsThreaded()) {
+    for (int from = 0; from < size; from++) {
+      if (from != rank) arrive(from);
+    }
+  }
+  vector<int> arrived(peers.size(), 0);
+  for (int done = 0; done < recvs.size(); done++) {
+    int idx = MPI_UNDEFINED;
+    checkMPIError(MPI_Waitany(recvs.size(), recvs.data(), &idx, MPI_STATUS_IGNORE));
+    CHECK(idx != MPI_UNDEFINED);
+    //both factors of the rank are here
+    if (++arrived[idx/2] == 2)
+      arrive(peers[idx/2]);
+  }
+  if (stacked) {
+    //A(K*size x M) and B(K*size x N) are laid out rank after rank
     MatMulMatCublasWrapper<T>(handle_, TransA_, TransB_,
-        MA, NB, KA, 1.f, (T*)workspaceA, (T*)workspaceB,
-        (i == 0) ? 0.f : 1.f, C->mutable_data<T>());
+        MA, NB, KA*size, 1.f, workspaceA_, workspaceB_,
+        0.f, C->mutable_data<T>());
   }
+  checkCudaError(cudaEventRecord(copied_, stream_));
+  if (!sends.empty())
+    checkMPIError(MPI_Waitall(sends.size(), sends.data(), MPI_STATUSES_IGNORE));
 }
 
 REGISTER_OP_IMPL_BUILDER(Key("MPIAllReduce").Device("GPU"), MPIAllReduceOpImpl<float>);
+REGISTER_OP_IMPL_BUILDER(Key("MPIAllReduceStart").Device("GPU"), MPIAllReduceStartOpImpl<float>);
+REGISTER_OP_IMPL_BUILDER(Key("MPIAllReduceWait").Device("GPU"),  MPIAllReduceWaitOpImpl<float>);
 REGISTER_OP_IMPL_BUILDER(Key("MPIBcast").Device("GPU"),     MPIBcastOpImpl<float>);
 REGISTER_OP_IMPL_BUILDER(Key("MPISFB").Device("GPU"),       MPISFBOpImpl<float>);
 
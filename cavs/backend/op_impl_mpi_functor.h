@@ -2,28 +2,19 @@
 #define CAVS_BACKEND_OP_IMPL_MPI_FUNCTOR_H_
 
 #include "cavs/backend/op_impl.h"
+#include "cavs/util/communicator.h"
 #include "cavs/util/mpi_types.h"
-
-#define checkMPIError(stmt)                            \
-  do {                                                 \
-    char err_buffer[MPI_MAX_ERROR_STRING];             \
-    int result_len;                                    \
-    int ierr = (stmt);                                 \
-    if (ierr != MPI_SUCCESS) {                         \
-      MPI_Error_string(ierr, err_buffer, &result_len); \
-      LOG(INFO) << err_buffer;                         \
-      MPI_Finalize();                                  \
-    }                                                  \
-  }while(0) 
+#include "cavs/util/types.h"
 
 namespace backend {
 
+//the functors go through the communicator of the calling worker,
+//which is MPI_COMM_WORLD unless the workers are threads
+//(see Communicator::RunThreaded)
 template <typename T>
 struct MPIBcastFunctor {
   inline static void Compute(void* buf, int count, int root) {
-    checkMPIError(MPI_Bcast(buf, count,
-          DataTypeToMPIType<T>::value,
-          root, MPI_COMM_WORLD));
+    Communicator::Get()->Bcast(buf, count, DataTypeToEnum<T>::value, root);
   }
 };
 
@@ -31,10 +22,8 @@ template <typename T>
 struct MPIAllgatherFunctor {
   inline static void Compute(const void* sendbuf, int sendcount, 
       void* recvbuf, int recvcount) {
-    checkMPIError(MPI_Allgather(
-          sendbuf, sendcount, DataTypeToMPIType<T>::value,
-          recvbuf, recvcount, DataTypeToMPIType<T>::value,
-          MPI_COMM_WORLD));
+    Communicator::Get()->AllGather(sendbuf, sendcount,
+        recvbuf, recvcount, DataTypeToEnum<T>::value);
   }
 };
 
@@ -46,16 +35,25 @@ struct MPIAllReduceFunctor {
  public:
   inline static void Compute(const void* sendbuf,
       void* recvbuf, int count) {
-    if (reinterpret_cast<int64_t>(sendbuf) == 
-        reinterpret_cast<int64_t>(recvbuf)) {
-      checkMPIError(MPI_Allreduce(MPI_IN_PLACE, recvbuf,
-            count, DataTypeToMPIType<T>::value,
-            MPI_SUM, MPI_COMM_WORLD));
-    }else {
-      checkMPIError(MPI_Allreduce(sendbuf, recvbuf,
-            count, DataTypeToMPIType<T>::value,
-            MPI_SUM, MPI_COMM_WORLD));
-    }
+    Communicator::Get()->AllReduce(sendbuf, recvbuf,
+        count, DataTypeToEnum<T>::value);
+  }
+};
+
+//the non-blocking version, the reduction is done in place
+//and completes when MPIWaitFunctor returns
+template <typename T>
+struct MPIAllReduceAsyncFunctor {
+ public:
+  inline static void Compute(void* buf, int count, CommRequest* request) {
+    Communicator::Get()->IAllReduce(buf, count,
+        DataTypeToEnum<T>::value, request);
+  }
+};
+
+struct MPIWaitFunctor {
+  inline static void Compute(CommRequest* request) {
+    Communicator::Get()->Wait(request);
   }
 };
 
@@ -2,11 +2,13 @@
 #define CAVS_BACKEND_OP_IMPL_PLACEHOLDER_H_
 
 #include "cavs/backend/op_impl.h"
+#include "cavs/backend/mapped_dataset.h"
 #include "cavs/midend/tensor.h"
 #include "cavs/proto/tensor_shape.pb.h"
+#include "cavs/util/communicator.h"
 
+#include <memory>
 #include <string>
-#include <mpi.h>
 
 namespace backend {
 
@@ -22,11 +24,19 @@ class PlaceholderOpImpl : public OpImpl {
   }
 };
 
-template <typename READFUNCTOR, typename COPYFUNCTOR, typename T, bool MPIEnable>//read, copy
+//The batches are served from a mapping of the file(see MappedDataset).
+//A CPU output aliases the mapping, which is read-only,
+//the others are copied into by COPYFUNCTOR.
+//Attributes besides Batch/Shape/filename:
+//  Shuffle:  visit the batches of each epoch in a random order
+//  Seed:     the same seed gives the same orders
+//  Prefetch: number of batches faulted in ahead of use
+//DataMPI splits the items evenly over the workers.
+template <typename COPYFUNCTOR, typename T, bool MPIEnable>
 class DataOpImpl : public OpImpl {
  public:
   explicit DataOpImpl(const OpDef& def) :
-    OpImpl(def), buf_(NULL), curr_idx_(-1) {
+    OpImpl(def), offset_(0), curr_batch_(NULL) {
     batch_ = GetSingleArg<int>(def, "Batch");
     const std::vector<int>& shape = GetListArg<int>(def, "Shape");
     CHECK(!shape.empty());
@@ -39,38 +49,43 @@ class DataOpImpl : public OpImpl {
     CHECK(item_size_ > 0);
     filename_ = GetSingleArg<std::string>(def, "filename");
     CHECK(filename_.length() > 0);
+    shuffle_ = GetSingleArg<bool>(def, "Shuffle", false);
+    seed_ = GetSingleArg<int>(def, "Seed", 0);
+    prefetch_ = GetSingleArg<int>(def, "Prefetch", 2);
     if (MPIEnable) {
-      int size;
-      MPI_Comm_size(MPI_COMM_WORLD, &size); 
-      num_ /= size;
+      Communicator* comm = Communicator::Get();
+      num_ /= comm->size();
+      offset_ = (size_t)comm->rank()*num_*item_size_*sizeof(T);
     }
   }
-  ~DataOpImpl() {
-    if (buf_)  free(buf_); 
-  }
 
   void Compute(OpContext* context) override {
-    if (!buf_) {
-      buf_ = (T*)malloc(num_*item_size_*sizeof(T));
-      READFUNCTOR::Compute(buf_, filename_.c_str(), num_*item_size_*sizeof(T));
+    if (!dataset_) {
+      dataset_.reset(new MappedDataset(filename_, offset_, num_,
+            item_size_*sizeof(T), batch_, shuffle_, seed_, prefetch_));
     }
-    int next_idx = context->round() % (num_/batch_);
-    if (next_idx != curr_idx_) {
-      Tensor* out = context->Output(0);
-      CHECK(out->count() == batch_*item_size_);
-      CHECK(next_idx >= 0 && next_idx < num_/batch_);
-      COPYFUNCTOR::Compute(out->mutable_data<T>(), buf_+next_idx*batch_*item_size_, batch_*item_size_*sizeof(T));
-      curr_idx_ = next_idx;
+    Tensor* out = context->Output(0);
+    CHECK(out->count() == batch_*item_size_);
+    const char* batch = dataset_->Batch(context->round());
+    if (out->device_type() == CPU) {
+      out->AliasExternal(batch);
+    }else if (batch != curr_batch_) {
+      COPYFUNCTOR::Compute(out->mutable_data<T>(), batch, batch_*item_size_*sizeof(T));
     }
+    curr_batch_ = batch;
   }
 
  private:
-  int curr_idx_;
   int batch_;
   int num_;
   int item_size_;
   std::string filename_;
-  T* buf_;
+  size_t offset_;
+  bool shuffle_;
+  int seed_;
+  int prefetch_;
+  std::unique_ptr<MappedDataset> dataset_;
+  const char* curr_batch_;
 };
 
 } //namespace cavs
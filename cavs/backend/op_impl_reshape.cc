@@ -1,9 +1,7 @@
 #include "cavs/backend/op_impl.h"
-#include "cavs/backend/cuda_common.h"
 #include "cavs/midend/allocator.h"
 #include "cavs/proto/tensor_shape.pb.h"
-#include "cavs/util/macros_gpu.h"
-#include "cavs/util/cudnn_types.h"
+#include "cavs/util/logging.h"
 
 namespace backend {
 
@@ -0,0 +1,119 @@
+#include "cavs/backend/op_impl.h"
+#include "cavs/backend/row_sparse_index.h"
+#include "cavs/midend/allocator.h"
+#include "cavs/midend/op_context.h"
+#include "cavs/midend/tensor_test.h"
+#include "cavs/util/logging.h"
+#include "cavs/util/op_def_builder.h"
+#include "cavs/util/op_util.h"
+
+#include <math.h>
+#include <memory>
+
+using namespace midend;
+using namespace backend;
+using namespace midend::test;
+
+const int kRows  = 6;
+const int kWidth = 2;
+const float kLr  = 0.5f;
+
+Tensor HostTensor(const string& name, const vector<int>& shape,
+    const vector<float>& vals) {
+  Tensor t(name, GetAllocator(DeviceTypeToString(CPU)), DT_FLOAT, TensorShape(shape));
+  FillValues<float>(&t, vals);
+  return t;
+}
+
+OpImpl* Create(const string& op, const string& attr = "", float value = 0.f) {
+  OpDefBuilder builder(op);
+  builder.Output(op + "_out").Device("CPU").Dtype(DT_FLOAT);
+  if (!attr.empty())
+    builder.AttrSingle(attr, value);
+  OpDef def;
+  builder.Finalize(&def);
+  return CreateOp(def);
+}
+
+void Run(OpImpl* op, int round,
+    const vector<const Tensor*>& inputs, const vector<Tensor*>& outputs) {
+  OpContext ctxt;
+  ctxt.SetRound(round);
+  for (auto* t : inputs)  ctxt.AppendInput(t);
+  for (auto* t : outputs) ctxt.AppendOutput(t);
+  op->Compute(&ctxt);
+}
+
+void CheckValues(const Tensor& t, const vector<float>& expected) {
+  vector<float> vals;
+  FetchValues<float>(&vals, t);
+  CHECK(vals.size() == expected.size());
+  for (size_t i = 0; i < vals.size(); i++)
+    CHECK(fabs(vals[i] - expected[i]) < 1e-5f)
+      << t.name() << "[" << i << "]: " << vals[i] << " vs " << expected[i];
+}
+
+//the gradient of a variable that is read both densely and through
+//an embedding lookup, as the mirrors of an embedding matrix in a graph
+int main() {
+  std::unique_ptr<OpImpl> accumulate(Create("Accumulate"));
+  std::unique_ptr<OpImpl> lookup_grad(Create(GetGradientName("EmbeddingLookup")));
+  std::unique_ptr<OpImpl> sgd(Create("SGD", "Learning_rate", kLr));
+  std::unique_ptr<OpImpl> clip(Create("Clip", "clip", 100.f));
+
+  //the session clears the gradient before its first writer
+  Tensor grad = HostTensor("grad", {kRows, kWidth}, vector<float>(kRows*kWidth, 0.f));
+  grad.SetZeroInitEnforced();
+  //the lookup gradient is cleared by its index, start with garbage
+  Tensor lookup = HostTensor("lookup", {kRows, kWidth}, vector<float>(kRows*kWidth, 7.f));
+  Tensor var = HostTensor("var", {kRows, kWidth}, vector<float>(kRows*kWidth, 10.f));
+
+  //iteration 0: the dense contribution comes before the sparse one
+  Tensor dense = HostTensor("dense", {kRows, kWidth}, vector<float>(kRows*kWidth, 1.f));
+  Run(accumulate.get(), 0, {&dense}, {&grad});
+  CHECK(!RowSparseIndex::Find(grad));
+
+  //ids 1 and 3, the duplicate id 1 is accumulated
+  Tensor ids = HostTensor("ids", {3}, {1.f, 3.f, 1.f});
+  Tensor dY = HostTensor("dY", {3, kWidth}, {1.f, 2.f, 3.f, 4.f, 5.f, 6.f});
+  Run(lookup_grad.get(), 0, {&dY, &ids}, {&lookup});
+  CHECK(RowSparseIndex::Find(lookup)->rows() == vector<int>({1, 3}));
+  CheckValues(lookup, {0, 0, 6, 8, 0, 0, 3, 4, 0, 0, 0, 0});
+
+  //the sparse rows are added on top of the dense ones, which are kept
+  Run(accumulate.get(), 0, {&lookup}, {&grad});
+  RowSparseIndex* index = RowSparseIndex::Find(grad);
+  CHECK(index && (int)index->rows().size() == kRows);
+  vector<float> expected = {1, 1, 7, 9, 1, 1, 4, 5, 1, 1, 1, 1};
+  CheckValues(grad, expected);
+
+  //the norm is below the threshold, the update visits every row
+  Run(clip.get(), 0, {&grad}, {&grad});
+  CheckValues(grad, expected);
+  Run(sgd.get(), 0, {&var, &grad}, {&var});
+  vector<float> var_expected(kRows*kWidth);
+  for (int i = 0; i < kRows*kWidth; i++)
+    var_expected[i] = 10.f - kLr*expected[i];
+  CheckValues(var, var_expected);
+
+  //iteration 1: only the sparse contribution, the rows of the previous
+  //iteration are cleared and only row 4 is updated
+  Tensor ids1 = HostTensor("ids1", {1}, {4.f});
+  Tensor dY1 = HostTensor("dY1", {1, kWidth}, {30.f, 40.f});
+  Run(lookup_grad.get(), 1, {&dY1, &ids1}, {&lookup});
+  Run(accumulate.get(), 1, {&lookup}, {&grad});
+  CHECK(index->rows() == vector<int>({4}));
+  CheckValues(grad, {0, 0, 0, 0, 0, 0, 0, 0, 30, 40, 0, 0});
+
+  //the norm is 50, so row 4 is scaled to(6, 8) for the clip of 10
+  std::unique_ptr<OpImpl> clip10(Create("Clip", "clip", 10.f));
+  Run(clip10.get(), 1, {&grad}, {&grad});
+  CheckValues(grad, {0, 0, 0, 0, 0, 0, 0, 0, 6, 8, 0, 0});
+  Run(sgd.get(), 1, {&var, &grad}, {&var});
+  var_expected[8] -= kLr*6;
+  var_expected[9] -= kLr*8;
+  CheckValues(var, var_expected);
+
+  LOG(INFO) << "Row-sparse CPU gradients passed";
+  return 0;
+}
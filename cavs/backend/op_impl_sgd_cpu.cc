@@ -0,0 +1,64 @@
+#include "cavs/backend/op_impl.h"
+#include "cavs/backend/op_impl_elementwise_cpu.h"
+#include "cavs/backend/row_sparse_index.h"
+#include "cavs/midend/tensor.h"
+#include "cavs/midend/op_context.h"
+#include "cavs/util/logging.h"
+
+namespace backend {
+
+using ::midend::OpContext;
+using ::midend::Tensor;
+
+//For a row-sparse gradient updated in place, only the touched rows
+//of the variable are visited(lazy update).
+template <typename T>
+class SGDOpCpu : public OpImpl {
+ public:
+  explicit SGDOpCpu(const OpDef& def)
+    : OpImpl(def), lr_(0.f) {
+    lr_ = GetSingleArg<float>(def, "Learning_rate");
+    VLOG(V_DEBUG) << "learning_rate = " << lr_;
+  }
+
+  void Compute(OpContext* context) override {
+    const Tensor& inp0 = context->Input(0);
+    const Tensor& inp1 = context->Input(1);
+    inp0.DebugNumerical<T>();
+    inp1.DebugNumerical<T>();
+    Tensor* out = context->Output(0);
+    const T lr = lr_;
+    T* o = out->mutable_data<T>();
+    const T* var = inp0.data<T>();
+    const T* grad = inp1.data<T>();
+    RowSparseIndex* index = RowSparseIndex::Find(inp1);
+    if (index && o == var) {
+      const std::vector<int>& rows = index->rows();
+      const int width = index->row_width();
+      const int* r = rows.data();
+      CHECK(out->count() == index->num_rows()*width);
+      ElementwiseParallelFor(rows.size(), width, [=](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+          const size_t offset = size_t(r[i])*width;
+          for (int j = 0; j < width; j++)
+            o[offset+j] -= lr*grad[offset+j];
+        }
+      });
+      VLOG(V_DEBUG) << "Updating " << rows.size() << " of "
+                    << index->num_rows() << " rows";
+    }else {
+      ElementwiseParallelFor(out->count(), 1, [=](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++)
+          o[i] = var[i] - lr*grad[i];
+      });
+    }
+    out->DebugNumerical<T>();
+  }
+
+ private:
+  float lr_;
+};
+
+REGISTER_OP_IMPL_BUILDER(Key("SGD").Device("CPU"), SGDOpCpu<float>);
+
+} //namespace backend
@@ -174,9 +174,7 @@ inline DDVOpImpl<FILLFUNCTOR, T, MPIEnable>::DDVOpImpl(const OpDef& def)
     item_size_ *= shape[i];
   CHECK(item_size_ > 0);
   if (MPIEnable) {
-    int size;
-    MPI_Comm_size(MPI_COMM_WORLD, &size); 
-    num_ /= size;
+    num_ /= Communicator::Get()->size();
   }
 }
 
@@ -0,0 +1,85 @@
+#include "cavs/backend/row_sparse_index.h"
+#include "cavs/util/logging.h"
+
+#include <string.h>
+#include <algorithm>
+#include <unordered_map>
+#include <mutex>
+
+using std::vector;
+using std::unordered_map;
+
+namespace backend {
+
+namespace {
+
+//the ops of the inter-op executor may look up concurrently
+std::mutex index_mu;
+unordered_map<const midend::TensorBufferBase*, RowSparseIndex*> indices;
+
+} //namespace
+
+RowSparseIndex::RowSparseIndex(Tensor* grad, size_t elem_size, int iteration)
+    : data_(grad->mutable_data<char>()), iteration_(-1), sorted_(true) {
+  CHECK(grad->dims() == 2) << grad->debug_info();
+  CHECK(grad->device_type() == CPU) << grad->debug_info();
+  CHECK(!grad->IsDynamicShape()) << grad->debug_info();
+  row_width_ = grad->dims(1);
+  row_bytes_ = row_width_*elem_size;
+  //from now on, the rows are cleared by Begin
+  if (grad->ZeroInitEnforced()) {
+    //the session has cleared the buffer in this iteration,
+    //but a dense Accumulate may have added to it since,
+    //so every row counts as touched until the next iteration
+    grad->UnsetZeroInitEnforced();
+    touched_.assign(grad->dims(0), true);
+    rows_.resize(grad->dims(0));
+    for (int r = 0; r < grad->dims(0); r++)
+      rows_[r] = r;
+    iteration_ = iteration;
+  }else {
+    touched_.assign(grad->dims(0), false);
+    memset(data_, 0, grad->dims(0)*row_bytes_);
+  }
+  VLOG(V_DEBUG) << "Row-sparse gradient " << grad->name()
+                << " with " << grad->dims(0) << " rows";
+}
+
+RowSparseIndex* RowSparseIndex::Get(Tensor* grad, size_t elem_size,
+    int iteration) {
+  std::lock_guard<std::mutex> lock(index_mu);
+  RowSparseIndex*& index = indices[grad->buffer()];
+  if (!index)
+    index = new RowSparseIndex(grad, elem_size, iteration);
+  CHECK(index->data_ == grad->mutable_data<char>());
+  CHECK(index->row_bytes_ == grad->dims(1)*elem_size);
+  return index;
+}
+
+RowSparseIndex* RowSparseIndex::Find(const Tensor& t) {
+  std::lock_guard<std::mutex> lock(index_mu);
+  auto it = indices.find(t.buffer());
+  return (it == indices.end()) ? NULL : it->second;
+}
+
+void RowSparseIndex::Begin(int iteration) {
+  if (iteration == iteration_)
+    return;
+  for (int r : rows_) {
+    memset(data_ + r*row_bytes_, 0, row_bytes_);
+    touched_[r] = false;
+  }
+  rows_.clear();
+  sorted_ = true;
+  iteration_ = iteration;
+}
+
+const vector<int>& RowSparseIndex::rows() {
+  if (!sorted_) {
+    std::sort(rows_.begin(), rows_.end());
+    sorted_ = true;
+  }
+  return rows_;
+}
+
+} //namespace backend
@@ -0,0 +1,56 @@
+#ifndef CAVS_BACKEND_ROW_SPARSE_INDEX_H_
+#define CAVS_BACKEND_ROW_SPARSE_INDEX_H_
+
+#include "cavs/midend/tensor.h"
+
+#include <vector>
+
+namespace backend {
+
+using ::midend::Tensor;
+
+//A row-sparse gradient keeps the dense buffer of its variable,
+//but only the rows listed in the index are non-zero.
+//The embedding backward creates the index of its output, the optimizer
+//ops(Accumulate/Clip/SGD) look it up and visit those rows only.
+//The index takes over the zeroing of the session: instead of clearing
+//the whole V*E buffer in each iteration, the first writer of an iteration
+//clears the rows left by the previous one.
+//Tensors sharing memory(the gradients of Mirrors) share the index.
+class RowSparseIndex {
+ public:
+  //creates the index of a 2-D gradient on the first call,
+  //keeping what the dense writers have added in this iteration
+  static RowSparseIndex* Get(Tensor* grad, size_t elem_size, int iteration);
+  //NULL if the tensor is dense
+  static RowSparseIndex* Find(const Tensor& t);
+
+  //must be called by each writer before touching the rows
+  void Begin(int iteration);
+  //duplicate ids are recorded once
+  inline void Touch(int row) {
+    if (!touched_[row]) {
+      touched_[row] = true;
+      rows_.push_back(row);
+      sorted_ = false;
+    }
+  }
+  //in ascending order, so that the updates stream through the buffer
+  const std::vector<int>& rows();
+  inline int num_rows() const { return touched_.size(); }
+  inline int row_width() const { return row_width_; }
+
+ private:
+  RowSparseIndex(Tensor* grad, size_t elem_size, int iteration);
+  char* data_;
+  size_t row_bytes_;
+  int row_width_;
+  int iteration_;
+  bool sorted_;
+  std::vector<bool> touched_;
+  std::vector<int> rows_;
+};
+
+} //namespace backend
+
+#endif
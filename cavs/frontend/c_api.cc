@@ -65,6 +65,14 @@ C_Session* C_NewSession(const char* name, size_t name_len, int opt) {
   return new C_Session{sess};
 }
 
+void C_SetSessionAllocator(C_Session* s,
+    const char* name, size_t name_len) {
+  string name_str(name, name_len);
+  midend::Allocator* alloc = GetAllocator(name_str);
+  CHECK(alloc) << "No allocator named " << name_str;
+  s->session->SetAllocator(alloc);
+}
+
 C_Tensor* C_NewTensor(const char* name, size_t name_len, 
     const int* shape, int dims, C_Dtype dtype) {
   string name_str(name, name_len);
@@ -78,7 +86,7 @@ C_Tensor* C_NewTensor(const char* name, size_t name_len,
 }
 
 C_Scope* C_GetMainScope() {
-  static C_Scope* scope = new C_Scope{ main_scope() };
+  static thread_local C_Scope* scope = new C_Scope{ main_scope() };
   return scope;
 }
 
@@ -171,6 +179,12 @@ void C_Run(C_Session* s,
   }
 }
 
+void C_PrefetchGraph(C_Session* s,
+    const char* c_input_name, const C_Tensor* c_graph) {
+  CHECK(c_graph);
+  s->session->PrefetchGraph(c_input_name, c_graph->tensor);
+}
+
 void* C_TensorData(const C_Tensor* t) { 
   CHECK(t);
   if (midend::TensorCApi::IsVirtual(t->tensor))
@@ -186,3 +200,11 @@ size_t C_TensorSize(const C_Tensor* t) {
     return midend::TensorCApi::size(t->tensor); 
 }
 
+void C_TensorBufferStats(size_t* resizes,
+    size_t* avoided_resizes, size_t* shrinks, int reset) {
+  midend::TensorBufferPolicy::Stats stats =
+    midend::TensorBufferPolicy::Get()->GetStats(reset);
+  *resizes = stats.resizes;
+  *avoided_resizes = stats.avoided_resizes;
+  *shrinks = stats.shrinks;
+}
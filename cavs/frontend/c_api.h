@@ -19,6 +19,8 @@ typedef struct C_Scope    C_Scope;
 
 extern C_Session* C_NewSession(
     const char* name, size_t name_len, int opt);
+extern void C_SetSessionAllocator(C_Session* s,
+    const char* name, size_t name_len);
 extern C_Tensor* C_NewTensor(const char* name, size_t name_len, 
     const int* shape, int dims, C_Dtype dtype);
 //extern void C_DumpGraph(C_DepGraph* c_graph);
@@ -32,8 +34,15 @@ extern void C_AddControlDependency(const void* def, size_t def_length);
 extern void C_Run(C_Session* s, 
     const char** c_output_names, C_Tensor** c_output_tensors, int noutputs,
     const char** c_input_names, C_Tensor* const* c_input_tensors, int ninputs);
+//the parent-idx tensor fed to c_input_name in a coming C_Run,
+//the graph schedules are prepared in the background meanwhile
+extern void C_PrefetchGraph(C_Session* s,
+    const char* c_input_name, const C_Tensor* c_graph);
 extern void* C_TensorData(const C_Tensor* t);
 extern size_t C_TensorSize(const C_Tensor* t);
+//counters of the dynamic tensor buffers, reset them once per epoch
+extern void C_TensorBufferStats(size_t* resizes,
+    size_t* avoided_resizes, size_t* shrinks, int reset);
 
 #ifdef __cplusplus
 } //end extern "C"
@@ -0,0 +1,142 @@
+#include "cavs/frontend/cxx/batch_sampler.h"
+#include "cavs/util/logging.h"
+
+#include <stdint.h>
+#include <algorithm>
+#include <numeric>
+
+using std::vector;
+
+namespace {
+
+//FNV-1a of the vertices per round
+size_t HashProfile(const vector<int>& profile) {
+  uint64_t h = 14695981039346656037ULL;
+  for (int n : profile) {
+    h ^= (uint64_t)n;
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+} //namespace
+
+SampleShape TreeShape(const int* parents, int length) {
+  CHECK(length > 0);
+  vector<int> pending(length, 0);
+  for (int i = 0; i < length; i++) {
+    if (parents[i] >= 0) {
+      CHECK(parents[i] < length) << parents[i];
+      pending[parents[i]]++;
+    }
+  }
+  //the round of each vertex, from the leaves up
+  vector<int> round(length, 0);
+  vector<int> ready;
+  for (int i = 0; i < length; i++)
+    if (pending[i] == 0) ready.push_back(i);
+  vector<int> profile;
+  int visited = 0;
+  while (!ready.empty()) {
+    int v = ready.back();
+    ready.pop_back();
+    visited++;
+    if ((int)profile.size() <= round[v]) profile.resize(round[v]+1, 0);
+    profile[round[v]]++;
+    int p = parents[v];
+    if (p >= 0) {
+      round[p] = std::max(round[p], round[v]+1);
+      if (--pending[p] == 0) ready.push_back(p);
+    }
+  }
+  CHECK(visited == length) << "the parents contain a cycle";
+  SampleShape shape;
+  shape.rounds = profile.size();
+  shape.size = length;
+  shape.signature = HashProfile(profile);
+  return shape;
+}
+
+SampleShape SequenceShape(int length) {
+  CHECK(length > 0);
+  SampleShape shape;
+  shape.rounds = length;
+  shape.size = length;
+  shape.signature = HashProfile(vector<int>(length, 1));
+  return shape;
+}
+
+BatchStats EvaluateBatch(const vector<SampleShape>& shapes,
+    const vector<int>& batch) {
+  BatchStats stats;
+  stats.rounds = 0;
+  stats.size = 0;
+  size_t sample_rounds = 0;
+  for (int id : batch) {
+    stats.rounds = std::max(stats.rounds, shapes[id].rounds);
+    stats.size += shapes[id].size;
+    sample_rounds += shapes[id].rounds;
+  }
+  stats.avg_round_batch = stats.rounds ? float(stats.size)/stats.rounds : 0.f;
+  stats.efficiency = stats.rounds ?
+    float(sample_rounds)/(stats.rounds*batch.size()) : 0.f;
+  return stats;
+}
+
+BatchSampler::BatchSampler(const vector<SampleShape>& shapes, int batch,
+    float randomness, int seed)
+    : shapes_(shapes), batch_(batch), randomness_(randomness),
+      gen_(seed), next_(0) {
+  CHECK(batch_ > 0);
+  CHECK((int)shapes_.size() >= batch_) << shapes_.size() << "\t" << batch_;
+  CHECK(randomness_ >= 0.f && randomness_ <= 1.f) << randomness_;
+}
+
+void BatchSampler::PlanEpoch() {
+  const int n = shapes_.size();
+  int min_rounds = shapes_[0].rounds;
+  int max_rounds = shapes_[0].rounds;
+  for (auto& s : shapes_) {
+    min_rounds = std::min(min_rounds, s.rounds);
+    max_rounds = std::max(max_rounds, s.rounds);
+  }
+  const float blur = randomness_*(max_rounds - min_rounds + 1);
+  std::uniform_real_distribution<float> noise(0.f, blur);
+  vector<int> key(n);
+  for (int i = 0; i < n; i++)
+    key[i] = int(shapes_[i].rounds + (blur > 0 ? noise(gen_) : 0.f));
+
+  //the shuffle breaks the remaining ties randomly
+  vector<int> order(n);
+  std::iota(order.begin(), order.end(), 0);
+  std::shuffle(order.begin(), order.end(), gen_);
+  std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+    if (key[a] != key[b]) return key[a] < key[b];
+    if (shapes_[a].signature != shapes_[b].signature)
+      return shapes_[a].signature < shapes_[b].signature;
+    return shapes_[a].size < shapes_[b].size;
+  });
+
+  epoch_.resize(n/batch_);
+  for (size_t b = 0; b < epoch_.size(); b++)
+    epoch_[b].assign(order.begin() + b*batch_, order.begin() + (b+1)*batch_);
+  std::shuffle(epoch_.begin(), epoch_.end(), gen_);
+  next_ = 0;
+
+  if (VLOG_IS_ON(V_DEBUG)) {
+    float efficiency = 0.f;
+    for (auto& b : epoch_)
+      efficiency += EvaluateBatch(shapes_, b).efficiency;
+    VLOG(V_DEBUG) << "[BatchSampler] " << epoch_.size() << " batches, "
+                  << "average efficiency: " << efficiency/epoch_.size();
+  }
+}
+
+const vector<int>& BatchSampler::Next(BatchStats* stats) {
+  if (next_ >= (int)epoch_.size())
+    PlanEpoch();
+  const vector<int>& batch = epoch_[next_++];
+  if (stats)
+    *stats = EvaluateBatch(shapes_, batch);
+  return batch;
+}
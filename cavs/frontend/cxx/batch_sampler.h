@@ -0,0 +1,62 @@
+#ifndef CAVS_FRONTEND_CXX_BATCH_SAMPLER_H_
+#define CAVS_FRONTEND_CXX_BATCH_SAMPLER_H_
+
+#include <stddef.h>
+#include <random>
+#include <vector>
+
+//The structure of a sample as seen by the BatchGraphScheduler:
+//a vertex runs in the round after the last of its children,
+//so a batch takes as many rounds as its highest sample.
+struct SampleShape {
+  int rounds;
+  int size;
+  //a hash of the vertices per round, samples of the same signature
+  //fill the rounds of a batch alike(and share a cached round plan)
+  size_t signature;
+};
+
+//parents are 0-based, the root has -1
+SampleShape TreeShape(const int* parents, int length);
+SampleShape SequenceShape(int length);
+
+struct BatchStats {
+  int rounds;
+  int size;
+  //vertices per round
+  float avg_round_batch;
+  //the rounds of the samples over the rounds of the batch,
+  //1 if every sample keeps working until the last round
+  float efficiency;
+};
+BatchStats EvaluateBatch(const std::vector<SampleShape>& shapes,
+    const std::vector<int>& batch);
+
+//Assembles the batches of an epoch from samples of similar shape:
+//the samples are sorted by rounds, signature and size, cut into batches,
+//and the batches are visited in a random order.
+//randomness(0-1) is the budget for the quality of training: each sample's
+//rounds are blurred by up to randomness times the range of rounds before
+//sorting, so 0 gives the tightest buckets and 1 nearly random batches.
+//The samples left over a whole batch are not visited in that epoch.
+class BatchSampler {
+ public:
+  BatchSampler(const std::vector<SampleShape>& shapes, int batch,
+      float randomness = 0.1f, int seed = 0);
+  //the sample ids of the next batch, valid until the next call
+  const std::vector<int>& Next(BatchStats* stats = NULL);
+  inline int batch() const { return batch_; }
+  inline int batches_per_epoch() const { return shapes_.size()/batch_; }
+
+ private:
+  void PlanEpoch();
+
+  std::vector<SampleShape> shapes_;
+  const int batch_;
+  const float randomness_;
+  std::mt19937 gen_;
+  std::vector<std::vector<int>> epoch_;
+  int next_;
+};
+
+#endif
@@ -0,0 +1,42 @@
+#include "cavs/frontend/cxx/batch_sampler.h"
+#include "cavs/util/logging.h"
+
+#include <set>
+#include <vector>
+
+using std::vector;
+
+int main() {
+  //leaves 0 1 2, 3 over 0 1, the root 4 over 2 3
+  const int parents[] = {3, 3, 4, 4, -1};
+  SampleShape tree = TreeShape(parents, 5);
+  CHECK(tree.rounds == 3 && tree.size == 5);
+  CHECK(SequenceShape(3).rounds == 3);
+  CHECK(SequenceShape(3).signature != tree.signature);
+
+  vector<SampleShape> shapes;
+  for (int i = 0; i < 1000; i++)
+    shapes.push_back(SequenceShape(1 + (i*7919) % 50));
+  const int batch = 16;
+  float bucketed = 0.f, random = 0.f;
+  BatchSampler tight(shapes, batch, 0.f, 1);
+  BatchSampler loose(shapes, batch, 1.f, 1);
+  std::set<int> visited;
+  for (int b = 0; b < tight.batches_per_epoch(); b++) {
+    BatchStats stats;
+    const vector<int>& ids = tight.Next(&stats);
+    CHECK((int)ids.size() == batch);
+    visited.insert(ids.begin(), ids.end());
+    bucketed += stats.efficiency;
+    loose.Next(&stats);
+    random += stats.efficiency;
+  }
+  CHECK((int)visited.size() == tight.batches_per_epoch()*batch);
+  bucketed /= tight.batches_per_epoch();
+  random /= tight.batches_per_epoch();
+  CHECK(bucketed > 0.95f) << bucketed;
+  CHECK(bucketed > random) << bucketed << "\t" << random;
+  LOG(INFO) << "BatchSampler passed, efficiency: " << bucketed
+            << " vs " << random;
+  return 0;
+}
@@ -1,11 +1,72 @@
+#include "cavs/frontend/cxx/graphsupport.h"
 #include "cavs/frontend/cxx/session.h"
 #include "cavs/proto/opt.pb.h"
 #include "cavs/util/logging.h"
 
 #include <iostream>
+#include <vector>
 
 using namespace std;
 
+//h = (left * left + right) * w * scale + x, which the MatMul splits into two groups:
+//  the children part reads nothing but gathered rows, so it stays unfused,
+//  the rest reads the pulled rows indirectly, and scale has one element
+//  for the whole batch, so the fused kernel runs its broadcast loop
+class ScaledTree : public GraphSupport {
+ public:
+  ScaledTree(const Sym& graph_ph, const Sym& vertex_ph,
+      const Sym& weight, const Sym& scale) :
+    GraphSupport(graph_ph, vertex_ph), weight_(weight), scale_(scale) {}
+
+  void Node() override {
+    Sym left  = Gather(0, {1});
+    Sym right = Gather(1, {1});
+    Sym x     = Pull(0, {1});
+    Sym sum = (left * left + right).Reshape({1, 1});
+    Sym h = Sym::MatMul(sum, weight_).Reshape({1}) * scale_ + x;
+    Scatter(h);
+    Push(h);
+  }
+
+ private:
+  Sym weight_;
+  Sym scale_;
+};
+
+//the node function is defined once per process,
+//so the tree is compared with the results of the unfused operators
+vector<float> RunScaledTree(int opt) {
+  //sample 0: nodes 0 and 1 under the root 2, sample 1: node 0 under the root 1
+  vector<int>   graph_data  = {2, 2, -1, 1, -1, -1};
+  vector<float> vertex_data = {1, 2,  3, 4,  5,  0};
+  vector<float> weight_data = {2};
+  vector<float> scale_data  = {0.5};
+
+  Sym graph  = Sym::Placeholder(DT_FLOAT, {2, 3}, "CPU");
+  Sym vertex = Sym::Placeholder(DT_FLOAT, {2, 3});
+  Sym weight = Sym::Placeholder(DT_FLOAT, {1, 1});
+  Sym scale  = Sym::Placeholder(DT_FLOAT, {1});
+  ScaledTree model(graph, vertex, weight, scale);
+  Sym output = model.Output();
+
+  Session sess(opt);
+  sess.Run({output}, {{graph,  graph_data.data()},
+                      {vertex, vertex_data.data()},
+                      {weight, weight_data.data()},
+                      {scale,  scale_data.data()}});
+  const float* data = (const float*)output.data();
+  return vector<float>(data, data+5);
+}
+
+void TestFusedGraph(int opt) {
+  vector<float> fused = RunScaledTree(opt);
+  //the leaves only pull, the roots read their children
+  vector<float> unfused = {1, 2, 6, 4, 21};
+  for (int i = 0; i < 5; i++)
+    CHECK(fused[i] == unfused[i]) << i << "\t" << fused[i] << "\t" << unfused[i];
+  LOG(INFO) << "Fused graph matches the unfused one";
+}
+
 int main(int argc, char* argv[]) {
   gflags::ParseCommandLineFlags(&argc, &argv, true);
 
@@ -34,6 +95,8 @@ int main(int argc, char* argv[]) {
                      {X, X_data.data()}, {Y, Y_data.data()}, {Z, Z_data.data()}});
   E.print();
   YY.print();
+
+  TestFusedGraph((int)(OPT_BATCHING | OPT_FUSION));
   return 0;
 }
 
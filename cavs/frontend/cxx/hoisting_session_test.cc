@@ -0,0 +1,272 @@
+#include "cavs/frontend/cxx/graphsupport.h"
+#include "cavs/frontend/cxx/session.h"
+#include "cavs/proto/opt.pb.h"
+#include "cavs/util/logging.h"
+
+#include <math.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <functional>
+#include <tuple>
+#include <vector>
+
+using namespace std;
+
+const int kVocab  = 10;
+const int kEmbed  = 4;
+const int kHidden = 8;
+const int kBatch  = 2;
+const int kLength = 7;
+const int kNodes  = 10;
+const int kIters  = 3;
+
+//sample 0: a full binary tree of four leaves, sample 1: two leaves
+const vector<int> kGraph = {4, 4, 5, 5, 6, 6, -1,
+                            2, 2, -1, -1, -1, -1, -1};
+const vector<float> kWords = {1, 3, 5, 7, 2, 4, 6,
+                              8, 9, 0, 0, 0, 0, 0};
+
+//h = x*W + h_left + h_right, whose embedding lookup and x*W
+//read nothing but the pulled words, so they are hoisted out of the rounds
+class ProjectedTree : public GraphSupport {
+ public:
+  ProjectedTree(const Sym& graph_ph, const Sym& vertex_ph,
+      const Sym& embedding, const Sym& W) :
+    GraphSupport(graph_ph, vertex_ph), embedding_(embedding), W_(W) {}
+
+  void Node() override {
+    Sym left  = Gather(0, {kHidden});
+    Sym right = Gather(1, {kHidden});
+    Sym x  = Pull(0, {1}).EmbeddingLookup(embedding_);
+    Sym xW = Sym::MatMul(x, W_).Reshape({kHidden});
+    Sym h = xW + left + right;
+    Scatter(h);
+    Push(h);
+  }
+
+ private:
+  Sym embedding_;
+  Sym W_;
+};
+
+vector<float> EmbeddingData() {
+  vector<float> data(kVocab*kEmbed);
+  for (int i = 0; i < kVocab*kEmbed; i++)
+    data[i] = float(i%7)/7.f - 0.5f;
+  return data;
+}
+
+vector<float> WData() {
+  vector<float> data(kEmbed*kHidden);
+  for (int i = 0; i < kEmbed*kHidden; i++)
+    data[i] = float(i%5)/5.f - 0.25f;
+  return data;
+}
+
+//the graph outputs of every iteration, the batch after the first one
+//is prefetched so that its rounds are planned ahead
+vector<float> Forward(int opt) {
+  vector<int>   graph_data = kGraph;
+  vector<float> word_data  = kWords;
+  vector<float> embedding_data = EmbeddingData();
+  vector<float> W_data = WData();
+
+  Sym graph  = Sym::Placeholder(DT_FLOAT, {kBatch, kLength}, "CPU");
+  Sym vertex = Sym::Placeholder(DT_FLOAT, {kBatch, kLength});
+  Sym embedding = Sym::Placeholder(DT_FLOAT, {kVocab, kEmbed});
+  Sym W = Sym::Placeholder(DT_FLOAT, {kEmbed, kHidden});
+  ProjectedTree model(graph, vertex, embedding, W);
+  Sym output = model.Output();
+
+  Session sess(opt);
+  vector<float> outputs;
+  for (int iter = 0; iter < kIters; iter++) {
+    sess.Run({output}, {{graph,     graph_data.data()},
+                        {vertex,    word_data.data()},
+                        {embedding, embedding_data.data()},
+                        {W,         W_data.data()}});
+    const float* data = (const float*)output.data();
+    outputs.insert(outputs.end(), data, data+kNodes*kHidden);
+    if (iter+1 < kIters)
+      sess.Prefetch(graph, graph_data.data());
+  }
+  return outputs;
+}
+
+//the same tree on the host, in global id order
+vector<float> Reference() {
+  vector<float> embedding = EmbeddingData();
+  vector<float> W = WData();
+  vector<float> h;
+  for (int b = 0; b < kBatch; b++) {
+    //the root is the first vertex without a parent,
+    //the children come before their parents
+    int len = 1;
+    while (kGraph[b*kLength+len-1] != -1)
+      len++;
+    vector<vector<float>> rows(len, vector<float>(kHidden, 0.f));
+    for (int v = 0; v < len; v++) {
+      const int word = kWords[b*kLength+v];
+      for (int j = 0; j < kHidden; j++) {
+        for (int k = 0; k < kEmbed; k++)
+          rows[v][j] += embedding[word*kEmbed+k] * W[k*kHidden+j];
+      }
+      for (int c = 0; c < v; c++) {
+        if (kGraph[b*kLength+c] == v) {
+          for (int j = 0; j < kHidden; j++)
+            rows[v][j] += rows[c][j];
+        }
+      }
+    }
+    for (auto& row : rows)
+      h.insert(h.end(), row.begin(), row.end());
+  }
+  CHECK(h.size() == kNodes*kHidden) << h.size();
+  return h;
+}
+
+//the node function can be defined only once in a process,
+//so every configuration runs in a child process of its own
+vector<float> RunInChild(const function<vector<float>()>& f) {
+  int fd[2];
+  CHECK(pipe(fd) == 0);
+  pid_t pid = fork();
+  CHECK(pid >= 0);
+  if (pid == 0) {
+    close(fd[0]);
+    vector<float> vals = f();
+    int count = vals.size();
+    CHECK(write(fd[1], &count, sizeof(int)) == sizeof(int));
+    CHECK(write(fd[1], vals.data(), count*sizeof(float)) == (ssize_t)(count*sizeof(float)));
+    close(fd[1]);
+    _exit(0);
+  }
+  close(fd[1]);
+  int count = 0;
+  CHECK(read(fd[0], &count, sizeof(int)) == sizeof(int));
+  vector<float> vals(count);
+  size_t done = 0;
+  while (done < count*sizeof(float)) {
+    ssize_t n = read(fd[0], (char*)vals.data() + done, count*sizeof(float) - done);
+    CHECK(n > 0);
+    done += n;
+  }
+  close(fd[0]);
+  int status = 0;
+  CHECK(waitpid(pid, &status, 0) == pid);
+  CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  return vals;
+}
+
+void CheckClose(const vector<float>& a, const vector<float>& b, const string& what) {
+  CHECK(!a.empty() && a.size() == b.size()) << what << "\t" << a.size() << "\t" << b.size();
+  for (size_t i = 0; i < a.size(); i++) {
+    CHECK(fabs(a[i] - b[i]) <= 1e-5f * (1.f + fabs(a[i])))
+      << what << "\t" << i << "\t" << a[i] << "\t" << b[i];
+  }
+}
+
+void TestHoistedForward() {
+  vector<float> plain   = RunInChild([]() { return Forward((int)OPT_BATCHING); });
+  vector<float> hoisted = RunInChild([]() { return Forward((int)(OPT_BATCHING | OPT_HOISTING)); });
+  CheckClose(plain, hoisted, "hoisted");
+  const vector<float> reference = Reference();
+  for (int iter = 0; iter < kIters; iter++) {
+    CheckClose(reference, vector<float>(hoisted.begin() + iter*kNodes*kHidden,
+                                        hoisted.begin() + (iter+1)*kNodes*kHidden),
+               "iteration " + to_string(iter));
+  }
+  LOG(INFO) << "Hoisted outputs match the plain ones";
+}
+
+#ifdef CAVS_WITH_CUDA
+//a small child-sum tree-lstm, trained with the Variables
+//(which the CPU-only build lacks), whose embedding lookup and x*W
+//are hoisted out of the rounds as well
+class TreeModel : public GraphSupport {
+ public:
+  TreeModel(const Sym& graph_ph, const Sym& vertex_ph) :
+    GraphSupport(graph_ph, vertex_ph) {
+    embedding = Sym::Variable(DT_FLOAT, {kVocab, kEmbed}, Sym::Uniform(-0.5, 0.5));
+    W = Sym::Variable(DT_FLOAT, {kEmbed, 4 * kHidden}, Sym::Uniform(-0.5, 0.5));
+    U = Sym::Variable(DT_FLOAT, {kHidden, 4 * kHidden}, Sym::Uniform(-0.5, 0.5));
+  }
+
+  void Node() override {
+    Sym left = Gather(0, {2 * kHidden});
+    Sym right = Gather(1, {2 * kHidden});
+    Sym h_l, c_l, h_r, c_r;
+    tie(h_l, c_l) = left.Split2();
+    tie(h_r, c_r) = right.Split2();
+    Sym h_lr = h_l + h_r;
+
+    Sym x = Pull(0, {1}).EmbeddingLookup(embedding.Mirror());
+    Sym xW = Sym::MatMul(x, W.Mirror()).Reshape({4 * kHidden});
+    Sym hU = Sym::MatMul(h_lr.Reshape({1, kHidden}), U.Mirror()).Reshape({4 * kHidden});
+    Sym xW_i, xW_o, xW_u, xW_f;
+    tie(xW_i, xW_o, xW_u, xW_f) = xW.Split4();
+    Sym hU_i, hU_o, hU_u, hU_f;
+    tie(hU_i, hU_o, hU_u, hU_f) = hU.Split4();
+
+    Sym i = (xW_i + hU_i).Sigmoid();
+    Sym o = (xW_o + hU_o).Sigmoid();
+    Sym u = (xW_u + hU_u).Tanh();
+    Sym f = (xW_f + hU_f).Sigmoid();
+    Sym c = i * u + f * (c_l + c_r);
+    Sym h = o * Sym::Tanh(c.Mirror());
+
+    Scatter(Sym::Concat({h.Mirror(), c.Mirror()}));
+    Push(h.Mirror());
+  }
+
+  Sym embedding, W, U;
+};
+
+//the variables after a few training iterations,
+//which only match if every gradient matched
+vector<float> Train(int opt) {
+  vector<int>   graph_data = kGraph;
+  vector<float> word_data  = kWords;
+
+  Sym graph  = Sym::Placeholder(DT_FLOAT, {kBatch, kLength}, "CPU");
+  Sym vertex = Sym::Placeholder(DT_FLOAT, {kBatch, kLength});
+  TreeModel model(graph, vertex);
+  Sym loss = model.Output().Reduce_sum();
+  Sym train = loss.Optimizer({}, 0.1);
+
+  Session sess(opt);
+  for (int iter = 0; iter < kIters; iter++) {
+    sess.Run({train}, {{graph,  graph_data.data()},
+                       {vertex, word_data.data()}});
+    //the next batch is the same one, so the plan made ahead is taken
+    if (iter+1 < kIters)
+      sess.Prefetch(graph, graph_data.data());
+  }
+  sess.Run({model.embedding, model.W, model.U});
+
+  vector<float> vars;
+  for (Sym* s : {&model.embedding, &model.W, &model.U}) {
+    int count = 1;
+    for (int d : s->shape(0)) count *= d;
+    const float* data = (const float*)s->data();
+    vars.insert(vars.end(), data, data+count);
+  }
+  return vars;
+}
+
+void TestHoistedGradients() {
+  vector<float> plain   = RunInChild([]() { return Train((int)OPT_BATCHING); });
+  vector<float> hoisted = RunInChild([]() { return Train((int)(OPT_BATCHING | OPT_HOISTING)); });
+  CheckClose(plain, hoisted, "trained");
+  LOG(INFO) << "Hoisted gradients match the plain ones";
+}
+#endif
+
+int main(int argc, char* argv[]) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  TestHoistedForward();
+#ifdef CAVS_WITH_CUDA
+  TestHoistedGradients();
+#endif
+  return 0;
+}
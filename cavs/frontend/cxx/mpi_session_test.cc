@@ -1,11 +1,50 @@
 #include "cavs/frontend/cxx/session.h"
+#include "cavs/util/communicator.h"
 #include "cavs/util/logging.h"
 
+#include <math.h>
+#include <stdlib.h>
 #include <iostream>
 
 using namespace std;
 
+//two threaded workers build and run their own sessions at the same time,
+//a one-float bucket limit gives each gradient a bucket of its own
+void TestThreaded() {
+  const int size = 2;
+  const float lr = 0.1f;
+  setenv("CAVS_MPI_BUCKET_BYTES", "4", 1);
+  vector<float> B_data = {1, 2, 3, 4, 5, 6};
+  Communicator::RunThreaded(size, [&](int rank) {
+    Sym A1 = Sym::Variable(DT_FLOAT, {2, 3}, Sym::Ones());
+    Sym A2 = Sym::Variable(DT_FLOAT, {2, 3}, Sym::Ones());
+    Sym B = Sym::Placeholder(DT_FLOAT, {2, 3});
+    Sym C = A1 * B + A2 * B;
+    Sym D = C.Optimizer({A1, A2}, lr);
+
+    MPISession sess;
+    vector<float> mine(B_data.size());
+    for (size_t i = 0; i < mine.size(); i++)
+      mine[i] = (rank+1)*B_data[i];
+    sess.Run({D}, {{B, mine.data()}});
+    //the gradients are summed over the workers, so is the fetched output
+    sess.Run({A1, A2});
+    for (Sym* A : {&A1, &A2}) {
+      const float* data = (const float*)A->data();
+      for (size_t i = 0; i < B_data.size(); i++) {
+        float expected = size*(1.f - lr*size*(size+1)/2*B_data[i]);
+        CHECK(fabs(data[i] - expected) < 1e-4f)
+          << rank << "\t" << i << "\t" << data[i] << "\t" << expected;
+      }
+    }
+  });
+  unsetenv("CAVS_MPI_BUCKET_BYTES");
+  LOG(INFO) << "Threaded MPISessions passed";
+}
+
 int main() {
+  TestThreaded();
+
   Sym A = Sym::Variable(DT_FLOAT, {2, 3}, Sym::Ones()); 
   Sym B = Sym::Placeholder(DT_FLOAT, {2, 3});
   Sym C = A * B;
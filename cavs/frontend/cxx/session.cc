@@ -47,3 +47,17 @@ void Session::Run(vector<Sym> outputs,
   for (auto* t : output_tensor)
     free(t);
 }
+
+void Session::Prefetch(Sym& graph, void* data) {
+  //the data is copied by the schedulers before C_PrefetchGraph returns,
+  //so one staging tensor per placeholder is enough
+  if (prefetch_map_.count(graph.output(0)) == 0) {
+    prefetch_map_[graph.output(0)] =
+      C_NewTensor(graph.output(0).c_str(), graph.output(0).length(),
+                  graph.shape(0).data(), graph.shape(0).size(),
+                  (C_Dtype)graph.type());
+  }
+  C_Tensor* ft = prefetch_map_[graph.output(0)];
+  memcpy(C_TensorData(ft), data, C_TensorSize(ft));
+  C_PrefetchGraph(s_, graph.output(0).c_str(), ft);
+}
@@ -4,7 +4,6 @@
 #include "cavs/frontend/c_api.h"
 #include "cavs/frontend/cxx/sym.h"
 #include "cavs/util/logging.h"
-#include "cavs/util/macros_gpu.h"
 
 #include <string>
 #include <initializer_list>
@@ -16,6 +15,11 @@ class Session {
     s_ = C_NewSession(name.c_str(), name.length(), opt);
   }
 
+  //e.g. "CPUPooled" for the size-class caching host allocator
+  void SetAllocator(const std::string& name) {
+    C_SetSessionAllocator(s_, name.c_str(), name.length());
+  }
+
   void Run(std::vector<Sym> outputs,
       const std::initializer_list<std::pair<Sym&, void*>>& feed = {});
   void Run(Sym& output,
@@ -23,10 +27,14 @@ class Session {
     std::vector<Sym> out = {output};
     Run(out, feed);
   }
+  //the graph that will be fed to the placeholder in a later Run,
+  //its schedule is prepared while the current batch executes
+  void Prefetch(Sym& graph, void* data);
 
  private:
   C_Session* s_;
   std::unordered_map<string, C_Tensor*> feed_map_;
+  std::unordered_map<string, C_Tensor*> prefetch_map_;
 };
 
 class MPISession : public Session {
@@ -1,12 +1,123 @@
 #include "cavs/frontend/cxx/session.h"
+#include "cavs/proto/opt.pb.h"
 #include "cavs/util/logging.h"
 
 #include <iostream>
 
 using namespace std;
 
+vector<float> Fetch(const Sym& s, int count) {
+  const float* data = (const float*)s.data();
+  return vector<float>(data, data+count);
+}
+
+//the nodes keep the statements they are compiled into,
+//so every session gets its own copy of the graph
+vector<vector<float>> RunDAG(int opt, int N,
+    const vector<float>& A_data, const vector<float>& B_data, int iters) {
+  Sym A = Sym::Placeholder(DT_FLOAT, {N, N});
+  Sym B = Sym::Placeholder(DT_FLOAT, {N, N});
+  Sym C = Sym::MatMul(A, B);
+  Sym D = A * B;
+  Sym E = C + D;
+  Sym F = Sym::MatMul(E, A) - B;
+  Sym G = Sym::Square(D) + A;
+
+  Session sess(opt);
+  vector<vector<float>> results;
+  for (int iter = 0; iter < iters; iter++) {
+    sess.Run({E, F, G}, {{A, (void*)A_data.data()}, {B, (void*)B_data.data()}});
+    results.push_back(Fetch(E, N*N));
+    results.push_back(Fetch(F, N*N));
+    results.push_back(Fetch(G, N*N));
+  }
+  return results;
+}
+
+//the dependency DAG of OPT_INTEROP must give the results of the serial order,
+//the branches of the graph are independent so that they really overlap
+void TestParallelExecutor() {
+  const int N = 64;
+  const int iters = 10;
+  vector<float> A_data(N*N), B_data(N*N);
+  for (int i = 0; i < N*N; i++) {
+    A_data[i] = float(i%7)/7.f;
+    B_data[i] = float(i%5)/5.f - 0.5f;
+  }
+
+  vector<vector<float>> serial = RunDAG(0, N, A_data, B_data, 1);
+  vector<vector<float>> parallel = RunDAG((int)OPT_INTEROP, N, A_data, B_data, iters);
+  for (int iter = 0; iter < iters; iter++) {
+    for (int j = 0; j < 3; j++) {
+      for (int i = 0; i < N*N; i++) {
+        CHECK(parallel[iter*3+j][i] == serial[j][i])
+          << iter << "\t" << j << "\t" << i;
+      }
+    }
+  }
+  LOG(INFO) << "ParallelExecutor matches the serial order";
+}
+
+//the transient tensors C and D share the arena with the planner,
+//which must not change the results
+void TestMemoryPlanner() {
+  const int N = 32;
+  const int iters = 3;
+  vector<float> A_data(N*N), B_data(N*N);
+  for (int i = 0; i < N*N; i++) {
+    A_data[i] = float(i%11)/11.f;
+    B_data[i] = float(i%3)/3.f - 0.5f;
+  }
+
+  vector<vector<float>> plain = RunDAG(0, N, A_data, B_data, 1);
+  vector<vector<float>> planned = RunDAG((int)OPT_MEMPLAN, N, A_data, B_data, iters);
+  for (int iter = 0; iter < iters; iter++) {
+    for (int j = 0; j < 3; j++) {
+      CHECK(planned[iter*3+j] == plain[j]) << iter << "\t" << j;
+    }
+  }
+  LOG(INFO) << "Planned memory gives the unplanned results";
+}
+
+//a chain of scalings and additions, each of which takes over
+//the memory of an input it is the last reader of
+vector<vector<float>> RunChain(int opt, int N,
+    const vector<float>& X_data, int iters) {
+  Sym X = Sym::Placeholder(DT_FLOAT, {N, N});
+  Sym alpha = Sym::Placeholder(DT_FLOAT, {1});
+  //a partial Mul is the front-end version of the Scal operator
+  Sym Y = X * alpha;
+  for (int i = 0; i < 4; i++)
+    Y = (Y + X) * alpha + Y;
+  Sym Z = Sym::Square(Y) + X;
+
+  Session sess(opt);
+  vector<float> alpha_data = {0.5f};
+  vector<vector<float>> results;
+  for (int iter = 0; iter < iters; iter++) {
+    sess.Run({Z}, {{X, (void*)X_data.data()}, {alpha, alpha_data.data()}});
+    results.push_back(Fetch(Z, N*N));
+  }
+  return results;
+}
+
+void TestInPlace() {
+  const int N = 32;
+  const int iters = 3;
+  vector<float> X_data(N*N);
+  for (int i = 0; i < N*N; i++)
+    X_data[i] = float(i%9)/9.f - 0.5f;
+
+  vector<vector<float>> plain = RunChain(0, N, X_data, 1);
+  vector<vector<float>> inplace =
+    RunChain((int)(OPT_MEMPLAN | OPT_INPLACE), N, X_data, iters);
+  for (int iter = 0; iter < iters; iter++)
+    CHECK(inplace[iter] == plain[0]) << iter;
+  LOG(INFO) << "In-place operators give the out-of-place results";
+}
+
 int main() {
-  Sym A = Sym::Placeholder(DT_FLOAT, {2, 3}); 
+  Sym A = Sym::Placeholder(DT_FLOAT, {2, 3});
   Sym B = Sym::Placeholder(DT_FLOAT, {2, 3});
   Sym C = A + B;
 
@@ -15,6 +126,9 @@ int main() {
   vector<float> B_data = {6, 5, 4, 3, 2, 1};
   sess.Run(C, {{A, A_data.data()}, {B, B_data.data()}});
   C.print();
+
+  TestParallelExecutor();
+  TestMemoryPlanner();
+  TestInPlace();
   return 0;
 }
-
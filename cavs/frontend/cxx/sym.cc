@@ -15,7 +15,7 @@ Sym::Sym(const OpDef& op_def) {
   node_.reset(new node_t());
   node_->op_def = op_def;
 
-  static int id_ = 0;
+  static thread_local int id_ = 0;
   if (def().output_size() == 0)
     mutable_def()->add_output(op_name() + "_" + std::to_string(id_++));
 
@@ -651,10 +651,15 @@ Sym::ATTRIBUTE Sym::NormalRandom() {
   return std::make_pair("Normal", vec);
 }
 
-Sym::ATTRIBUTE Sym::BinaryReader(const string& filename) {
-  vector<OpDef::AttrDef> vec(1);
+Sym::ATTRIBUTE Sym::BinaryReader(const string& filename,
+    bool shuffle, int seed) {
+  vector<OpDef::AttrDef> vec(3);
   vec[0].set_name("filename");
   vec[0].mutable_value()->set_s(filename);
+  vec[1].set_name("Shuffle");
+  vec[1].mutable_value()->set_b(shuffle);
+  vec[2].set_name("Seed");
+  vec[2].mutable_value()->set_i(seed);
   return std::make_pair("BinaryReader", vec);
 }
 
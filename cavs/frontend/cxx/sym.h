@@ -97,7 +97,10 @@ class Sym {
   static ATTRIBUTE Uniform(float minval, float maxval);
   static ATTRIBUTE Xavier();
   static ATTRIBUTE NormalRandom();
-  static ATTRIBUTE BinaryReader(const string& filename);
+  //batches are visited in a random order per epoch with shuffle,
+  //the Data syms of one dataset should use the same seed
+  static ATTRIBUTE BinaryReader(const string& filename,
+      bool shuffle = false, int seed = 0);
   //debug operations
   static void DumpGraph();
   void print();
@@ -202,7 +205,7 @@ class FuncConf {
 
  private:
   FuncConf() : name_("") {}
-  static FuncConf* Get() { static FuncConf fc; return &fc; }
+  static FuncConf* Get() { static thread_local FuncConf fc; return &fc; }
   string name_;
   FunctionDef def_;
 };
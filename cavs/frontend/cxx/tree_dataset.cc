@@ -0,0 +1,242 @@
+#include "cavs/frontend/cxx/tree_dataset.h"
+#include "cavs/util/logging.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <fstream>
+#include <numeric>
+#include <random>
+#include <sstream>
+
+using std::string;
+using std::vector;
+
+namespace {
+
+const char kMagic[8] = {'C', 'A', 'V', 'S', 'T', 'R', 'E', 'E'};
+const int32_t kVersion = 1;
+static_assert(sizeof(TreeDataset::Header) % 8 == 0, "unaligned header");
+
+inline size_t Align(size_t bytes) {
+  return (bytes + 7)/8*8;
+}
+
+struct Column {
+  vector<int64_t> offsets;
+  vector<int32_t> data;
+  Column() : offsets(1, 0) {}
+  void Append(const vector<int32_t>& values) {
+    data.insert(data.end(), values.begin(), values.end());
+    offsets.push_back(data.size());
+  }
+};
+
+vector<int32_t> ParseLine(const string& str, int shift) {
+  std::stringstream ss(str);
+  vector<int32_t> ret;
+  int val;
+  while (ss >> val)
+    ret.push_back(val + shift);
+  return ret;
+}
+
+template <typename T>
+void WriteAligned(FILE* fp, const vector<T>& v) {
+  const size_t bytes = v.size()*sizeof(T);
+  CHECK(fwrite(v.data(), 1, bytes, fp) == bytes);
+  static const char zeros[8] = {0};
+  const size_t pad = Align(bytes) - bytes;
+  CHECK(fwrite(zeros, 1, pad, fp) == pad);
+}
+
+} //namespace
+
+//the same rules as the text readers of the apps:
+//empty lines of the sentences are skipped, the parents are 1-based
+void TreeDataset::Convert(const string& input_file,
+    const string& label_file, const string& graph_file,
+    const string& output_file) {
+  std::ifstream input(input_file), label(label_file), graph(graph_file);
+  CHECK(input.is_open()) << input_file;
+  CHECK(label.is_open()) << label_file;
+  CHECK(graph.is_open()) << graph_file;
+  Column tokens, parents, labels;
+  string input_str, label_str, graph_str;
+  while (getline(input, input_str)) {
+    if (input_str.empty()) continue;
+    CHECK(getline(label, label_str)) << label_file;
+    CHECK(getline(graph, graph_str)) << graph_file;
+    vector<int32_t> p = ParseLine(graph_str, -1);
+    CHECK(!p.empty() && p.back() == -1) << graph_str;
+    tokens.Append(ParseLine(input_str, 0));
+    parents.Append(p);
+    labels.Append(ParseLine(label_str, 0));
+  }
+
+  Header header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.num_samples = tokens.offsets.size()-1;
+  header.num_tokens = tokens.data.size();
+  header.num_parents = parents.data.size();
+  header.num_labels = labels.data.size();
+
+  FILE* fp = fopen(output_file.c_str(), "wb");
+  CHECK(fp) << output_file;
+  CHECK(fwrite(&header, sizeof(header), 1, fp) == 1);
+  for (Column* c : {&tokens, &parents, &labels}) {
+    WriteAligned(fp, c->offsets);
+    WriteAligned(fp, c->data);
+  }
+  CHECK(fclose(fp) == 0) << output_file;
+  LOG(INFO) << "Converted " << header.num_samples << " samples into "
+            << output_file;
+}
+
+TreeDataset::TreeDataset(const string& filename) : file_(filename) {
+  CHECK(file_.size() >= sizeof(Header)) << filename;
+  header_ = reinterpret_cast<const Header*>(file_.data());
+  CHECK(memcmp(header_->magic, kMagic, sizeof(kMagic)) == 0)
+    << filename << " is not a tree dataset";
+  CHECK(header_->version == kVersion) << filename << ": " << header_->version;
+  const char* p = file_.data() + sizeof(Header);
+  auto take = [&p](size_t count, size_t elem) {
+    const char* ret = p;
+    p += Align(count*elem);
+    return ret;
+  };
+  const size_t n = header_->num_samples + 1;
+  token_offsets_  = reinterpret_cast<const int64_t*>(take(n, sizeof(int64_t)));
+  tokens_         = reinterpret_cast<const int32_t*>(take(header_->num_tokens, sizeof(int32_t)));
+  parent_offsets_ = reinterpret_cast<const int64_t*>(take(n, sizeof(int64_t)));
+  parents_        = reinterpret_cast<const int32_t*>(take(header_->num_parents, sizeof(int32_t)));
+  label_offsets_  = reinterpret_cast<const int64_t*>(take(n, sizeof(int64_t)));
+  labels_         = reinterpret_cast<const int32_t*>(take(header_->num_labels, sizeof(int32_t)));
+  CHECK(p <= file_.data() + file_.size()) << filename << " is truncated";
+  VLOG(V_DEBUG) << filename << ": " << num_samples() << " samples";
+}
+
+vector<SampleShape> TreeDataset::Shapes() const {
+  vector<SampleShape> shapes(num_samples());
+  for (int i = 0; i < num_samples(); i++) {
+    Span p = parents(i);
+    shapes[i] = TreeShape(p.data, p.length);
+  }
+  return shapes;
+}
+
+TreeBatchLoader::TreeBatchLoader(const TreeDataset* dataset,
+    int batch, int max_dependency, int depth, bool shuffle, int seed)
+    : dataset_(dataset), sampler_(NULL), batch_(batch),
+      max_dependency_(max_dependency), shuffle_(shuffle), seed_(seed),
+      epoch_(-1), cursor_(0), head_(0), filled_(0),
+      consumed_(false), stop_(false) {
+  Start(depth);
+}
+
+TreeBatchLoader::TreeBatchLoader(const TreeDataset* dataset,
+    BatchSampler* sampler, int max_dependency, int depth)
+    : dataset_(dataset), sampler_(sampler), batch_(sampler->batch()),
+      max_dependency_(max_dependency), shuffle_(false), seed_(0),
+      epoch_(-1), cursor_(0), head_(0), filled_(0),
+      consumed_(false), stop_(false) {
+  Start(depth);
+}
+
+void TreeBatchLoader::Start(int depth) {
+  CHECK(dataset_->num_samples() > 0);
+  CHECK(batch_ > 0 && max_dependency_ > 0 && depth > 0);
+  ring_.resize(depth+1);
+  for (TreeBatch& b : ring_) {
+    b.graph.resize(batch_*max_dependency_);
+    b.vertex.resize(batch_*max_dependency_);
+    b.label.resize(batch_*max_dependency_);
+  }
+  producer_ = std::thread(&TreeBatchLoader::Produce, this);
+}
+
+TreeBatchLoader::~TreeBatchLoader() {
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  producer_.join();
+}
+
+const TreeBatch& TreeBatchLoader::Next() {
+  std::unique_lock<std::mutex> lock(mu_);
+  if (consumed_) {
+    head_ = (head_+1) % ring_.size();
+    filled_--;
+    cv_.notify_all();
+  }
+  cv_.wait(lock, [this]{ return filled_ > 0; });
+  consumed_ = true;
+  return ring_[head_];
+}
+
+int TreeBatchLoader::NextSample() {
+  const int n = dataset_->num_samples();
+  if (cursor_ % n == 0 && cursor_/n != epoch_) {
+    epoch_ = cursor_/n;
+    order_.resize(n);
+    std::iota(order_.begin(), order_.end(), 0);
+    if (shuffle_) {
+      std::seed_seq seq{seed_, epoch_};
+      std::mt19937 gen(seq);
+      std::shuffle(order_.begin(), order_.end(), gen);
+    }
+  }
+  return order_[cursor_++ % n];
+}
+
+void TreeBatchLoader::Fill(TreeBatch* b) {
+  std::fill(b->graph.begin(), b->graph.end(), -1);
+  std::fill(b->vertex.begin(), b->vertex.end(), 0);
+  std::fill(b->label.begin(), b->label.end(), -1);
+  const vector<int>* samples = sampler_ ? &sampler_->Next(&b->stats) : NULL;
+  size_t label_length = 0;
+  for (int i = 0; i < batch_; i++) {
+    const int sample = samples ? (*samples)[i] : NextSample();
+    TreeDataset::Span graph = dataset_->parents(sample);
+    TreeDataset::Span vertex = dataset_->tokens(sample);
+    TreeDataset::Span label = dataset_->labels(sample);
+    CHECK(graph.length <= max_dependency_) << graph.length;
+    CHECK(vertex.length <= max_dependency_) << vertex.length;
+    CHECK(label_length + label.length <= b->label.size()) << label.length;
+    std::copy(graph.data, graph.data + graph.length,
+              b->graph.begin() + i*max_dependency_);
+    std::copy(vertex.data, vertex.data + vertex.length,
+              b->vertex.begin() + i*max_dependency_);
+    std::copy(label.data, label.data + label.length,
+              b->label.begin() + label_length);
+    label_length += label.length;
+  }
+  if (sampler_) {
+    VLOG(V_DEBUG) << "[TreeBatchLoader] rounds: " << b->stats.rounds
+                  << "	vertices per round: " << b->stats.avg_round_batch
+                  << "	efficiency: " << b->stats.efficiency;
+  }
+}
+
+void TreeBatchLoader::Produce() {
+  while (true) {
+    int slot;
+    {
+      std::unique_lock<std::mutex> lock(mu_);
+      cv_.wait(lock, [this]{ return stop_ || filled_ < (int)ring_.size(); });
+      if (stop_) return;
+      slot = (head_ + filled_) % ring_.size();
+    }
+    //the consumer does not touch the slots beyond the filled ones
+    Fill(&ring_[slot]);
+    {
+      std::lock_guard<std::mutex> lock(mu_);
+      filled_++;
+    }
+    cv_.notify_all();
+  }
+}
@@ -0,0 +1,123 @@
+#ifndef CAVS_FRONTEND_CXX_TREE_DATASET_H_
+#define CAVS_FRONTEND_CXX_TREE_DATASET_H_
+
+#include "cavs/frontend/cxx/batch_sampler.h"
+#include "cavs/util/mapped_file.h"
+
+#include <stdint.h>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <string>
+#include <vector>
+
+//A binary, columnar form of the tree datasets(sents_idx.txt, labels.txt,
+//parents.txt), read through a mapping instead of being re-tokenized.
+//Layout(native endianness, every section 8-byte aligned):
+//  Header
+//  int64 token_offsets[num_samples+1],  int32 tokens[num_tokens]
+//  int64 parent_offsets[num_samples+1], int32 parents[num_parents]
+//  int64 label_offsets[num_samples+1],  int32 labels[num_labels]
+//The parents are 0-based, the root has -1.
+class TreeDataset {
+ public:
+  struct Header {
+    char magic[8];
+    int32_t version;
+    int32_t num_samples;
+    int64_t num_tokens;
+    int64_t num_parents;
+    int64_t num_labels;
+  };
+  //a column of one sample
+  struct Span {
+    const int32_t* data;
+    int length;
+  };
+
+  //converts the text files, one sample per line
+  static void Convert(const std::string& input_file,
+      const std::string& label_file, const std::string& graph_file,
+      const std::string& output_file);
+
+  explicit TreeDataset(const std::string& filename);
+  inline int num_samples() const { return header_->num_samples; }
+  inline Span tokens(int i)  const { return Get(token_offsets_,  tokens_,  i); }
+  inline Span parents(int i) const { return Get(parent_offsets_, parents_, i); }
+  inline Span labels(int i)  const { return Get(label_offsets_,  labels_,  i); }
+  //for bucketing by a BatchSampler
+  std::vector<SampleShape> Shapes() const;
+
+ private:
+  inline Span Get(const int64_t* offsets, const int32_t* data, int i) const {
+    Span s = { data + offsets[i], int(offsets[i+1] - offsets[i]) };
+    return s;
+  }
+  MappedFile file_;
+  const Header* header_;
+  const int64_t* token_offsets_;
+  const int32_t* tokens_;
+  const int64_t* parent_offsets_;
+  const int32_t* parents_;
+  const int64_t* label_offsets_;
+  const int32_t* labels_;
+};
+
+//The placeholders of a GraphSupport model for one batch, in the layout
+//of the text readers of the tree apps:
+//  graph:  batch x max_dependency parents, padded with -1
+//  vertex: batch x max_dependency tokens, padded with 0
+//  label:  the labels of all samples back to back, padded with -1
+struct TreeBatch {
+  std::vector<int>   graph;
+  std::vector<float> vertex;
+  std::vector<float> label;
+  //only filled with a sampler
+  BatchStats stats;
+};
+
+//Assembles the batches on a background thread, up to depth of them ahead,
+//so the pages of the mapping are faulted in off the training thread.
+//The samples are visited in order, or in a new permutation per epoch
+//with shuffle, wrapping around at the end of the dataset.
+//The batches of a sampler are taken as they are.
+class TreeBatchLoader {
+ public:
+  TreeBatchLoader(const TreeDataset* dataset, int batch, int max_dependency,
+      int depth = 2, bool shuffle = false, int seed = 0);
+  TreeBatchLoader(const TreeDataset* dataset, BatchSampler* sampler,
+      int max_dependency, int depth = 2);
+  ~TreeBatchLoader();
+  //the batch stays valid until the next call
+  const TreeBatch& Next();
+
+ private:
+  void Start(int depth);
+  int NextSample();
+  void Fill(TreeBatch* b);
+  void Produce();
+
+  const TreeDataset* dataset_;
+  BatchSampler* sampler_;
+  const int batch_;
+  const int max_dependency_;
+  const bool shuffle_;
+  const int seed_;
+  //the producer's position
+  int epoch_;
+  int cursor_;
+  std::vector<int> order_;
+
+  //a ring of depth+1 batches, one of which is held by the consumer
+  std::vector<TreeBatch> ring_;
+  int head_;
+  int filled_;
+  bool consumed_;
+  bool stop_;
+  std::mutex mu_;
+  std::condition_variable cv_;
+  std::thread producer_;
+};
+
+#endif
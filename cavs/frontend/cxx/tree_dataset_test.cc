@@ -0,0 +1,46 @@
+#include "cavs/frontend/cxx/tree_dataset.h"
+#include "cavs/util/logging.h"
+
+#include <stdio.h>
+#include <fstream>
+
+int main() {
+  {
+    std::ofstream input("tree_dataset_test.sents");
+    std::ofstream label("tree_dataset_test.labels");
+    std::ofstream graph("tree_dataset_test.parents");
+    //three leaves under two inner nodes, and a single node
+    input << "5 6 7\n\n9\n";
+    label << "1 2 3 4 0\n3\n";
+    graph << "4 4 5 5 0\n0\n";
+  }
+  TreeDataset::Convert("tree_dataset_test.sents", "tree_dataset_test.labels",
+      "tree_dataset_test.parents", "tree_dataset_test.bin");
+  TreeDataset dataset("tree_dataset_test.bin");
+  CHECK(dataset.num_samples() == 2);
+  CHECK(dataset.tokens(0).length == 3 && dataset.tokens(0).data[2] == 7);
+  CHECK(dataset.parents(0).length == 5 && dataset.parents(0).data[0] == 3);
+  CHECK(dataset.parents(0).data[4] == -1);
+  CHECK(dataset.labels(1).length == 1 && dataset.labels(1).data[0] == 3);
+
+  const int max_dependency = 6;
+  TreeBatchLoader loader(&dataset, 3, max_dependency);
+  for (int iter = 0; iter < 4; iter++) {
+    const TreeBatch& b = loader.Next();
+    //the samples wrap around: 0 1 0, 1 0 1, ...
+    const int first = iter % 2;
+    CHECK(b.vertex[0] == (first == 0 ? 5 : 9)) << b.vertex[0];
+    CHECK(b.vertex[max_dependency] == (first == 0 ? 9 : 5));
+    CHECK(b.graph[(1-first)*max_dependency] == -1);
+    CHECK(b.graph[(1-first)*max_dependency+1] == -1);
+    CHECK(b.graph[first*max_dependency+5] == -1);
+    //5+1+5 or 1+5+1 labels back to back
+    const int labels = (first == 0) ? 11 : 7;
+    CHECK(b.label[labels-1] != -1 && b.label[labels] == -1);
+  }
+  for (const char* f : {"tree_dataset_test.sents", "tree_dataset_test.labels",
+                        "tree_dataset_test.parents", "tree_dataset_test.bin"})
+    remove(f);
+  LOG(INFO) << "TreeDataset passed";
+  return 0;
+}
@@ -0,0 +1,198 @@
+#include "cavs/midend/allocator.h"
+#include "cavs/util/logging.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <vector>
+#include <mutex>
+#include <atomic>
+
+using std::string;
+using std::vector;
+
+namespace midend {
+
+//size-class caching allocator for host tensors.
+//blocks are carved out of huge-page backed arenas and never handed
+//back to the system, freed blocks are kept in per-thread free lists
+//that spill over into a shared list, so once the working set of a
+//training iteration has been seen no further system allocation happens.
+class PooledCPUAllocator : public Allocator {
+ public:
+  PooledCPUAllocator()
+      : Allocator(kPooledCPUAllocatorName, CPU),
+        arena_cur_(NULL), arena_left_(0),
+        system_allocations_(0), reserved_bytes_(0) {}
+
+  void* AllocateRaw(size_t nbytes) override;
+  void DeallocateRaw(void* buf) override;
+  void InitWithZero(void* buf, size_t nbytes) override {
+    memset(buf, 0, nbytes);
+  }
+
+  size_t system_allocations() const { return system_allocations_; }
+  size_t reserved_bytes() const { return reserved_bytes_; }
+
+  static const char* kPooledCPUAllocatorName;
+
+ private:
+  //64-byte headers keep every block aligned for the simd kernels
+  static const size_t kAlignment = 64;
+  static const size_t kHugePage = 2 << 20;
+  static const size_t kArenaBytes = 64 << 20;
+  //four classes per power of two, starting from 64 bytes
+  static const int kNumClasses = 4*(48-6);
+  static const uint32_t kMagic = 0xCA5B10C;
+  //a thread keeps at most so many bytes per class before spilling
+  static const size_t kThreadCacheBytes = 8 << 20;
+
+  struct BlockHeader {
+    uint32_t size_class;
+    uint32_t magic;
+  };
+
+  struct ThreadCache {
+    ThreadCache(PooledCPUAllocator* alloc)
+        : owner(alloc), free_lists(kNumClasses), cached_bytes(kNumClasses, 0) {}
+    ~ThreadCache() {
+      for (int c = 0; c < kNumClasses; c++)
+        owner->Spill(c, &free_lists[c], free_lists[c].size());
+    }
+    PooledCPUAllocator* owner;
+    vector<vector<void*>> free_lists;
+    vector<size_t> cached_bytes;
+  };
+
+  static size_t ClassBytes(int c) {
+    const int e = 6 + c/4;
+    const size_t bytes = ((size_t)1 << e) + (c%4)*((size_t)1 << (e-2));
+    return (bytes + kAlignment - 1) & ~(kAlignment-1);
+  }
+  static int SizeClass(size_t nbytes) {
+    if (nbytes <= 64) return 0;
+    const int e = 63 - __builtin_clzll(nbytes-1);
+    const size_t step = (size_t)1 << (e-2);
+    const int k = (nbytes - ((size_t)1 << e) + step - 1) / step;
+    return (e-6)*4 + k;
+  }
+
+  ThreadCache* GetThreadCache() {
+    //there is a single instance per process
+    thread_local ThreadCache cache(this);
+    return &cache;
+  }
+  void* SystemAlloc(size_t bytes);
+  void* Carve(size_t bytes);
+  void Spill(int c, vector<void*>* list, size_t count);
+
+  std::mutex mu_;
+  vector<vector<void*>> global_free_lists_ = vector<vector<void*>>(kNumClasses);
+  char* arena_cur_;
+  size_t arena_left_;
+  std::atomic<size_t> system_allocations_;
+  std::atomic<size_t> reserved_bytes_;
+};
+
+const char* PooledCPUAllocator::kPooledCPUAllocatorName = "CPUPooled";
+
+void* PooledCPUAllocator::SystemAlloc(size_t bytes) {
+  //over-map by a huge page so the arena can start on a 2MB boundary
+  size_t mapped = bytes + kHugePage;
+  char* raw = (char*)mmap(NULL, mapped, PROT_READ|PROT_WRITE,
+      MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+  CHECK(raw != MAP_FAILED) << "mmap of " << mapped << " bytes failed";
+  char* aligned = (char*)(((uintptr_t)raw + kHugePage - 1) & ~(uintptr_t)(kHugePage-1));
+  if (aligned > raw)
+    munmap(raw, aligned-raw);
+  size_t tail = (raw+mapped) - (aligned+bytes);
+  if (tail > 0)
+    munmap(aligned+bytes, tail);
+#ifdef MADV_HUGEPAGE
+  madvise(aligned, bytes, MADV_HUGEPAGE);
+#endif
+  system_allocations_++;
+  reserved_bytes_ += bytes;
+  VLOG(V_DEBUG) << "[PooledCPUAllocator] reserving " << bytes
+                << " bytes, " << reserved_bytes_ << " in total";
+  return aligned;
+}
+
+//mu_ must be held
+void* PooledCPUAllocator::Carve(size_t bytes) {
+  if (bytes > kArenaBytes/4) {
+    //big blocks get their own mapping, but are cached all the same
+    return SystemAlloc((bytes + kHugePage - 1) & ~(kHugePage-1));
+  }
+  if (arena_left_ < bytes) {
+    arena_cur_ = (char*)SystemAlloc(kArenaBytes);
+    arena_left_ = kArenaBytes;
+  }
+  void* ret = arena_cur_;
+  arena_cur_ += bytes;
+  arena_left_ -= bytes;
+  return ret;
+}
+
+void PooledCPUAllocator::Spill(int c, vector<void*>* list, size_t count) {
+  std::lock_guard<std::mutex> lock(mu_);
+  vector<void*>& global = global_free_lists_[c];
+  for (size_t i = 0; i < count; i++) {
+    global.push_back(list->back());
+    list->pop_back();
+  }
+}
+
+void* PooledCPUAllocator::AllocateRaw(size_t nbytes) {
+  const int c = SizeClass(nbytes + kAlignment);
+  CHECK(c < kNumClasses) << nbytes;
+  const size_t block_bytes = ClassBytes(c);
+  ThreadCache* cache = GetThreadCache();
+  char* block = NULL;
+  if (!cache->free_lists[c].empty()) {
+    block = (char*)cache->free_lists[c].back();
+    cache->free_lists[c].pop_back();
+    cache->cached_bytes[c] -= block_bytes;
+  }else {
+    std::lock_guard<std::mutex> lock(mu_);
+    vector<void*>& global = global_free_lists_[c];
+    if (!global.empty()) {
+      block = (char*)global.back();
+      global.pop_back();
+    }else {
+      block = (char*)Carve(block_bytes);
+    }
+  }
+  BlockHeader* header = (BlockHeader*)block;
+  header->size_class = c;
+  header->magic = kMagic;
+  return block + kAlignment;
+}
+
+void PooledCPUAllocator::DeallocateRaw(void* buf) {
+  char* block = (char*)buf - kAlignment;
+  BlockHeader* header = (BlockHeader*)block;
+  CHECK(header->magic == kMagic) << "freeing a block not owned by " << name();
+  const int c = header->size_class;
+  const size_t block_bytes = ClassBytes(c);
+  ThreadCache* cache = GetThreadCache();
+  cache->free_lists[c].push_back(block);
+  cache->cached_bytes[c] += block_bytes;
+  if (cache->cached_bytes[c] > kThreadCacheBytes &&
+      cache->free_lists[c].size() > 1) {
+    //hand half of the list to the other threads
+    size_t count = cache->free_lists[c].size()/2;
+    Spill(c, &cache->free_lists[c], count);
+    cache->cached_bytes[c] -= count*block_bytes;
+  }
+}
+
+Allocator* pooled_cpu_allocator() {
+  static PooledCPUAllocator pooled_cpu_alloc;
+  return &pooled_cpu_alloc;
+}
+
+REGISTER_STATIC_ALLOCATOR(PooledCPUAllocator::kPooledCPUAllocatorName,
+                          pooled_cpu_allocator());
+
+} //namespace midend
@@ -0,0 +1,87 @@
+#include "cavs/midend/allocator.h"
+#include "cavs/util/logging.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+using namespace midend;
+using std::vector;
+
+//the blocks of a class are 64-byte aligned and carry a 64-byte header,
+//four classes per power of two: a request of 1000 bytes takes a block
+//of 1280 bytes, which serves any request of 961 to 1216 bytes
+const size_t kSmall   = 1000;
+const size_t kClassLo = 961;
+const size_t kClassHi = 1216;
+const size_t kBlock   = 1280;
+
+void TestRounding(Allocator* alloc) {
+  char* a = (char*)alloc->AllocateRaw(kSmall);
+  char* b = (char*)alloc->AllocateRaw(kSmall);
+  CHECK(a && b && a != b);
+  CHECK((uintptr_t)a % 64 == 0 && (uintptr_t)b % 64 == 0);
+  //fresh blocks are carved one after another out of the arena
+  CHECK((size_t)(b - a) == kBlock) << b - a;
+  memset(a, 1, kClassHi);
+  memset(b, 2, kClassHi);
+  CHECK(a[kClassHi-1] == 1);
+  alloc->DeallocateRaw(b);
+  alloc->DeallocateRaw(a);
+
+  //both ends of the class get a block of it back
+  char* lo = (char*)alloc->AllocateRaw(kClassLo);
+  char* hi = (char*)alloc->AllocateRaw(kClassHi);
+  CHECK((lo == a && hi == b) || (lo == b && hi == a));
+  //one byte more is the next class
+  char* next = (char*)alloc->AllocateRaw(kClassHi+1);
+  CHECK(next != a && next != b);
+  alloc->DeallocateRaw(lo);
+  alloc->DeallocateRaw(hi);
+  alloc->DeallocateRaw(next);
+  LOG(INFO) << "Size classes passed";
+}
+
+void TestReuse(Allocator* alloc) {
+  //the last freed block of a class is the next one handed out
+  void* a = alloc->AllocateRaw(4096);
+  alloc->DeallocateRaw(a);
+  void* b = alloc->AllocateRaw(4200);
+  CHECK(a == b);
+
+  //the freed blocks of an iteration serve the next one
+  vector<void*> blocks;
+  for (int i = 0; i < 16; i++)
+    blocks.push_back(alloc->AllocateRaw(100*(i+1)));
+  for (void* p : blocks)
+    alloc->DeallocateRaw(p);
+  for (int iter = 0; iter < 3; iter++) {
+    vector<void*> again;
+    for (int i = 0; i < 16; i++) {
+      again.push_back(alloc->AllocateRaw(100*(i+1)));
+      CHECK(std::find(blocks.begin(), blocks.end(), again.back()) != blocks.end())
+        << iter << "\t" << i;
+    }
+    for (void* p : again)
+      alloc->DeallocateRaw(p);
+  }
+  alloc->DeallocateRaw(b);
+
+  //big blocks have mappings of their own, and are cached all the same
+  void* big = alloc->AllocateRaw(32 << 20);
+  memset(big, 0, 32 << 20);
+  alloc->DeallocateRaw(big);
+  CHECK(alloc->AllocateRaw(32 << 20) == big);
+  alloc->DeallocateRaw(big);
+  LOG(INFO) << "Block reuse passed";
+}
+
+int main() {
+  Allocator* alloc = GetAllocator("CPUPooled");
+  CHECK_NOTNULL(alloc);
+  CHECK(alloc->type() == CPU);
+  TestRounding(alloc);
+  TestReuse(alloc);
+  return 0;
+}
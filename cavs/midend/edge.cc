@@ -37,6 +37,22 @@ void Edge::AddSource(Node* node) {
     same_scoped_srcs_.push_back(node);
 }
 
+void Edge::RemoveSource(Node* node) {
+  CHECK(std::find(srcs_.begin(), srcs_.end(), node) != srcs_.end())
+    << node->debug_info() << debug_info();
+  srcs_.erase(std::remove(srcs_.begin(), srcs_.end(), node), srcs_.end());
+  same_scoped_srcs_.erase(std::remove(same_scoped_srcs_.begin(),
+        same_scoped_srcs_.end(), node), same_scoped_srcs_.end());
+}
+
+void Edge::RemoveDst(Node* node) {
+  CHECK(std::find(dsts_.begin(), dsts_.end(), node) != dsts_.end())
+    << node->debug_info() << debug_info();
+  dsts_.erase(std::remove(dsts_.begin(), dsts_.end(), node), dsts_.end());
+  same_scoped_dsts_.erase(std::remove(same_scoped_dsts_.begin(),
+        same_scoped_dsts_.end(), node), same_scoped_dsts_.end());
+}
+
 void Edge::AddControlDependency(const Node* n) {
   CHECK(n->scope() == scope());
   control_dependency_on_me_.push_back(const_cast<Node*>(n));
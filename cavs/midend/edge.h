@@ -36,6 +36,9 @@ class Edge {
 
   void AddSource(Node* node);
   void AddDst(Node* node);
+  //for the graph rewrites which replace a node with another
+  void RemoveSource(Node* node);
+  void RemoveDst(Node* node);
   void AddControlDependency(const Node* n);
 
   inline void SetShape(const TensorShapeDef& def);
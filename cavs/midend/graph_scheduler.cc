@@ -1,7 +1,11 @@
 #include "cavs/midend/graph_scheduler.h"
+#include "cavs/midend/allocator.h"
+#include "cavs/util/op_util.h"
 #include "cavs/proto/devices.pb.h"
-#include "cavs/util/macros_gpu.h"
+#include "cavs/util/device.h"
 
+#include <stdlib.h>
+#include <stdint.h>
 #include <algorithm>
 
 using std::vector;
@@ -16,49 +20,65 @@ int GraphSchedulerBase::LoadGraph(const Tensor& graph_struct) {
   if (batch_size_ == 0 && max_seq_length_ == 0) {
     batch_size_ = graph_struct.dims(0);
     max_seq_length_ = graph_struct.dims(1);
-    __forward_parents_ids_.resize(batch_size_*max_seq_length_); 
-    __forward_children_ids_.resize(batch_size_*max_seq_length_); 
+    //sized for the longest batch once, so the graphs are parsed in place
+    __forward_parents_ids_.offsets_.reserve(batch_size_*max_seq_length_+1); 
+    __forward_parents_ids_.indices_.reserve(batch_size_*max_seq_length_); 
+    __forward_children_ids_.offsets_.reserve(batch_size_*max_seq_length_+1); 
+    __forward_children_ids_.indices_.reserve(batch_size_*max_seq_length_); 
+    fill_cursor_.reserve(batch_size_*max_seq_length_);
     sample_offset_in_gid_.resize(batch_size_);
     //activated_times_.resize(batch_size_*max_seq_length_, 0);
-    checkCudaError(cudaMalloc((void**)&gpu_idx_buf_, batch_size_*max_seq_length_*sizeof(int)));
+    gpu_idx_buf_ = (int*)DeviceContext::Malloc(batch_size_*max_seq_length_*sizeof(int),
+                                               DeviceContext::KernelDeviceType());
   }else {
     CHECK(batch_size_ == graph_struct.dims(0)); 
     CHECK(max_seq_length_ == graph_struct.dims(1)); 
-    for (int i = 0; i < batch_size_*max_seq_length_; i++) {
-      __forward_parents_ids_[i].clear();
-      __forward_children_ids_[i].clear();
-    }
   }
 
+  //each node has at most one parent, which fixes the parents in one pass
+  //while the children are counted, and then placed in the order of
+  //their global ids, which is the order the gather operators expect
+  vector<int>& parent_offsets = __forward_parents_ids_.offsets_;
+  vector<int>& parent_indices = __forward_parents_ids_.indices_;
+  vector<int>& child_offsets  = __forward_children_ids_.offsets_;
+  vector<int>& child_indices  = __forward_children_ids_.indices_;
+  parent_offsets.clear();
+  parent_indices.clear();
+  child_offsets.assign(batch_size_*max_seq_length_+1, 0);
+
   total_length_ = 0;
   int prev_seq_length = 0;
   for (int i = 0; i < batch_size_; i++) {
     const int *start = graph_struct.data<int>() + i*max_seq_length_;
-    for (int ix = 0; ix < max_seq_length_; ix++)
-      VLOG(V_DEBUG) << *(start+ix);
     int curr_seq_length = std::find(start, start+max_seq_length_, -1) + 1 - start;
     sample_offset_in_gid_[i] = prev_seq_length + ((i > 0) ? sample_offset_in_gid_[i-1] : 0);
     CHECK(curr_seq_length <= max_seq_length_) << curr_seq_length << "\t" << max_seq_length_;
     VLOG(V_DEBUG) << "sequence_lengh = " << curr_seq_length;
     total_length_ += curr_seq_length;
-    for (int j = 0; j < curr_seq_length-1; j++) {
-      __forward_parents_ids_[toGlobalId(i, j)].resize(1);
-      __forward_parents_ids_[toGlobalId(i, j)][0] = toGlobalId(i, *(start+j));
-      //__forward_children_ids_[toGlobalId(i, j)].clear();
-      VLOG(V_DEBUG) << "parents[" << i << "][" << j << "](" << toGlobalId(i, j)
-                    << ") = " << __forward_parents_ids_[toGlobalId(i, j)][0];
-    }
-    //__forward_children_ids_[toGlobalId(i, curr_seq_length-1)].clear();
     for (int j = 0; j < curr_seq_length; j++) {
-      if (!__forward_parents_ids_[toGlobalId(i, j)].empty()) {
-        int parent = __forward_parents_ids_[toGlobalId(i, j)][0];
-        __forward_children_ids_[parent].push_back(toGlobalId(i, j));
-        VLOG(V_DEBUG) << "children[ " << i << "][" << j << "](" << parent
-                      << ") = " << __forward_children_ids_[parent].back();
+      parent_offsets.push_back(parent_indices.size());
+      if (j < curr_seq_length-1) {
+        int parent = toGlobalId(i, *(start+j));
+        parent_indices.push_back(parent);
+        child_offsets[parent+1]++;
+        VLOG(V_DEBUG) << "parents[" << i << "][" << j << "](" << toGlobalId(i, j)
+                      << ") = " << parent;
       }
     }
     prev_seq_length = curr_seq_length;
   }
+  parent_offsets.push_back(parent_indices.size());
+  child_offsets.resize(total_length_+1);
+  for (int gid = 0; gid < total_length_; gid++)
+    child_offsets[gid+1] += child_offsets[gid];
+  child_indices.resize(parent_indices.size());
+  fill_cursor_.assign(child_offsets.begin(), child_offsets.end()-1);
+  for (int gid = 0; gid < total_length_; gid++) {
+    for (int k = parent_offsets[gid]; k < parent_offsets[gid+1]; k++)
+      child_indices[fill_cursor_[parent_indices[k]]++] = gid;
+  }
+
+  graph_struct_ = graph_struct.data<int>();
   parents_ = &__forward_parents_ids_;
   children_ = &__forward_children_ids_;
   round2offset_.clear();
@@ -166,16 +186,222 @@ void SerialGraphScheduler::ActivateNext() {
   }
 }
 
+//one job per round, the tensor id of a job is its job id
+void SerialGraphScheduler::PlanAhead() {
+  CHECK(!Terminate());
+  for (int gid = 0; gid < total_length(); gid++)
+    tids_to_jobids_[gid] = gid;
+}
+
+BatchGraphScheduler::BatchGraphScheduler()
+    : GraphSchedulerBase(), replaying_(false),
+      plan_cache_hits_(0), plan_cache_misses_(0),
+      prefetch_hits_(0), prefetch_stop_(false) {
+  const char* env = getenv("CAVS_ROUND_PLAN_CACHE");
+  //a negative capacity disables the cache as 0 does
+  plan_cache_capacity_ = env ? std::max(atoi(env), 0) : 64;
+  env = getenv("CAVS_GRAPH_PREFETCH_DEPTH");
+  prefetch_depth_ = (env && atoi(env) > 0) ? atoi(env) : 2;
+}
+
+BatchGraphScheduler::~BatchGraphScheduler() {
+  if (prefetch_thread_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(prefetch_mu_);
+      prefetch_stop_ = true;
+    }
+    prefetch_cv_.notify_all();
+    prefetch_thread_.join();
+  }
+}
+
+void BatchGraphScheduler::Prefetch(const Tensor& parent_ids) {
+  CHECK(parent_ids.dims() == 2) << parent_ids.debug_info();
+  CHECK(parent_ids.device_type() == CPU) << parent_ids.debug_info();
+  std::shared_ptr<PrefetchSlot> slot(new PrefetchSlot());
+  slot->graph_struct.assign(parent_ids.data<int>(),
+                            parent_ids.data<int>() + parent_ids.count());
+  std::unique_lock<std::mutex> lock(prefetch_mu_);
+  if (!prefetch_thread_.joinable()) {
+    prefetch_dims_ = { parent_ids.dims(0), parent_ids.dims(1) };
+    shadow_.reset(new BatchGraphScheduler());
+    shadow_->plan_cache_capacity_ = 0;
+    prefetch_thread_ = std::thread(&BatchGraphScheduler::PrefetchLoop, this);
+  }
+  CHECK(prefetch_dims_[0] == parent_ids.dims(0));
+  CHECK(prefetch_dims_[1] == parent_ids.dims(1));
+  //graphs prefetched but never run(e.g. the read-ahead at the end of
+  //an epoch) are not waited for, the oldest pending ones are dropped
+  while (prefetch_slots_.size() >= prefetch_depth_) {
+    VLOG(V_DEBUG) << "Dropping the oldest prefetched graph";
+    prefetch_slots_.pop_front();
+  }
+  prefetch_slots_.push_back(slot);
+  prefetch_cv_.notify_all();
+}
+
+void BatchGraphScheduler::PrefetchLoop() {
+  Tensor graph("prefetched_graph", GetAllocator(DeviceTypeToString(CPU)),
+               DT_INT32, TensorShape(prefetch_dims_));
+  while (true) {
+    std::shared_ptr<PrefetchSlot> slot;
+    {
+      std::unique_lock<std::mutex> lock(prefetch_mu_);
+      prefetch_cv_.wait(lock, [this, &slot]{
+        for (auto& s : prefetch_slots_) {
+          if (!s->plan) { slot = s; break; }
+        }
+        return prefetch_stop_ || slot;
+      });
+      if (prefetch_stop_)
+        return;
+    }
+    //the shadow scheduler is only touched by this thread
+    std::copy(slot->graph_struct.begin(), slot->graph_struct.end(),
+              graph.mutable_data<int>());
+    shadow_->LoadGraph(graph);
+    shadow_->Initialize();
+    while (!shadow_->Terminate())
+      shadow_->ActivateNext();
+    {
+      std::lock_guard<std::mutex> lock(prefetch_mu_);
+      slot->plan = shadow_->plan_;
+    }
+    prefetch_cv_.notify_all();
+  }
+}
+
+//without wait, the matching slot is only dropped
+std::shared_ptr<BatchGraphScheduler::RoundPlan>
+BatchGraphScheduler::TakePrefetchedPlan(bool wait) {
+  std::unique_lock<std::mutex> lock(prefetch_mu_);
+  auto matches = [this](const std::shared_ptr<PrefetchSlot>& slot) {
+    return std::equal(slot->graph_struct.begin(), slot->graph_struct.end(),
+                      graph_struct());
+  };
+  auto it = std::find_if(prefetch_slots_.begin(), prefetch_slots_.end(), matches);
+  if (it == prefetch_slots_.end())
+    return NULL;
+  std::shared_ptr<PrefetchSlot> slot = *it;
+  //a slot dropped by a concurrent Prefetch is never planned
+  auto pending = [this, &slot]{
+    return std::find(prefetch_slots_.begin(), prefetch_slots_.end(), slot)
+           != prefetch_slots_.end();
+  };
+  if (wait)
+    prefetch_cv_.wait(lock, [&]{ return slot->plan != NULL || !pending(); });
+  //the slots ahead of it were prefetched but never run
+  it = std::find(prefetch_slots_.begin(), prefetch_slots_.end(), slot);
+  if (it != prefetch_slots_.end()) {
+    VLOG(V_DEBUG) << "Dropping " << (it - prefetch_slots_.begin())
+                  << " stale prefetched graphs";
+    prefetch_slots_.erase(prefetch_slots_.begin(), it+1);
+  }
+  prefetch_cv_.notify_all();
+  return wait ? slot->plan : NULL;
+}
+
+size_t BatchGraphScheduler::HashGraphStruct() const {
+  //FNV-1a over the parent ids
+  uint64_t h = 14695981039346656037ULL;
+  const int* data = graph_struct();
+  for (int i = 0; i < graph_struct_size(); i++) {
+    h ^= (uint32_t)data[i];
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+std::shared_ptr<BatchGraphScheduler::RoundPlan>
+BatchGraphScheduler::LookupPlan(size_t key) {
+  auto it = plan_index_.find(key);
+  if (it == plan_index_.end())
+    return NULL;
+  std::shared_ptr<RoundPlan> plan = *(it->second);
+  //a hash collision is treated as a miss
+  if (!std::equal(plan->graph_struct.begin(), plan->graph_struct.end(), graph_struct()))
+    return NULL;
+  plan_lru_.splice(plan_lru_.begin(), plan_lru_, it->second);
+  return plan;
+}
+
+void BatchGraphScheduler::FinalizePlan() {
+  plan_->round2offset = round2offset_;
+  plan_->tids_for_gather_init = tids_for_gather_init_;
+  plan_->tids_to_jobids = tids_to_jobids_;
+  plan_->jobids_to_tids = jobids_to_tids_;
+}
+
+void BatchGraphScheduler::CachePlan() {
+  if (plan_cache_capacity_ == 0)
+    return;
+  auto it = plan_index_.find(plan_->key);
+  if (it != plan_index_.end()) {
+    plan_lru_.erase(it->second);
+    plan_index_.erase(it);
+  }
+  while (plan_lru_.size() >= plan_cache_capacity_) {
+    plan_index_.erase(plan_lru_.back()->key);
+    plan_lru_.pop_back();
+  }
+  plan_lru_.push_front(plan_);
+  plan_index_[plan_->key] = plan_lru_.begin();
+}
+
+void BatchGraphScheduler::ReplayRound(int round) {
+  if (rc_.IsForward()) {
+    ready_to_execute_ids_ = plan_->execution_tracer[round];
+    tids_for_gather_      = plan_->gather_tracer[round];
+    tids_for_scatter_     = plan_->scatter_tracer[round];
+  }else {
+    ready_to_execute_ids_ = plan_->execution_tracer[round];
+    tids_for_gather_      = plan_->scatter_tracer[round];
+    tids_for_scatter_     = plan_->gather_tracer[round];
+  }
+  VLOG(V_DEBUG) << "ready_to_execute_ids_" << ready_to_execute_ids_[0];
+}
+
+void BatchGraphScheduler::StartReplay(std::shared_ptr<RoundPlan> plan) {
+  replaying_ = true;
+  plan_ = plan;
+  round2offset_ = plan_->round2offset;
+  tids_for_gather_init_ = plan_->tids_for_gather_init;
+  tids_to_jobids_ = plan_->tids_to_jobids;
+  jobids_to_tids_ = plan_->jobids_to_tids;
+  ReplayRound(0);
+}
+
 void BatchGraphScheduler::Initialize() {
   ++rc_;
   CHECK(Terminate());
-  std::fill(activated_times_.begin(), activated_times_.end(), 0);
-  //jobids_to_tids_.resize(activated_times_.size(), 0);
-  //tids_to_jobids_.resize(activated_times_.size(), 0);
-  if (round2offset_.empty())  round2offset_.push_back(0);
-  if (rc_.IsForward()) {
-    //for (int sid = 0; sid < batch_size(); sid++) {
-      //for (int i = 0; i < max_seq_length_; i++) {
+  if (!rc_.IsForward()) {
+    ReplayRound(rc_());
+    return;
+  }
+
+  size_t key = (plan_cache_capacity_ > 0) ? HashGraphStruct() : 0;
+  std::shared_ptr<RoundPlan> plan =
+    (plan_cache_capacity_ > 0) ? LookupPlan(key) : NULL;
+  //a cached plan does not wait for the background thread
+  std::shared_ptr<RoundPlan> prefetched =
+    prefetch_thread_.joinable() ? TakePrefetchedPlan(!plan) : NULL;
+  if (plan) {
+    plan_cache_hits_++;
+    StartReplay(plan);
+  }else if (prefetched) {
+    prefetch_hits_++;
+    prefetched->key = key;
+    StartReplay(prefetched);
+    CachePlan();
+  }else {
+    plan_cache_misses_++;
+    replaying_ = false;
+    plan_.reset(new RoundPlan());
+    plan_->key = key;
+    plan_->graph_struct.assign(graph_struct(), graph_struct()+graph_struct_size());
+
+    std::fill(activated_times_.begin(), activated_times_.end(), 0);
+    if (round2offset_.empty())  round2offset_.push_back(0);
     for (int gid = 0; gid < total_length(); gid++) {
       if ((*children_)[gid].empty() && !(*parents_)[gid].empty()) {
         int tensor_id = GetCurrentRoundOffset() + ready_to_execute_ids_.size();
@@ -188,15 +414,25 @@ void BatchGraphScheduler::Initialize() {
     }
     tids_for_gather_init_[0] = ready_to_execute_ids_;
     tids_for_gather_init_[1].clear();
-    execution_tracer_.clear();
-    gather_tracer_.clear();
-    scatter_tracer_.clear();
-  }else {
-    ready_to_execute_ids_ = std::move(execution_tracer_[rc_()]);
-    tids_for_gather_ = std::move(scatter_tracer_[rc_()]);
-    tids_for_scatter_ = std::move(gather_tracer_[rc_()]);
-    VLOG(V_DEBUG) << "ready_to_execute_ids_" << ready_to_execute_ids_[0];
   }
+  VLOG(V_TIMING) << "[BatchGraphScheduler] round plan cache hits: " << plan_cache_hits_
+                 << "\tmisses: " << plan_cache_misses_
+                 << "\tprefetched: " << prefetch_hits_;
+}
+
+//the tensor ids of a round are only known once the round before
+//is planned, so a batch not found in the cache is planned to the end
+//and then replayed from its first round
+void BatchGraphScheduler::PlanAhead() {
+  CHECK(!Terminate());
+  CHECK(rc_.IsForward() && rc_() == 0);
+  if (replaying_)
+    return;
+  while (!Terminate())
+    ActivateNext();
+  rc_.Reset();
+  ++rc_;
+  StartReplay(plan_);
 }
 
 void BatchGraphScheduler::ActivateNext() {
@@ -204,7 +440,7 @@ void BatchGraphScheduler::ActivateNext() {
     round2offset_.push_back(round2offset_.back() + GetJobId().size());
 
   VLOG(V_DEBUG) << "activation next " << rc_();
-  if (rc_.IsForward()) {
+  if (rc_.IsForward() && !replaying_) {
     vector<int> jobs_next_round;
     jobs_next_round.reserve(1<<20);
     vector<vector<int>> gather_ids_next_round(2);
@@ -236,24 +472,23 @@ void BatchGraphScheduler::ActivateNext() {
         }
       }
     }
-    execution_tracer_.push_back(std::move(ready_to_execute_ids_));
-    gather_tracer_.push_back(std::move(tids_for_gather_));
-    scatter_tracer_.push_back(std::move(tids_for_scatter_));
+    plan_->execution_tracer.push_back(std::move(ready_to_execute_ids_));
+    plan_->gather_tracer.push_back(std::move(tids_for_gather_));
+    plan_->scatter_tracer.push_back(std::move(tids_for_scatter_));
 
     ready_to_execute_ids_ = std::move(jobs_next_round);
     tids_for_gather_      = std::move(gather_ids_next_round);
     tids_for_scatter_     = std::move(scatter_ids_next_round);
-  }else {
-    if (rc_() >= 0) {
-      ready_to_execute_ids_ = std::move(execution_tracer_[rc_()]);
-      tids_for_gather_      = std::move(scatter_tracer_[rc_()]);
-      tids_for_scatter_     = std::move(gather_tracer_[rc_()]);
-      VLOG(V_DEBUG) << "ready_to_execute_ids_" << ready_to_execute_ids_[0];
-    }else {
-      ready_to_execute_ids_.clear();
-      for (auto& ctidg : tids_for_gather_)  { ctidg.clear(); }
-      for (auto& ctids : tids_for_scatter_) { ctids.clear(); }
+    if (ready_to_execute_ids_.empty()) {
+      FinalizePlan();
+      CachePlan();
     }
+  }else if (rc_() >= 0 && rc_() < (int)plan_->execution_tracer.size()) {
+    ReplayRound(rc_());
+  }else {
+    ready_to_execute_ids_.clear();
+    for (auto& ctidg : tids_for_gather_)  { ctidg.clear(); }
+    for (auto& ctids : tids_for_scatter_) { ctids.clear(); }
   }
 }
 
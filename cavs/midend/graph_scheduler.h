@@ -6,13 +6,51 @@
 
 #include <vector>
 #include <list>
+#include <memory>
+#include <unordered_map>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 namespace midend {
 
+//compressed adjacency lists of one batch of graphs,
+//the neighbours of node i are indices_[offsets_[i], offsets_[i+1])
+class CSRAdjacency {
+ public:
+  class Neighbors {
+   public:
+    Neighbors(const int* begin, const int* end) : begin_(begin), end_(end) {}
+    inline const int* begin() const { return begin_; }
+    inline const int* end()   const { return end_;   }
+    inline int  size()  const { return end_ - begin_; }
+    inline bool empty() const { return end_ == begin_; }
+    inline int operator[](int i) const { return begin_[i]; }
+
+   private:
+    const int* begin_;
+    const int* end_;
+  };
+
+  inline Neighbors operator[](int node) const {
+    const int* base = indices_.data();
+    return Neighbors(base + offsets_[node], base + offsets_[node+1]);
+  }
+  inline int size() const { return offsets_.empty() ? 0 : offsets_.size()-1; }
+
+ private:
+  friend class GraphSchedulerBase;
+  std::vector<int> offsets_;
+  std::vector<int> indices_;
+};
+
 class GraphSchedulerBase {
  public:
   GraphSchedulerBase() :
-    batch_size_(0), max_seq_length_(0), total_length_(0), gpu_idx_buf_(NULL) {
+    parents_(NULL), children_(NULL), whole_graph_(false),
+    max_seq_length_(0), batch_size_(0), total_length_(0),
+    graph_struct_(NULL), gpu_idx_buf_(NULL) {
       tids_for_gather_init_.resize(2);
       tids_for_gather_.resize(2);
       tids_for_scatter_.resize(2);
@@ -21,6 +59,19 @@ class GraphSchedulerBase {
   virtual bool Terminate() const = 0;
   virtual void ActivateNext() = 0;
   virtual int GetCurrentRoundOffset() const = 0;
+  virtual ~GraphSchedulerBase() {}
+  //hands over the parent-idx tensor of an upcoming batch,
+  //only the batching scheduler plans ahead
+  virtual void Prefetch(const Tensor& parent_ids) {}
+  //called after Initialize, fixes the tensor id of every job
+  //before the first round is run
+  virtual void PlanAhead() = 0;
+  //while set, the current round holds every job in tensor id order,
+  //which is how the hoisted statements run over the whole graph
+  inline void SetWholeGraphRound(bool on) {
+    CHECK(!Terminate());
+    whole_graph_ = on;
+  }
 
   int LoadGraph(const Tensor& parent_ids);
   int ReverseGraph();
@@ -28,12 +79,12 @@ class GraphSchedulerBase {
   inline int total_length() const { return total_length_; }
   inline int* gpu_idx_buf() const { return gpu_idx_buf_; }
   inline bool HasChild(int job_id) const {
-    CHECK(job_id < (*children_).size());
+    CHECK(job_id < children_->size());
     return !(*children_)[job_id].empty();
   }
   inline const std::vector<int>& GetJobId() const {
     CHECK(!Terminate());
-    return ready_to_execute_ids_;
+    return whole_graph_ ? tids_to_jobids_ : ready_to_execute_ids_;
   }
   inline const std::vector<int>& CurrentRoundTensorIdsForGatherInitialization() const {
     if (rc_.IsForward())
@@ -80,6 +131,8 @@ class GraphSchedulerBase {
   inline int toGlobalId(int sample_id, int local_id) const {
     return sample_offset_in_gid_[sample_id]+local_id;
   }
+  inline const int* graph_struct() const { return graph_struct_; }
+  inline int graph_struct_size() const { return batch_size_*max_seq_length_; }
   std::vector<int>  sample_offset_in_gid_;
   std::vector<int>  ready_to_execute_ids_;
   std::vector<int>  activated_times_;
@@ -93,8 +146,9 @@ class GraphSchedulerBase {
   Tensor message_passer_;
   Tensor func_arg_;
   Tensor func_ret_;
-  std::vector<std::vector<int>> *parents_;
-  std::vector<std::vector<int>> *children_;
+  //swapped by ReverseGraph, no copy is made
+  const CSRAdjacency* parents_;
+  const CSRAdjacency* children_;
   struct RoundCounter {
    public:
     RoundCounter() : round_(-1), isforward_(true) {}
@@ -113,13 +167,17 @@ class GraphSchedulerBase {
     bool isforward_;
   };
   RoundCounter rc_;
+  bool whole_graph_;
 
  private:
   int max_seq_length_;
   int batch_size_;
   int total_length_;
-  std::vector<std::vector<int>> __forward_parents_ids_;
-  std::vector<std::vector<int>> __forward_children_ids_;
+  CSRAdjacency __forward_parents_ids_;
+  CSRAdjacency __forward_children_ids_;
+  std::vector<int> fill_cursor_;
+  //the parent-idx tensor of the current batch
+  const int* graph_struct_;
   int* gpu_idx_buf_;
 };
 
@@ -130,8 +188,11 @@ class SerialGraphScheduler : public GraphSchedulerBase {
   }
   void Initialize() override;
   void ActivateNext() override;
+  void PlanAhead() override;
   inline bool Terminate() const override { return pending_list_.empty(); }
-  inline int GetCurrentRoundOffset() const override { return GetJobId()[0]; }
+  inline int GetCurrentRoundOffset() const override {
+    return whole_graph_ ? 0 : GetJobId()[0];
+  }
 
  private:
   int sample_id_;
@@ -139,19 +200,74 @@ class SerialGraphScheduler : public GraphSchedulerBase {
   std::list<int> pending_list_;
 };
 
+//the schedule of a batch only depends on the parent-idx tensor,
+//so the rounds of each graph structure are kept in an LRU cache
+//(CAVS_ROUND_PLAN_CACHE entries, 0 or less disables it) and replayed when
+//the same structure is loaded again.
+//graphs handed to Prefetch are planned by a background thread on
+//a scheduler of its own and consumed in order by the following
+//Initialize calls. At most CAVS_GRAPH_PREFETCH_DEPTH graphs are pending,
+//beyond that the oldest one is dropped, Prefetch never blocks.
 class BatchGraphScheduler : public GraphSchedulerBase {
  public:
-  BatchGraphScheduler() :
-    GraphSchedulerBase(), execution_tracer_(0) {}
+  BatchGraphScheduler();
+  ~BatchGraphScheduler();
+  void Prefetch(const Tensor& parent_ids) override;
   void Initialize() override;
   void ActivateNext() override;
+  void PlanAhead() override;
   inline bool Terminate() const override { return ready_to_execute_ids_.empty(); }
-  inline int GetCurrentRoundOffset() const override { return round2offset_[rc_()]; }
+  inline int GetCurrentRoundOffset() const override {
+    return whole_graph_ ? 0 : round2offset_[rc_()];
+  }
+  inline size_t plan_cache_hits() const   { return plan_cache_hits_;   }
+  inline size_t plan_cache_misses() const { return plan_cache_misses_; }
+  inline size_t prefetch_hits() const     { return prefetch_hits_;     }
 
  private:
-  std::vector<std::vector<int>> execution_tracer_;
-  std::vector<std::vector<std::vector<int>>> gather_tracer_;
-  std::vector<std::vector<std::vector<int>>> scatter_tracer_;
+  //all forward rounds of one batch, walked backwards by the backward pass
+  struct RoundPlan {
+    size_t key;
+    std::vector<int> graph_struct;
+    std::vector<std::vector<int>> execution_tracer;
+    std::vector<std::vector<std::vector<int>>> gather_tracer;
+    std::vector<std::vector<std::vector<int>>> scatter_tracer;
+    std::vector<int> round2offset;
+    std::vector<std::vector<int>> tids_for_gather_init;
+    std::vector<int> tids_to_jobids;
+    std::vector<int> jobids_to_tids;
+  };
+  struct PrefetchSlot {
+    std::vector<int> graph_struct;
+    std::shared_ptr<RoundPlan> plan;
+  };
+  size_t HashGraphStruct() const;
+  std::shared_ptr<RoundPlan> LookupPlan(size_t key);
+  void FinalizePlan();
+  void CachePlan();
+  void ReplayRound(int round);
+  void StartReplay(std::shared_ptr<RoundPlan> plan);
+  std::shared_ptr<RoundPlan> TakePrefetchedPlan(bool wait);
+  void PrefetchLoop();
+
+  std::shared_ptr<RoundPlan> plan_;
+  bool replaying_;
+  typedef std::list<std::shared_ptr<RoundPlan>> PlanList;
+  PlanList plan_lru_;
+  std::unordered_map<size_t, PlanList::iterator> plan_index_;
+  size_t plan_cache_capacity_;
+  size_t plan_cache_hits_;
+  size_t plan_cache_misses_;
+
+  std::unique_ptr<BatchGraphScheduler> shadow_;
+  std::thread prefetch_thread_;
+  std::mutex prefetch_mu_;
+  std::condition_variable prefetch_cv_;
+  std::deque<std::shared_ptr<PrefetchSlot>> prefetch_slots_;
+  std::vector<int> prefetch_dims_;
+  size_t prefetch_depth_;
+  size_t prefetch_hits_;
+  bool prefetch_stop_;
 };
 
 
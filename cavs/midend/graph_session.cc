@@ -164,7 +164,7 @@ OpContext* GraphSession::GetContext(const Node* node) {
           partial_shape = full_shape;
         }
 
-        Allocator* alloc = GetAllocator(op_def); 
+        Allocator* alloc = GetSessionAllocator(op_def); 
         CHECK_NOTNULL(alloc);
         VLOG(V_DEBUG) << "[In Graph Session]: Allocating full tensor for "
                       << TensorNameInFunctionContext(output)
@@ -206,7 +206,7 @@ OpContext* GraphSession::GetContext(const Node* node) {
 }
 
 namespace __internal {
-  static unordered_map<string, GraphSession*> graph_sess_pool;
+  static thread_local unordered_map<string, GraphSession*> graph_sess_pool;
 }
 
 GraphSession* GetGraphSession(const string& name) {
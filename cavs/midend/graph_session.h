@@ -25,6 +25,10 @@ class GraphSession : public SessionBase {
   }
   const Tensor* GetTensor(const std::string& name, bool recursive = false) const override;
   OpContext* GetContext(const Node* node) override;
+  //the function body allocates the same way as the session it belongs to
+  Allocator* GetSessionAllocator(const OpDef& def) const override {
+    return global_sess_->GetSessionAllocator(def);
+  }
   inline void SetInternalMessagePool(const Tensor* t) {
     CHECK_NOTNULL(t);
     internal_message_pool_ = t;
@@ -2,7 +2,6 @@
 #include "cavs/midend/statement.h"
 #include "cavs/backend/op_decl.h"
 #include "cavs/util/logging.h"
-#include "cavs/util/macros_gpu.h"
 #include "cavs/util/op_def_builder.h"
 #include "cavs/util/op_util.h"
 
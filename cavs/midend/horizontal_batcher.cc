@@ -0,0 +1,196 @@
+#include "cavs/midend/horizontal_batcher.h"
+#include "cavs/util/op_def_builder.h"
+#include "cavs/util/op_util.h"
+
+#include <unordered_map>
+#include <algorithm>
+#include <limits.h>
+
+using std::list;
+using std::vector;
+using std::string;
+using std::unordered_map;
+
+namespace midend {
+
+namespace {
+
+bool IsStackable(Node* n) {
+  if (!n->IsSingleNode() || n->name() != "MatMul")
+    return false;
+  const OpDef& def = dynamic_cast<SingleNode*>(n)->op_def();
+  if (def.device() != CPU || n->input_size() != 2 || n->output_size() != 1)
+    return false;
+  if (!n->control_dependency().empty() || n->output(0)->src_size() != 1)
+    return false;
+  //the rows of A are stacked, so A can not be transposed
+  for (auto& t : GetListArg<int>(def, "Transpose")) {
+    if (t == 0) return false;
+  }
+  return true;
+}
+
+bool IsTransB(Node* n) {
+  for (auto& t : GetListArg<int>(dynamic_cast<SingleNode*>(n)->op_def(), "Transpose")) {
+    if (t == 1) return true;
+  }
+  return false;
+}
+
+//the mirrors of a variable share its memory,
+//so the MatMuls reading two mirrors of it share the operand
+Edge* SharedOperand(Node* n) {
+  Edge* e = n->input(1);
+  while (e->src_size() == 1 && e->src(0)->name() == "Mirror") {
+    CHECK(e->src(0)->input_size() == 1);
+    e = e->src(0)->input(0);
+  }
+  return e;
+}
+
+} //namespace
+
+HorizontalBatcher::HorizontalBatcher(list<Node*>* nodes) : nodes_(nodes) {
+  CHECK(!nodes->empty());
+  while (MergeOneGroup());
+}
+
+//the merged node has to run after the producers of all the inputs
+//and before the consumers of all the outputs, which also rules out
+//MatMuls depending on each other
+bool HorizontalBatcher::MergeOneGroup() {
+  unordered_map<Node*, int> node2idx;
+  vector<Node*> order(nodes_->begin(), nodes_->end());
+  for (size_t i = 0; i < order.size(); i++)
+    node2idx[order[i]] = i;
+
+  auto last_producer = [&node2idx](Node* n) {
+    int pos = -1;
+    for (Edge* e : n->input()) {
+      for (Node* src : e->src(true)) {
+        if (node2idx.find(src) != node2idx.end())
+          pos = std::max(pos, node2idx.at(src));
+      }
+    }
+    return pos;
+  };
+  auto first_consumer = [&node2idx](Node* n) {
+    int pos = INT_MAX;
+    for (Node* dst : n->output(0)->dst(true)) {
+      if (node2idx.find(dst) != node2idx.end())
+        pos = std::min(pos, node2idx.at(dst));
+    }
+    return pos;
+  };
+
+  vector<Edge*> operands;
+  vector<vector<Node*>> candidates;
+  for (Node* n : order) {
+    if (!IsStackable(n)) continue;
+    const OpDef& def = dynamic_cast<SingleNode*>(n)->op_def();
+    Edge* b = SharedOperand(n);
+    size_t i = 0;
+    for (; i < operands.size(); i++) {
+      Node* head = candidates[i].front();
+      if (operands[i] == b && IsTransB(head) == IsTransB(n) &&
+          dynamic_cast<SingleNode*>(head)->dtype() == def.dtype())
+        break;
+    }
+    if (i == operands.size()) {
+      operands.push_back(b);
+      candidates.emplace_back();
+    }
+    candidates[i].push_back(n);
+  }
+
+  for (auto& nodes : candidates) {
+    for (size_t s = 0; s+1 < nodes.size(); s++) {
+      vector<Node*> group = {nodes[s]};
+      int lo = last_producer(nodes[s]);
+      int hi = first_consumer(nodes[s]);
+      for (size_t t = s+1; t < nodes.size(); t++) {
+        int new_lo = std::max(lo, last_producer(nodes[t]));
+        int new_hi = std::min(hi, first_consumer(nodes[t]));
+        if (new_lo < new_hi) {
+          group.push_back(nodes[t]);
+          lo = new_lo;
+          hi = new_hi;
+        }
+      }
+      if (group.size() > 1) {
+        Node* merged = Merge(group);
+        //placed right after the last producer
+        nodes_->insert(std::next(nodes_->begin(), lo+1), merged);
+        for (Node* n : group)
+          nodes_->remove(n);
+        RemoveDeadMirrors(group);
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+//only one of the mirrors feeds the merged node,
+//the others of the block are left without consumers
+void HorizontalBatcher::RemoveDeadMirrors(const vector<Node*>& group) {
+  for (Node* n : group) {
+    Edge* e = n->input(1);
+    while (e->dst_size() == 0 && e->src_size() == 1 &&
+           e->src(0)->name() == "Mirror") {
+      Node* mirror = e->src(0);
+      if (std::find(nodes_->begin(), nodes_->end(), mirror) == nodes_->end())
+        break;
+      VLOG(V_DEBUG) << "Removing the dead " << mirror->debug_info();
+      nodes_->remove(mirror);
+      e = mirror->input(0);
+      e->RemoveDst(mirror);
+    }
+  }
+}
+
+Node* HorizontalBatcher::Merge(const vector<Node*>& group) {
+  vector<string> inputs;
+  vector<string> outputs;
+  vector<TensorShapeDef> shapes;
+  for (Node* n : group) {
+    inputs.push_back(n->input(0)->name());
+    outputs.push_back(n->output(0)->name());
+    shapes.push_back(n->output(0)->shape());
+  }
+  Node* head = group.front();
+  const OpDef& head_def = dynamic_cast<SingleNode*>(head)->op_def();
+  //any of the mirrors will do, they are the same tensor
+  Edge* b = head->input(1);
+  inputs.push_back(b->name());
+  OpDef op_def;
+  OpDefBuilder("MatMulStacked")
+    .Input(inputs)
+    .Output(outputs)
+    .Shape(shapes)
+    .Dtype(head_def.dtype())
+    .AttrList("Transpose", IsTransB(head) ? vector<int>{1} : vector<int>{})
+    .Device(head_def)
+    .Finalize(&op_def);
+  VLOG(V_DEBUG) << "Merging " << group.size() << " MatMuls into\n"
+                << op_def.DebugString();
+  SingleNode* merged = new SingleNode(op_def, head->scope());
+  for (Node* n : group) {
+    Edge* a = n->input(0);
+    a->RemoveDst(n);
+    a->AddDst(merged);
+    merged->AddInput(a);
+    n->input(1)->RemoveDst(n);
+  }
+  b->AddDst(merged);
+  merged->AddInput(b);
+  for (Node* n : group) {
+    Edge* c = n->output(0);
+    c->RemoveSource(n);
+    c->AddSource(merged);
+    merged->AddOutput(c);
+  }
+  return merged;
+}
+
+} //namespace midend
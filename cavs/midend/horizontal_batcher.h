@@ -0,0 +1,29 @@
+#ifndef CAVS_MIDEND_HORIZONTAL_BATCHER_H_
+#define CAVS_MIDEND_HORIZONTAL_BATCHER_H_
+
+#include "cavs/midend/node.h"
+
+#include <list>
+
+namespace midend {
+
+//The HorizontalBatcher merges the MatMuls of a basic block
+//that multiply by the same right-hand operand (seen through Mirror),
+//such as h_l*U_f and h_r*U_f in the tree-lstm, into one MatMulStacked.
+//The merged node writes the original output tensors, so their consumers
+//are untouched. Only host MatMuls are merged, where the stacked gemm
+//packs the shared operand once for all of them.
+class HorizontalBatcher {
+ public:
+  explicit HorizontalBatcher(std::list<Node*>* nodes);
+
+ private:
+  bool MergeOneGroup();
+  Node* Merge(const std::vector<Node*>& group);
+  void RemoveDeadMirrors(const std::vector<Node*>& group);
+  std::list<Node*>* nodes_;
+};
+
+} //namespace midend
+
+#endif
@@ -0,0 +1,87 @@
+#include "cavs/midend/loop_invariant_hoister.h"
+
+#include <set>
+#include <string>
+#include <algorithm>
+
+using std::list;
+using std::set;
+using std::string;
+using std::vector;
+
+namespace midend {
+
+namespace {
+
+//the operators whose result differs from round to round
+//however their inputs are, and those with side effects
+bool IsRoundVariant(Node* n) {
+  static const vector<string> variant_ops =
+    {"Gather", "Scatter", "Push", "FunctionPushArg", "FunctionPopRet"};
+  return !n->IsSingleNode() || n->IsStatefulOp() ||
+         std::find(variant_ops.begin(), variant_ops.end(), n->name())
+           != variant_ops.end();
+}
+
+} //namespace
+
+LoopInvariantHoister::LoopInvariantHoister(list<Node*>* nodes, list<Node*>* hoisted_node) {
+  CHECK(!nodes->empty());
+  CHECK(hoisted_node->empty());
+
+  Scope* s = nodes->front()->scope();
+  set<Node*> hoisted;
+  for (Node* n : *nodes) {
+    CHECK(n->scope() == s);
+    if (IsRoundVariant(n) || !n->control_dependency().empty())
+      continue;
+    bool invariant = true;
+    for (Edge* e : n->input()) {
+      //tensors from the outer scope do not change within the rounds,
+      //their producers(in their own scope) are not ours to check
+      if (e->scope() != s)
+        continue;
+      for (Node* src : e->src(true)) {
+        if (hoisted.find(src) == hoisted.end()) {
+          invariant = false;
+          break;
+        }
+      }
+      if (!invariant) break;
+    }
+    for (Edge* e : n->output()) {
+      //written by some other node, or living out of the function
+      if (e->scope() != s || e->src_size() != 1) {
+        invariant = false;
+        break;
+      }
+    }
+    if (invariant) {
+      VLOG(V_DEBUG) << "Hoisting " << n->debug_info();
+      hoisted.insert(n);
+    }
+  }
+
+  //nothing but the views of the outer tensors is left in place,
+  //moving them buys nothing
+  bool has_work = false;
+  for (Node* n : hoisted) {
+    if (n->name() != "Mirror" && n->name() != "Reshape") {
+      has_work = true;
+      break;
+    }
+  }
+  if (!has_work)
+    return;
+
+  for (auto iter = nodes->begin(); iter != nodes->end(); ) {
+    if (hoisted.find(*iter) != hoisted.end()) {
+      hoisted_node->push_back(*iter);
+      nodes->erase(iter++);
+    }else {
+      iter++;
+    }
+  }
+}
+
+} //namespace midend
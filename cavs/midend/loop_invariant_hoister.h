@@ -0,0 +1,24 @@
+#ifndef CAVS_MIDEND_LOOP_INVARIANT_HOISTER_H_
+#define CAVS_MIDEND_LOOP_INVARIANT_HOISTER_H_
+
+#include "cavs/midend/node.h"
+
+#include <list>
+
+namespace midend {
+
+//The LoopInvariantHoister moves the part of a node function
+//that does not depend on the gathered messages, such as
+//Pull->EmbeddingLookup->MatMul(x, W) and the bias adds, out of the
+//basic block into hoisted_node, in their original order.
+//Every operator of a node function works row by row on the vertices
+//of one round, so these nodes give the same rows when they run once
+//over all the vertices, which the GraphStatement does before the rounds.
+class LoopInvariantHoister {
+ public:
+  LoopInvariantHoister(std::list<Node*>* nodes, std::list<Node*>* hoisted_node);
+};
+
+} //namespace midend
+
+#endif
@@ -0,0 +1,221 @@
+#include "cavs/midend/memory_planner.h"
+#include "cavs/util/logging.h"
+
+#include <algorithm>
+#include <map>
+
+using std::vector;
+using std::unordered_map;
+
+namespace midend {
+
+namespace {
+
+const size_t kAlignment = 64;
+
+inline size_t AlignUp(size_t bytes) {
+  return (bytes + kAlignment - 1)/kAlignment*kAlignment;
+}
+
+template <typename T>
+inline T* Root(T* l) {
+  while (l->donor) l = l->donor;
+  return l;
+}
+
+} //namespace
+
+MemoryPlanner::~MemoryPlanner() {
+  for (auto& arena : arenas_) {
+    if (arena.data)
+      arena.alloc->DeallocateRaw(arena.data);
+  }
+}
+
+//the buffer gets memory of its own again, its contents are lost.
+//It is transient to every executor planned so far, each of which writes it
+//before reading it, and no operator keeps state in it(those are never
+//planned), so nothing reads the lost contents.
+//The arena is released with the last buffer planned in it.
+void MemoryPlanner::Unplan(const TensorBufferBase* buf) {
+  auto it = planned_.find(buf);
+  if (it != planned_.end()) {
+    VLOG(V_DEBUG) << "[MemoryPlanner] unplanning " << it->second.first->name();
+    it->second.first->AliasExternal(NULL);
+    Arena& arena = arenas_[it->second.second];
+    if (--arena.users == 0) {
+      arena.alloc->DeallocateRaw(arena.data);
+      arena.data = NULL;
+    }
+    planned_.erase(it);
+  }
+}
+
+void MemoryPlanner::Plan(const vector<Statement*>& stmts,
+    const vector<const Tensor*>& fetched, bool inplace) {
+  unordered_map<const TensorBufferBase*, Lifetime> lifetimes;
+  for (int i = 0; i < (int)stmts.size(); i++) {
+    const bool plain = (stmts[i]->type() == Statement::EXPR);
+    OpImpl* op = plain ? static_cast<ExprStatement*>(stmts[i])->GetOp() : NULL;
+    stmts[i]->ForEachContext([&](OpContext* ctxt) {
+      //the inputs are read before the outputs are written
+      for (int j = 0; j < ctxt->InputSize(); j++) {
+        Lifetime& l = lifetimes[ctxt->Input(j).buffer()];
+        if (l.first < 0) l.first = i;
+        l.last = i;
+      }
+      for (int j = 0; j < ctxt->OutputSize(); j++) {
+        Tensor* t = ctxt->Output(j);
+        Lifetime& l = lifetimes[t->buffer()];
+        if (l.first < 0) {
+          l.first = i;
+          l.tensor = t;
+          l.plannable = plain && ctxt->InputSize() > 0;
+        }
+        if (op && op->KeepsOutputState(j))
+          l.stateful = true;
+        l.last = i;
+      }
+    });
+  }
+
+  for (auto* t : fetched) {
+    if (lifetimes.find(t->buffer()) != lifetimes.end())
+      lifetimes[t->buffer()].plannable = false;
+  }
+
+  Candidates candidates;
+  size_t planned_bytes = 0;
+  for (auto& iter : lifetimes) {
+    const TensorBufferBase* buf = iter.first;
+    Lifetime& l = iter.second;
+    if (seen_.count(buf)) {
+      //reordered by this executor
+      Unplan(buf);
+      continue;
+    }
+    seen_.insert(buf);
+    if (!l.plannable || l.stateful || l.tensor->IsDynamicShape() ||
+        l.tensor->ZeroInitEnforced() || l.tensor->IsAliased() ||
+        buf->size() == 0 || buf->capacity() != buf->size())
+      continue;
+    candidates[buf] = &l;
+    planned_bytes += buf->size();
+  }
+
+  const int shared = inplace ? ShareInPlace(stmts, &candidates) : 0;
+
+  //the arenas of different allocators are planned separately,
+  //the buffers sharing in place take the offsets of their donors
+  std::map<Allocator*, vector<Lifetime*>> groups;
+  for (auto& iter : candidates)
+    groups[iter.first->allocator()].push_back(iter.second);
+
+  size_t arena_bytes = 0;
+  for (auto& group : groups) {
+    Allocator* alloc = group.first;
+    vector<Lifetime*> roots;
+    for (Lifetime* l : group.second) {
+      if (!l->donor) roots.push_back(l);
+    }
+    size_t size = Assign(&roots);
+    char* arena = static_cast<char*>(alloc->AllocateRaw(size));
+    CHECK_NOTNULL(arena);
+    arenas_.push_back({alloc, arena, (int)group.second.size()});
+    for (Lifetime* l : group.second) {
+      l->offset = Root(l)->offset;
+      l->tensor->AliasExternal(arena + l->offset);
+      planned_[l->tensor->buffer()] = std::make_pair(l->tensor, (int)arenas_.size()-1);
+      VLOG(V_DEBUG) << "[MemoryPlanner] " << l->tensor->name()
+                    << " [" << l->first << ", " << l->last << "] at "
+                    << l->offset;
+    }
+    arena_bytes += size;
+  }
+  VLOG(V_TIMING) << "[MemoryPlanner] " << stmts.size() << " statements, "
+                 << planned_bytes << " Bytes of transient tensors in "
+                 << arena_bytes << " Bytes of arenas, "
+                 << shared << " outputs in place";
+}
+
+//an output takes over an input if the operator tolerates the aliasing
+//and the input(with the buffers it took over) is not accessed afterwards
+int MemoryPlanner::ShareInPlace(const vector<Statement*>& stmts,
+    Candidates* candidates) {
+  int shared = 0;
+  for (int i = 0; i < (int)stmts.size(); i++) {
+    if (stmts[i]->type() != Statement::EXPR)
+      continue;
+    ExprStatement* stmt = static_cast<ExprStatement*>(stmts[i]);
+    OpContext* ctxt = stmt->GetContext();
+    OpImpl* op = stmt->GetOp();
+    if (!ctxt || !op || ctxt->OutputSize() != 1 || op->KeepsOutputState(0))
+      continue;
+    const TensorBufferBase* out_buf = ctxt->Output(0)->buffer();
+    auto out = candidates->find(out_buf);
+    //the output is first written here and has no donor yet
+    if (out == candidates->end() || out->second->first != i ||
+        out->second->donor)
+      continue;
+    for (int j = 0; j < ctxt->InputSize(); j++) {
+      const TensorBufferBase* inp_buf = ctxt->Input(j).buffer();
+      auto inp = candidates->find(inp_buf);
+      if (inp == candidates->end() || !op->TolerateAliasing(j) ||
+          inp_buf->size() != out_buf->size() ||
+          inp_buf->allocator() != out_buf->allocator())
+        continue;
+      Lifetime* root = Root(inp->second);
+      if (root->last != i)
+        continue;
+      out->second->donor = inp->second;
+      root->last = out->second->last;
+      VLOG(V_DEBUG) << "[MemoryPlanner] " << out->second->tensor->name()
+                    << " in place of " << inp->second->tensor->name();
+      shared++;
+      break;
+    }
+  }
+  return shared;
+}
+
+//greedy by size: each buffer, largest first, takes the smallest gap
+//left by the placed buffers whose lifetimes overlap with it,
+//or goes on top of them
+size_t MemoryPlanner::Assign(vector<Lifetime*>* lifetimes) {
+  std::sort(lifetimes->begin(), lifetimes->end(),
+      [](const Lifetime* a, const Lifetime* b) {
+    size_t sa = a->tensor->buffer()->size();
+    size_t sb = b->tensor->buffer()->size();
+    return (sa != sb) ? sa > sb : a->first < b->first;
+  });
+  vector<Lifetime*> placed;
+  size_t total = 0;
+  for (Lifetime* l : *lifetimes) {
+    const size_t bytes = AlignUp(l->tensor->buffer()->size());
+    vector<std::pair<size_t, size_t>> busy;
+    for (Lifetime* p : placed) {
+      if (p->first <= l->last && l->first <= p->last)
+        busy.emplace_back(p->offset, p->offset + AlignUp(p->tensor->buffer()->size()));
+    }
+    std::sort(busy.begin(), busy.end());
+    size_t best = 0;
+    size_t best_gap = 0;
+    bool found = false;
+    size_t top = 0;
+    for (auto& range : busy) {
+      if (range.first > top && range.first - top >= bytes &&
+          (!found || range.first - top < best_gap)) {
+        best = top;
+        best_gap = range.first - top;
+        found = true;
+      }
+      top = std::max(top, range.second);
+    }
+    l->offset = found ? best : top;
+    total = std::max(total, l->offset + bytes);
+    placed.push_back(l);
+  }
+  return total;
+}
+
+} //namespace midend
@@ -0,0 +1,80 @@
+#ifndef CAVS_MIDEND_MEMORY_PLANNER_H_
+#define CAVS_MIDEND_MEMORY_PLANNER_H_
+
+#include "cavs/midend/statement.h"
+#include "cavs/midend/tensor.h"
+#include "cavs/midend/allocator.h"
+#include "cavs/util/macros.h"
+
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace midend {
+
+//Packs the transient tensors of a compiled executor into shared arenas.
+//The lifetime of a buffer spans the statements of the executor from its
+//first write to its last access. Scoped and graph statements count as one
+//step, everything they touch is live over the whole statement.
+//A buffer is planned only if it is first written by a plain operator
+//with inputs, so the following keep their own memory:
+//  the outputs of sources(variables, constants, placeholders, data)
+//  zero-init-enforced(accumulated) and dynamic-shaped tensors
+//  the outputs an operator keeps state in(OpImpl::KeepsOutputState),
+//  e.g. row-sparse gradients, whose untouched rows must stay zero
+//  tensors first touched inside a scoped or graph statement, that is
+//  the bodies compiled by ScopedNode::Compile are not planned
+//  the outputs fetched by Run, and the buffers of other executors
+//Buffers overlapping in time get disjoint ranges of the arena of their
+//allocator, placed greedily by size at the best-fitting offset.
+//A buffer accessed by a later executor as well is unplanned, since the
+//statement orders of the two executors say nothing about each other.
+//With inplace, the output of an operator that tolerates aliasing takes
+//over the range of an equal-sized input whose last access is that operator.
+//The statements run in order, so it must not be combined with OPT_INTEROP.
+class MemoryPlanner {
+ public:
+  MemoryPlanner() {}
+  ~MemoryPlanner();
+  void Plan(const std::vector<Statement*>& stmts,
+            const std::vector<const Tensor*>& fetched,
+            bool inplace = false);
+
+ private:
+  struct Lifetime {
+    Lifetime() : tensor(NULL), first(-1), last(-1), plannable(false),
+                 stateful(false), offset(0), donor(NULL) {}
+    Tensor* tensor;
+    int first;
+    int last;
+    bool plannable;
+    //written by an operator that keeps state in it across iterations
+    bool stateful;
+    size_t offset;
+    //the lifetime whose range the buffer takes over in place
+    Lifetime* donor;
+  };
+  typedef std::unordered_map<const TensorBufferBase*, Lifetime*> Candidates;
+  void Unplan(const TensorBufferBase* buf);
+  int ShareInPlace(const std::vector<Statement*>& stmts, Candidates* candidates);
+  size_t Assign(std::vector<Lifetime*>* lifetimes);
+
+  struct Arena {
+    Allocator* alloc;
+    void* data;
+    //the buffers still planned in the arena
+    int users;
+  };
+
+  //the buffers accessed by the executors planned so far
+  std::unordered_set<const TensorBufferBase*> seen_;
+  //the planned buffers with the index of their arena
+  std::unordered_map<const TensorBufferBase*, std::pair<Tensor*, int>> planned_;
+  std::vector<Arena> arenas_;
+
+  DISALLOW_COPY_AND_ASSIGN(MemoryPlanner);
+};
+
+} //namespace midend
+
+#endif
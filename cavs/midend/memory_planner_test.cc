@@ -0,0 +1,200 @@
+#include "cavs/midend/memory_planner.h"
+#include "cavs/midend/allocator.h"
+#include "cavs/midend/tensor_test.h"
+#include "cavs/util/logging.h"
+#include "cavs/util/op_def_builder.h"
+#include "cavs/util/op_util.h"
+
+#include <math.h>
+
+using namespace midend;
+using namespace midend::test;
+
+const int kCount = 256;
+
+Allocator* HostAllocator() {
+  return GetAllocator(DeviceTypeToString(CPU));
+}
+
+Tensor HostTensor(const string& name) {
+  return Tensor(name, HostAllocator(), DT_FLOAT, TensorShape(vector<int>{kCount}));
+}
+
+Tensor HostTensor(const string& name, int rows, int width) {
+  return Tensor(name, HostAllocator(), DT_FLOAT, TensorShape(vector<int>{rows, width}));
+}
+
+//the statements stay alive until the process exits
+Statement* NewStatement(const string& op, const vector<const Tensor*>& inputs,
+    Tensor* output, float lr = 0.f) {
+  OpDefBuilder builder(op);
+  builder.Output(output->name()).Device("CPU").Dtype(DT_FLOAT);
+  if (op == "SGD")
+    builder.AttrSingle("Learning_rate", lr);
+  OpDef def;
+  builder.Finalize(&def);
+  OpContext* ctxt = new OpContext();
+  for (auto* t : inputs)
+    ctxt->AppendInput(t);
+  ctxt->AppendOutput(output);
+  return new ExprStatement(CreateOp(def), ctxt);
+}
+
+//D = ((X+X)+X)*2 + X through the transient tensors A, B and C:
+//  A = X+X, B = A+X, C = B+B, D = C+X
+//A is dead when C is written, so they can share memory
+struct Chain {
+  Chain() : X(HostTensor("X")), A(HostTensor("A")), B(HostTensor("B")),
+            C(HostTensor("C")), D(HostTensor("D")) {
+    vector<float> vals(kCount);
+    for (int i = 0; i < kCount; i++)
+      vals[i] = float(i%13)/13.f;
+    FillValues<float>(&X, vals);
+    Append(&X, &X, &A);
+    Append(&A, &X, &B);
+    Append(&B, &B, &C);
+    Append(&C, &X, &D);
+  }
+
+  void Append(const Tensor* a, const Tensor* b, Tensor* out) {
+    stmts.push_back(NewStatement("Add", {a, b}, out));
+  }
+
+  vector<float> Run() {
+    for (auto* stmt : stmts)
+      stmt->Run();
+    vector<float> vals;
+    FetchValues<float>(&vals, D);
+    return vals;
+  }
+
+  Tensor X, A, B, C, D;
+  vector<Statement*> stmts;
+};
+
+//an aliased buffer uses the memory it is given,
+//NULL gives it memory of its own again
+void TestAlias() {
+  Tensor t = HostTensor("t");
+  Tensor view("view", t);
+  CHECK(!t.IsAliased());
+  vector<float> external(kCount, 3.f);
+  t.AliasExternal(external.data());
+  CHECK(t.IsAliased() && view.IsAliased());
+  CHECK(t.data<float>() == external.data());
+  //the tensors sharing the buffer see the same memory
+  CHECK(view.data<float>() == external.data());
+  t.mutable_data<float>()[1] = 5.f;
+  CHECK(external[1] == 5.f);
+
+  t.AliasExternal(NULL);
+  CHECK(!t.IsAliased());
+  CHECK(t.data<float>() != external.data());
+  CHECK(t.data<float>() != NULL);
+  FillValues<float>(&t, vector<float>(kCount, 1.f));
+  CHECK(external[1] == 5.f);
+  LOG(INFO) << "Aliasing passed";
+}
+
+void TestPlan() {
+  Chain plain;
+  const vector<float> expected = plain.Run();
+
+  Chain chain;
+  MemoryPlanner planner;
+  planner.Plan(chain.stmts, {&chain.D});
+  //X is a source and D is fetched
+  CHECK(!chain.X.IsAliased() && !chain.D.IsAliased());
+  CHECK(chain.A.IsAliased() && chain.B.IsAliased() && chain.C.IsAliased());
+  //A and B, B and C are live at the same time, A and C are not
+  CHECK(chain.A.data<float>() == chain.C.data<float>());
+  CHECK(chain.A.data<float>() != chain.B.data<float>());
+
+  for (int iter = 0; iter < 3; iter++) {
+    vector<float> vals = chain.Run();
+    for (int i = 0; i < kCount; i++) {
+      CHECK(fabs(vals[i] - expected[i]) < 1e-6f)
+        << iter << "\t" << i << "\t" << vals[i] << "\t" << expected[i];
+    }
+  }
+
+  //another executor reading B unplans it, the rest of the arena stays in use
+  Tensor E = HostTensor("E");
+  chain.Append(&chain.B, &chain.X, &E);
+  planner.Plan({chain.stmts.back()}, {&E});
+  CHECK(!chain.B.IsAliased());
+  CHECK(chain.A.IsAliased() && chain.C.IsAliased());
+  vector<float> vals = chain.Run();
+  CHECK(vals == expected);
+  LOG(INFO) << "Memory planning passed";
+}
+
+const int kRows  = 16;
+const int kWidth = 16;
+const int kIds   = 4;
+
+//the row-sparse gradient of an embedding matrix is followed by
+//a transient tensor of the same size, which would take over its range:
+//  dY = Y+Y, G = EmbeddingLookupGrad(dY, ids), SGD(var, G), T = Z+Z, U = T+Z
+struct SparseChain {
+  SparseChain() : ids("ids", HostAllocator(), DT_FLOAT, TensorShape(vector<int>{kIds})),
+                  Y(HostTensor("Y", kIds, kWidth)), dY(HostTensor("dY", kIds, kWidth)),
+                  G(HostTensor("G", kRows, kWidth)), var(HostTensor("var", kRows, kWidth)),
+                  Z(HostTensor("Z", kRows, kWidth)), T(HostTensor("T", kRows, kWidth)),
+                  U(HostTensor("U", kRows, kWidth)) {
+    vector<float> vals(kRows*kWidth);
+    for (int i = 0; i < kRows*kWidth; i++)
+      vals[i] = float(i%7) + 1.f;
+    FillValues<float>(&Y, vector<float>(vals.begin(), vals.begin()+kIds*kWidth));
+    FillValues<float>(&var, vals);
+    FillValues<float>(&Z, vals);
+    stmts.push_back(NewStatement("Add", {&Y, &Y}, &dY));
+    stmts.push_back(NewStatement(GetGradientName("EmbeddingLookup"), {&dY, &ids}, &G));
+    stmts.push_back(NewStatement("SGD", {&var, &G}, &var, 0.1f));
+    stmts.push_back(NewStatement("Add", {&Z, &Z}, &T));
+    stmts.push_back(NewStatement("Add", {&T, &Z}, &U));
+  }
+
+  //every iteration looks up other rows
+  vector<float> Run(int iters) {
+    for (int iter = 0; iter < iters; iter++) {
+      Statement::SetRound(iter);
+      vector<float> id_vals(kIds);
+      for (int i = 0; i < kIds; i++)
+        id_vals[i] = (iter*5 + i*3) % kRows;
+      FillValues<float>(&ids, id_vals);
+      for (auto* stmt : stmts)
+        stmt->Run();
+    }
+    vector<float> vals;
+    FetchValues<float>(&vals, var);
+    return vals;
+  }
+
+  Tensor ids, Y, dY, G, var, Z, T, U;
+  vector<Statement*> stmts;
+};
+
+//the untouched rows of a row-sparse gradient stay zero from one iteration
+//to the next, so it keeps its own memory while the others are planned
+void TestStatefulOutputs() {
+  const int iters = 5;
+  SparseChain plain;
+  const vector<float> expected = plain.Run(iters);
+
+  SparseChain chain;
+  MemoryPlanner planner;
+  planner.Plan(chain.stmts, {&chain.U}, true);
+  CHECK(!chain.G.IsAliased());
+  CHECK(chain.dY.IsAliased() && chain.T.IsAliased());
+  CHECK(chain.G.data<float>() != chain.T.data<float>());
+  CHECK(chain.Run(iters) == expected);
+  LOG(INFO) << "Stateful outputs passed";
+}
+
+int main() {
+  TestAlias();
+  TestPlan();
+  TestStatefulOutputs();
+  return 0;
+}
@@ -3,6 +3,8 @@
 #include "cavs/midend/runtime_compiler/code_generator.h"
 #include "cavs/midend/stream_scheduler.h"
 #include "cavs/midend/batch_weight_updater.h"
+#include "cavs/midend/horizontal_batcher.h"
+#include "cavs/midend/loop_invariant_hoister.h"
 #include "cavs/util/op_def_builder.h"
 
 using std::string;
@@ -161,11 +163,26 @@ Statement* GraphNode::Compile(
       }
     }
     CHECK_NOTNULL(gsess_);
+    vector<Statement*> hoisted;
+    if (sess->opt_type() & OPT_HOISTING) {
+      std::list<Node*> hoisted_node;
+      VLOG(V_DEBUG) << "Begin hoisting the round-invariant nodes in ScopedNode";
+      LoopInvariantHoister hoister(&(sn->nodes_), &hoisted_node);
+      VLOG(V_DEBUG) << "Hoisting the round-invariant nodes done in ScopedNode";
+      //compiled before the basic block, which reads their outputs
+      for (Node* hn : hoisted_node) {
+        Statement* stmt = hn->Compile(gsess_);
+        CHECK(stmt) << hn->debug_info();
+        hoisted.push_back(stmt);
+      }
+    }
     Statement* node_func_stmt = sn->Compile(gsess_);
 
     push_ctxt->SetGraphScheduler(gsess_->graph_scheduler());
     push_arg_stmt = new ExprStatement(push_arg_op, push_ctxt);
     stmt_ = new GraphStatement(node_func_stmt, gsess_->graph_scheduler());
+    if (!hoisted.empty())
+      dynamic_cast<GraphStatement*>(stmt_)->SetHoistedStatements(std::move(hoisted));
     dynamic_cast<GraphStatement*>(stmt_)->SetGlobalContext(ctxt);
     dynamic_cast<GraphStatement*>(stmt_)->SetPushArgStatement(push_arg_stmt);
     if (pop_exist) {
@@ -286,6 +303,12 @@ Statement* ScopedNode::Compile(
     VLOG(V_DEBUG) << "It contains a scope "    << contained_->scoped_name();
     BasicBlock* bb = new BasicBlock(iter_);
 
+    if ((sess->opt_type() & OPT_HORIZONTAL) && sess->session_type() == SessionBase::GRAPH) {
+      VLOG(V_DEBUG) << "Begin merging the MatMuls in ScopedNode";
+      HorizontalBatcher batcher(&nodes_);
+      VLOG(V_DEBUG) << "Merging the MatMuls done in ScopedNode";
+    }
+
     if ((sess->opt_type() & OPT_FUSION) && sess->session_type() == SessionBase::GRAPH) {
       VLOG(V_DEBUG) << "Begin modifing the critical path for fusion in ScopedNode";
       RTC::CodeGenerator generator(&nodes_);
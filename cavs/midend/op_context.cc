@@ -8,7 +8,7 @@ using std::unordered_map;
 namespace midend {
 
 unordered_map<string, void*> OpContext::repo_;
-int OpContext::dyn_dim_ = -1;
+thread_local int OpContext::dyn_dim_ = -1;
 
 void OpContext::SetTensorOffset() {
   if (gs_ && !gs_->Terminate()) {
@@ -92,16 +92,13 @@ void OpContext::SetZero() {
 
 void OpContext::WaitForEvent() {
   if (stream_id_ > -1 && wait_for_event_id_ > -1) {
-    checkCudaError(cudaStreamWaitEvent(
-          StreamEventHandlePool::GetCudaStream(stream_id_),
-          StreamEventHandlePool::GetCudaEvent(wait_for_event_id_), 0));
+    StreamEventHandlePool::WaitForEvent(stream_id_, wait_for_event_id_);
   }
 }
 
 void OpContext::RecordMyEvent() {
   if (stream_id_ > -1 && event_record_id_ > -1) {
-    checkCudaError(cudaEventRecord(StreamEventHandlePool::GetCudaEvent(event_record_id_),
-                                   StreamEventHandlePool::GetCudaStream(stream_id_))); 
+    StreamEventHandlePool::RecordEvent(event_record_id_, stream_id_);
     VLOG(V_DEBUG) << "stream: " << stream_id_ << "\tevent: " << event_record_id_;
   }
 }
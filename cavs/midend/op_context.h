@@ -36,6 +36,7 @@ class OpContext {
   }
   inline GraphSchedulerBase* graph_scheduler() { return gs_; }
   inline static void SetDynDim(int dyn_dim) { dyn_dim_ = dyn_dim; }
+  inline static int dyn_dim() { return dyn_dim_; }
 
   void SetTensorOffset();
   void ResetTensorOffset();
@@ -49,7 +50,6 @@ class OpContext {
   static std::unordered_map<std::string, void*> repo_;
 
  private:
-  inline static int dyn_dim() { return dyn_dim_; }
   std::vector<const Tensor*> inputs_;
   std::vector<Tensor*> outputs_;
   int stream_id_;
@@ -58,7 +58,7 @@ class OpContext {
   std::vector<int> inputs_event_ids_;
   int round_;
   GraphSchedulerBase* gs_;
-  static int dyn_dim_;
+  static thread_local int dyn_dim_;
 };
 
 inline const Tensor& OpContext::Input(int idx) const {
@@ -52,7 +52,9 @@ class OpTest {
 
     op_.reset(CreateOp(node_->op_def())); 
     context_.reset(sess_->GetContext(node_));
+    op_->Prepare();
     op_->Compute(context_.get());
+    return true;
   }
 
  private:
@@ -0,0 +1,151 @@
+#include "cavs/midend/parallel_executor.h"
+#include "cavs/util/thread_pool.h"
+#include "cavs/util/logging.h"
+
+#include <unordered_map>
+#include <algorithm>
+
+using std::vector;
+using std::unordered_map;
+
+namespace midend {
+
+ParallelExecutor::ParallelExecutor(const vector<Statement*>& stmts)
+    : stmts_(stmts), successors_(stmts.size()), in_degree_(stmts.size(), 0),
+      pending_(stmts.size()), remaining_(0) {
+  //accesses since the last barrier, keyed by the underlying buffer
+  struct Access {
+    Access() : writer(-1) {}
+    int writer;
+    vector<int> readers;
+  };
+  unordered_map<const TensorBufferBase*, Access> accesses;
+  int barrier = -1;
+  vector<int> since_barrier;
+  const int n = stmts_.size();
+
+  for (int i = 0; i < n; i++) {
+    if (IsBarrier(stmts_[i])) {
+      for (int prev : since_barrier)
+        AddDependency(prev, i);
+      if (since_barrier.empty() && barrier >= 0)
+        AddDependency(barrier, i);
+      accesses.clear();
+      since_barrier.clear();
+      barrier = i;
+      continue;
+    }
+    if (barrier >= 0)
+      AddDependency(barrier, i);
+    OpContext* ctxt = dynamic_cast<ExprStatement*>(stmts_[i])->GetContext();
+    for (int j = 0; j < ctxt->InputSize(); j++) {
+      Access& acc = accesses[ctxt->Input(j).buffer()];
+      if (acc.writer >= 0)
+        AddDependency(acc.writer, i);
+      acc.readers.push_back(i);
+    }
+    for (int j = 0; j < ctxt->OutputSize(); j++) {
+      Access& acc = accesses[ctxt->Output(j)->buffer()];
+      if (acc.writer >= 0)
+        AddDependency(acc.writer, i);
+      for (int r : acc.readers)
+        AddDependency(r, i);
+      acc.writer = i;
+      acc.readers.clear();
+    }
+    since_barrier.push_back(i);
+  }
+
+  int edges = 0;
+  for (int i = 0; i < n; i++) {
+    auto& succ = successors_[i];
+    std::sort(succ.begin(), succ.end());
+    succ.erase(std::unique(succ.begin(), succ.end()), succ.end());
+    for (int s : succ)
+      in_degree_[s]++;
+    edges += succ.size();
+  }
+  for (int i = 0; i < n; i++) {
+    if (in_degree_[i] == 0)
+      sources_.push_back(i);
+  }
+  VLOG(V_DEBUG) << "[ParallelExecutor] " << stmts_.size() << " statements, "
+                << edges << " dependencies, " << sources_.size() << " sources";
+}
+
+bool ParallelExecutor::IsBarrier(Statement* stmt) const {
+  if (stmt->type() != Statement::EXPR)
+    return true;
+  ExprStatement* expr = dynamic_cast<ExprStatement*>(stmt);
+  if (!expr)
+    return true;
+  OpContext* ctxt = expr->GetContext();
+  for (int j = 0; j < ctxt->InputSize(); j++) {
+    if (ctxt->Input(j).IsDynamicShape())
+      return true;
+  }
+  for (int j = 0; j < ctxt->OutputSize(); j++) {
+    if (ctxt->Output(j)->IsDynamicShape())
+      return true;
+  }
+  return false;
+}
+
+void ParallelExecutor::AddDependency(int from, int to) {
+  //operators updating their input in place depend on themselves
+  if (from == to)
+    return;
+  CHECK(from < to);
+  successors_[from].push_back(to);
+}
+
+void ParallelExecutor::Run() {
+  if (stmts_.empty())
+    return;
+  for (size_t i = 0; i < stmts_.size(); i++)
+    pending_[i] = in_degree_[i];
+  remaining_ = stmts_.size();
+  //the calling thread takes the first source itself
+  for (size_t i = 1; i < sources_.size(); i++) {
+    int id = sources_[i];
+    Schedule(id);
+  }
+  Process(sources_[0]);
+  std::unique_lock<std::mutex> lock(mu_);
+  cv_.wait(lock, [this]{ return remaining_ == 0; });
+}
+
+//the thread-local state of the scheduling thread goes with the statement
+void ParallelExecutor::Schedule(int id) {
+  const int round = Statement::round();
+  const int dyn_dim = OpContext::dyn_dim();
+  ThreadPool::Get()->Schedule([this, id, round, dyn_dim]() {
+    Statement::SetRound(round);
+    OpContext::SetDynDim(dyn_dim);
+    Process(id);
+  });
+}
+
+void ParallelExecutor::Process(int id) {
+  //one ready successor is continued in place, the others are handed out
+  while (id >= 0) {
+    stmts_[id]->Run();
+    int next = -1;
+    for (int s : successors_[id]) {
+      if (--pending_[s] == 0) {
+        if (next < 0) {
+          next = s;
+        }else {
+          Schedule(s);
+        }
+      }
+    }
+    if (--remaining_ == 0) {
+      std::lock_guard<std::mutex> lock(mu_);
+      cv_.notify_all();
+    }
+    id = next;
+  }
+}
+
+} //namespace midend
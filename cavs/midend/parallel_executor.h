@@ -0,0 +1,44 @@
+#ifndef CAVS_MIDEND_PARALLEL_EXECUTOR_H_
+#define CAVS_MIDEND_PARALLEL_EXECUTOR_H_
+
+#include "cavs/midend/statement.h"
+#include "cavs/util/macros.h"
+
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+namespace midend {
+
+//runs the statements of one executor as a dependency DAG on the thread pool.
+//the DAG is derived from the buffers each statement reads and writes,
+//so that any schedule yields the same result as the sequential order.
+//statements other than plain operators, and operators on dynamic tensors
+//(which share the global dynamic dimension), act as barriers.
+class ParallelExecutor {
+ public:
+  explicit ParallelExecutor(const std::vector<Statement*>& stmts);
+  void Run();
+
+ private:
+  bool IsBarrier(Statement* stmt) const;
+  void AddDependency(int from, int to);
+  void Process(int id);
+  void Schedule(int id);
+
+  std::vector<Statement*> stmts_;
+  std::vector<std::vector<int>> successors_;
+  std::vector<int> in_degree_;
+  std::vector<int> sources_;
+  std::vector<std::atomic<int>> pending_;
+  std::atomic<int> remaining_;
+  std::mutex mu_;
+  std::condition_variable cv_;
+
+  DISALLOW_COPY_AND_ASSIGN(ParallelExecutor);
+};
+
+} //namespace midend
+
+#endif
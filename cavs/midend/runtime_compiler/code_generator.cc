@@ -1,6 +1,7 @@
 #include "cavs/midend/runtime_compiler/code_generator.h"
 #include "cavs/midend/runtime_compiler/statement_builder.h"
 #include "cavs/util/op_def_builder.h"
+#include "cavs/util/op_util.h"
 #include "cavs/proto/types.pb.h"
 
 using std::string;
@@ -12,9 +13,10 @@ using std::set;
 namespace midend {
 namespace RTC {
 
-string GenKernelName() {
-  static int kernel_id = 0;
-  return "FusedKernel_" + std::to_string(kernel_id++);
+//named after the code, so that identical kernels get identical sources
+//in every process and are found in the kernel cache
+string GenKernelName(const string& declaration, const string& body) {
+  return "FusedKernel_" + GetFingerprint(declaration + body);
 }
 
 string GenKernelDeclaration(const string& kernel_name,
@@ -50,8 +52,88 @@ string GenKernelDeclaration(const string& kernel_name,
   return source;
 }
 
+//the host kernels share one signature so that they can be called
+//through a plain function pointer, the arrays are unpacked on entry.
+//[begin, end) is the slice of elements handled by one thread.
+string GenKernelDeclarationCpu(const string& kernel_name) {
+  string source = "#include <math.h>\n";
+  source += "extern \"C\" void " + kernel_name;
+  source += "(void** outputs, const void** inputs, "
+            "const int* outputs_count, const int* inputs_count, "
+            "const void** sources, const int** indices, const int* indices_count, "
+            "const int n_elements, const int begin, const int end)\n";
+  return source;
+}
+
+string GenKernelArgumentsCpu(const list<Edge*>& inputs, const list<Edge*>& outputs,
+                             const vector<Node*>& sources) {
+  string args;
+  size_t i = 0;
+  for (auto* e : outputs) {
+    string type = CodeGenerator::typeToString(e->dtype());
+    args += type + " *" + e->name() + " = (" + type + "*)outputs[" + std::to_string(i) + "];\n";
+    args += "const int " + CodeGenerator::arrSize(e->name()) + " = outputs_count[" + std::to_string(i) + "];\n";
+    i++;
+  }
+  i = 0;
+  for (auto* e : inputs) {
+    string type = CodeGenerator::typeToString(e->dtype());
+    args += "const " + type + " *" + e->name() + " = (const " + type + "*)inputs[" + std::to_string(i) + "];\n";
+    args += "const int " + CodeGenerator::arrSize(e->name()) + " = inputs_count[" + std::to_string(i) + "];\n";
+    i++;
+  }
+  for (i = 0; i < sources.size(); i++) {
+    string type = CodeGenerator::typeToString(dynamic_cast<SingleNode*>(sources[i])->dtype());
+    string j = std::to_string(i);
+    args += "const " + type + " *source_" + j + " = (const " + type + "*)sources[" + j + "];\n";
+    args += "const int *indices_" + j + " = indices[" + j + "];\n";
+    args += "const int " + CodeGenerator::arrSize("indices_" + j) + " = indices_count[" + j + "];\n";
+  }
+  return args;
+}
+
+//the rows of a gather or pull, or a split slice of them,
+//read from the source tensor through the tensor ids of the round.
+//rows without an id (the gather initialization) read zero.
+string GenIndirectRead(Node* n, const vector<Node*>& sources) {
+  int split = 1, index = 0;
+  Node* src = n;
+  if (n->name() == "Slice") {
+    const OpDef& def = dynamic_cast<SingleNode*>(n)->op_def();
+    split = GetSingleArg<int>(def, "Split");
+    index = GetSingleArg<int>(def, "Index");
+    src = n->input(0)->src(0, true);
+  }
+  auto iter = std::find(sources.begin(), sources.end(), src);
+  CHECK(iter != sources.end());
+  const OpDef& src_def = dynamic_cast<SingleNode*>(src)->op_def();
+  CHECK(src_def.shape_size() == 1);
+  int stride = 1;
+  for (auto d : src_def.shape(0).dim())
+    stride *= d;
+  CHECK(stride > 0 && stride % split == 0) << src_def.DebugString();
+  const string j = std::to_string(iter - sources.begin());
+  const string width = std::to_string(stride/split);
+  const string row = "idx/" + width;
+  const string ref = "source_" + j + "[indices_" + j + "[" + row + "]*"
+    + std::to_string(stride) + " + " + std::to_string(stride/split*index)
+    + " + idx%" + width + "]";
+  return CodeGenerator::typeToString(dynamic_cast<SingleNode*>(n)->dtype()) + " "
+    + CodeGenerator::PrefixedVar(n->output(0)->name()) + " = ("
+    + row + " < " + CodeGenerator::arrSize("indices_" + j) + ") ? " + ref + " : 0;\n";
+}
+
 namespace Ewise {
 
+//broadcasted operands wrap around with a modulo,
+//which keeps the host compiler from vectorizing the loop
+string EwiseArrayRef(const string& name, bool broadcast) {
+  if (broadcast)
+    return name + "[idx%" + CodeGenerator::arrSize(name) + "]";
+  else
+    return name + "[idx]";
+}
+
 string EwiseGenBodyThreadIndexing(const string& inner) {
   string idx = "const int idx = blockIdx.x * blockDim.x + threadIdx.x;\n";
   idx += "if (idx < n_elements) {\n";
@@ -62,12 +144,30 @@ string EwiseGenBodyThreadIndexing(const string& inner) {
   return idx;
 }
 
-string EwiseGenBodyGetInput(const list<Edge*>& inputs) {
+string EwiseGenBodyLoopCpu(const list<Edge*>& inputs, const list<Edge*>& outputs,
+                           const string& contiguous, const string& broadcast) {
+  string cond;
+  for (auto* e : outputs) {
+    cond += (cond.empty() ? "" : " && ") + CodeGenerator::arrSize(e->name()) + " == n_elements";
+  }
+  for (auto* e : inputs) {
+    cond += (cond.empty() ? "" : " && ") + CodeGenerator::arrSize(e->name()) + " == n_elements";
+  }
+  string loop = "if (" + cond + ") {\n";
+  loop += "#pragma GCC ivdep\n";
+  loop += "for (int idx = begin; idx < end; idx++) {\n" + contiguous + "}\n";
+  loop += "}else {\n";
+  loop += "for (int idx = begin; idx < end; idx++) {\n" + broadcast + "}\n";
+  loop += "}\n";
+  return loop;
+}
+
+string EwiseGenBodyGetInput(const list<Edge*>& inputs, bool broadcast = true) {
   string var_decl;
   for (auto* e : inputs) {
     string type = CodeGenerator::typeToString(e->dtype());
     string var_name = CodeGenerator::PrefixedVar(e->name());
-    string array_ref_name = e->name() + "[idx%" + CodeGenerator::arrSize(e->name()) + "]";
+    string array_ref_name = EwiseArrayRef(e->name(), broadcast);
     var_decl += type + " " + var_name + " = " + array_ref_name + ";\n";
     //if (bcast)
       //var_decl += type + " " + CodeGenerator::OriVar(e->name()) + " = " + var_name + ";\n";
@@ -83,15 +183,24 @@ string EwiseGenBodyGetInput(const string& name, float init) {
   return var_decl;
 }
 
-string EwiseGenBodyAssignOutput(const list<Edge*>& outputs) {
+//outputs smaller than n_elements accumulate, atomically on the gpu.
+//a host kernel with such outputs is run by one thread.
+string EwiseGenBodyAssignOutput(const list<Edge*>& outputs,
+                                bool broadcast = true, bool atomic = true) {
   string array_assign;
   for (auto* e : outputs) {
-    string array_ref_name = e->name() + "[idx%" + CodeGenerator::arrSize(e->name()) + "]";
+    string array_ref_name = EwiseArrayRef(e->name(), broadcast);
     string var_name = CodeGenerator::PrefixedVar(e->name());
     string ori_var_name = CodeGenerator::OriVar(e->name());
     string assignment = array_ref_name + " = " + var_name + ";\n";
+    if (!broadcast) {
+      array_assign += assignment;
+      continue;
+    }
     string keep_ori_value = CodeGenerator::typeToString(e->dtype()) + " " + ori_var_name + " = " + array_ref_name + ";\n";
-    string atomic_assignment = "atomicAdd(&" + array_ref_name + ", (" + var_name + " - " + ori_var_name + "));\n";
+    string atomic_assignment = atomic ?
+      "atomicAdd(&" + array_ref_name + ", (" + var_name + " - " + ori_var_name + "));\n" :
+      array_ref_name + " += (" + var_name + " - " + ori_var_name + ");\n";
     string branch = "if (" + CodeGenerator::arrSize(e->name()) + " < n_elements) {\n"
                   + keep_ori_value + atomic_assignment + "}else {\n" + assignment + "}\n";
     array_assign += branch;
@@ -101,6 +210,47 @@ string EwiseGenBodyAssignOutput(const list<Edge*>& outputs) {
 
 } //namespace Ewise
 
+string CodeGenerator::GenFuncBody(const list<Node*>& nodes,
+    const list<Edge*>& in_edges, const list<Edge*>& out_edges,
+    const vector<Node*>& sources,
+    vector<string>* stateful_output, bool broadcast, bool atomic) {
+  string func_body = Ewise::EwiseGenBodyGetInput(in_edges, broadcast);
+  stateful_output->clear();
+  //bool batch_enable = false;
+  for (auto* n : nodes) {
+    CHECK(n->IsSingleNode());
+    //if (dynamic_cast<SingleNode*>(n)->IsBatchEnabled())
+      //batch_enable = true;
+    VLOG(V_DEBUG) << dynamic_cast<SingleNode*>(n)->op_def().DebugString();
+    if (n->name() == "Gather" || n->name() == "Pull" || n->name() == "Slice") {
+      //a source only read through its slices is never materialized
+      const vector<Node*>& dst = n->output(0)->dst(true);
+      if (n->name() == "Slice" ||
+          std::any_of(dst.begin(), dst.end(), [](Node* d) { return d->name() != "Slice"; }))
+        func_body += GenIndirectRead(n, sources);
+      continue;
+    }
+    if (n->IsStatefulOp() &&
+        std::find(stateful_output->begin(), stateful_output->end(), n->output(0)->name())
+          == stateful_output->end()) {
+      CHECK(n->output_size() == 1);
+      stateful_output->push_back(n->output(0)->name());
+      if (std::find(out_edges.begin(), out_edges.end(), n->output(0)) !=
+          out_edges.end()) {
+        func_body += Ewise::EwiseGenBodyGetInput({n->output(0)}, broadcast);
+      }else {
+        func_body += Ewise::EwiseGenBodyGetInput(n->output(0)->name(), 0.f);
+      }
+    }
+    if (!n->IsStatefulOp())
+      func_body +=  VarDeclStatementBuilder().SetNode(n).toCode();
+    else
+      func_body +=  AssignStatementBuilder().SetNode(n).toCode();
+  }
+  func_body += Ewise::EwiseGenBodyAssignOutput(out_edges, broadcast, atomic);
+  return func_body;
+}
+
 CodeGenerator::CodeGenerator(list<Node*>* n) : parser_(n) {
   int groups = parser_.GenerateGroup();
   list<Edge*> in_edges;
@@ -110,35 +260,41 @@ CodeGenerator::CodeGenerator(list<Node*>* n) : parser_(n) {
   VLOG(V_DEBUG) << groups << " Groups Found";
   for (int i = 0; i < groups; i++) {
     parser_.FuseGroup(i, &nodes, &in_edges, &out_edges);
-    string name = GenKernelName();
-    string source = GenKernelDeclaration(name, in_edges, out_edges);
-    string func_body = Ewise::EwiseGenBodyGetInput(in_edges);
+    //the fused kernel runs where the group was placed
+    CHECK(nodes.front()->IsSingleNode());
+    DeviceType device = dynamic_cast<SingleNode*>(nodes.front())->op_def().device();
     vector<string> stateful_output;
-    //bool batch_enable = false;
+    //the gathers and pulls read inside the kernel, only on the host
+    vector<Node*> sources;
+    vector<string> source_ops;
+    vector<int> source_children;
     for (auto* n : nodes) {
-      CHECK(n->IsSingleNode());
-      //if (dynamic_cast<SingleNode*>(n)->IsBatchEnabled())
-        //batch_enable = true;
-      VLOG(V_DEBUG) << dynamic_cast<SingleNode*>(n)->op_def().DebugString();
-      if (n->IsStatefulOp() &&
-          std::find(stateful_output.begin(), stateful_output.end(), n->output(0)->name())
-            == stateful_output.end()) {
-        CHECK(n->output_size() == 1);
-        stateful_output.push_back(n->output(0)->name());
-        if (std::find(out_edges.begin(), out_edges.end(), n->output(0)) !=
-            out_edges.end()) {
-          func_body += Ewise::EwiseGenBodyGetInput({n->output(0)});
-        }else {
-          func_body += Ewise::EwiseGenBodyGetInput(n->output(0)->name(), 0.f);
-        }
+      if (n->name() == "Gather" || n->name() == "Pull") {
+        CHECK(device == CPU);
+        sources.push_back(n);
+        source_ops.push_back(n->name());
+        source_children.push_back(n->name() == "Gather" ?
+            GetSingleArg<int>(dynamic_cast<SingleNode*>(n)->op_def(), "Child") : -1);
       }
-      if (!n->IsStatefulOp())
-        func_body +=  VarDeclStatementBuilder().SetNode(n).toCode();
-      else
-        func_body +=  AssignStatementBuilder().SetNode(n).toCode();
     }
-    func_body += Ewise::EwiseGenBodyAssignOutput(out_edges);
-    source += "{\n" + Ewise::EwiseGenBodyThreadIndexing(func_body) + "}\n";
+    string name, source;
+    if (device == CPU) {
+      string contiguous = GenFuncBody(nodes, in_edges, out_edges, sources,
+                                      &stateful_output, false, false);
+      string broadcast = GenFuncBody(nodes, in_edges, out_edges, sources,
+                                     &stateful_output, true, false);
+      string body = "{\n" + GenKernelArgumentsCpu(in_edges, out_edges, sources)
+                  + Ewise::EwiseGenBodyLoopCpu(in_edges, out_edges, contiguous, broadcast)
+                  + "}\n";
+      name = GenKernelName(GenKernelDeclarationCpu(""), body);
+      source = GenKernelDeclarationCpu(name) + body;
+    }else {
+      string func_body = GenFuncBody(nodes, in_edges, out_edges, sources,
+                                     &stateful_output, true, true);
+      string body = "{\n" + Ewise::EwiseGenBodyThreadIndexing(func_body) + "}\n";
+      name = GenKernelName(GenKernelDeclaration("", in_edges, out_edges), body);
+      source = GenKernelDeclaration(name, in_edges, out_edges) + body;
+    }
 
     {
       vector<string> output_names;
@@ -160,7 +316,9 @@ CodeGenerator::CodeGenerator(list<Node*>* n) : parser_(n) {
         .AttrSingle("KernelName", name)
         .AttrSingle("KernelSource", source)
         .AttrList<string>("ZeroEnforced", stateful_output)
-        .Device("GPU")
+        .AttrList<string>("IndirectSources", source_ops)
+        .AttrList<int>("IndirectChildren", source_children)
+        .Device(device)
         .Finalize(&op_def);
       SingleNode* new_node = new SingleNode(op_def, nodes.front()->scope());
       //if (batch_enable) new_node->SetBatchEnabled();
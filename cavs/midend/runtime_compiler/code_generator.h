@@ -24,6 +24,13 @@ class CodeGenerator {
   }
   
  private:
+  //the statements computing one element of a fused group,
+  //broadcast operands are indexed modulo their size,
+  //the sources are the gathers and pulls read through tensor ids
+  static std::string GenFuncBody(const std::list<Node*>& nodes,
+      const std::list<Edge*>& in_edges, const std::list<Edge*>& out_edges,
+      const std::vector<Node*>& sources,
+      std::vector<std::string>* stateful_output, bool broadcast, bool atomic);
   std::vector<std::string> kernel_source_;
   Parser parser_;
   static std::unordered_map<int, std::string> DataTypeToString;
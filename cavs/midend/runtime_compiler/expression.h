@@ -2,7 +2,7 @@
 #define CAVS_MIDEND_RUNTIME_COMPILER_EXPRESSION_H_
 
 #include "cavs/midend/runtime_compiler/code_generator.h"
-#include "cavs/util/macros_gpu.h"
+#include "cavs/util/logging.h"
 #include "cavs/proto/types.pb.h"
 
 #include <string>
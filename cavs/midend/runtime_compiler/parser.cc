@@ -1,6 +1,7 @@
 #include "cavs/midend/runtime_compiler/parser.h"
 #include "cavs/midend/node.h"
 #include "cavs/util/logging.h"
+#include "cavs/util/op_util.h"
 
 #include <algorithm>
 #include <map>
@@ -40,6 +41,20 @@ bool isFusable(Node* node) {
       //&& dynamic_cast<SingleNode*>(node)->IsBatchEnabled();
 }
 
+bool isIndirectSource(const string& op) {
+  return op == "Gather" || op == "Pull";
+}
+
+bool isOnCpu(Node* node) {
+  return node->IsSingleNode() &&
+         dynamic_cast<SingleNode*>(node)->op_def().device() == CPU;
+}
+
+bool isSplitSlice(Node* node) {
+  return node->IsSingleNode() && node->name() == "Slice" &&
+         GetSingleArg<int>(dynamic_cast<SingleNode*>(node)->op_def(), "Split", 0) > 0;
+}
+
 bool isDeserved(Node* node) {
   return node->IsSingleNode() && isDeserved(node->name());
 }
@@ -62,6 +77,36 @@ Parser::Parser(list<Node*>* n)
   }
 }
 
+//on the host, a gather or pull and the split slices of its rows
+//are read inside the fused loop through the tensor ids of the round,
+//as long as every row they produce is consumed by the group
+bool Parser::isIndirectRead(Node* node) const {
+  if (!isOnCpu(node))
+    return false;
+  if (isSplitSlice(node)) {
+    Node* src = node->input(0)->src(0, true);
+    return node2idx_.find(src) != node2idx_.end() && isIndirectRead(src);
+  }
+  if (!isIndirectSource(node->name()))
+    return false;
+  const vector<Node*>& consumers = node->output(0)->dst(true);
+  if (consumers.empty())
+    return false;
+  for (Node* c : consumers) {
+    if (node2idx_.find(c) == node2idx_.end())
+      return false;
+    if (isSplitSlice(c)) {
+      for (Node* cc : c->output(0)->dst(true)) {
+        if (node2idx_.find(cc) == node2idx_.end() || !isFusable(cc))
+          return false;
+      }
+    }else if (!isFusable(c)) {
+      return false;
+    }
+  }
+  return true;
+}
+
 int FindGroup(int id, const vector<int>& group) {
   CHECK(id < group.size());
   int parent_id = group[id];
@@ -81,7 +126,7 @@ int Parser::GenerateGroup() {
   vector<int> top_line(nodes_->size(), INT_MAX);
   vector<bool> activated(nodes_->size(), false);
   for (int id = 0; id < nodes_->size(); id++, iter++) {
-    if (isFusable(*iter)) {
+    if (isFusable(*iter) || isIndirectRead(*iter)) {
       if (isDeserved(*iter)) fusion_benefit[id] += 1;
       CHECK((*iter)->output_size() == 1);
       Edge* edge = (*iter)->output(0);
@@ -89,7 +134,7 @@ int Parser::GenerateGroup() {
         if (node2idx_.find(parent_node) == node2idx_.end()) continue;
         //we loose this constraint because batchweightupdater may remove some nodes in this scope
         //CHECK(node2idx_.find(parent_node) != node2idx_.end());
-        if (isFusable(parent_node)) {
+        if (isFusable(parent_node) || isIndirectRead(parent_node)) {
           int pid = node2idx_.at(parent_node);
           CHECK(pid > id);
           int gpid = FindGroup(pid, group);
@@ -129,9 +174,33 @@ int Parser::GenerateGroup() {
     for (int id : iter.second)
       VLOG(V_DEBUG) << "GroupContent:\t" << id;
     if (fusion_benefit[iter.first] > 1) {
+      //a gather or pull heading the group has no inputs,
+      //so the fused node also has to follow the producers of the other inputs
+      int pos = bottom_line[iter.first];
+      bool has_input = false;
+      set<int> members(iter.second.begin(), iter.second.end());
+      for (int id : iter.second) {
+        for (Edge* ie : (*std::next(nodes_->begin(), id))->input()) {
+          bool internal = false;
+          for (Node* src : ie->src(true)) {
+            if (node2idx_.find(src) == node2idx_.end())
+              continue;
+            if (members.find(node2idx_.at(src)) == members.end())
+              pos = std::max(pos, node2idx_.at(src));
+            else
+              internal = true;
+          }
+          has_input |= !internal;
+        }
+      }
+      //the group can not be placed before its consumers,
+      //or it reads nothing but gathered or pulled rows, leave it unfused
+      if (pos >= top_line[iter.first] || !has_input) {
+        VLOG(V_DEBUG) << "Skipping GroupID:\t" << iter.first;
+        continue;
+      }
       group_contents_.push_back(std::move(iter.second)); 
-      CHECK(bottom_line[iter.first] < top_line[iter.first]);
-      group_insert_pos_.push_back(bottom_line[iter.first]);
+      group_insert_pos_.push_back(pos);
     }
   }
 
@@ -24,6 +24,7 @@ class Parser {
   void Finalize();
 
  private:
+  bool isIndirectRead(Node* node) const;
   //int FindGroup(int id) const;
   std::list<Node*>* nodes_;
   //std::vector<std::vector<int>>* dependency_;
@@ -269,7 +269,8 @@ string Scope::debug_info() const {
 }
 
 Scope* main_scope() {
-  static Scope* s = new Scope(NULL, "main");
+  //each threaded worker builds its own graph
+  static thread_local Scope* s = new Scope(NULL, "main");
   return s;
 }
 
@@ -70,7 +70,7 @@ OpContext* SessionBase::GetContext(const Node* node) {
       }else {
         CHECK(output->shape().dim_size() > 0);
         TensorShape shape(output->shape()); 
-        Allocator* alloc = GetAllocator(op_def); 
+        Allocator* alloc = GetSessionAllocator(op_def); 
         CHECK_NOTNULL(alloc);
         VLOG(V_DEBUG) << "allocating tensor for " << output->scoped_name()
                       << " with shape info: " << shape.debug_info();
@@ -90,6 +90,20 @@ OpContext* SessionBase::GetContext(const Node* node) {
   return ctxt;
 }
 
+void SessionBase::SetAllocator(Allocator* alloc) {
+  CHECK_NOTNULL(alloc);
+  VLOG(V_DEBUG) << "Session allocator for device " << alloc->type()
+                << " set to " << alloc->name();
+  allocators_[alloc->type()] = alloc;
+}
+
+Allocator* SessionBase::GetSessionAllocator(const OpDef& def) const {
+  if (allocators_.find(def.device()) != allocators_.end())
+    return allocators_.at(def.device());
+  else
+    return GetAllocator(def);
+}
+
 string SessionBase::debug_info() const {
   string ret;
   for (auto& one_pair : scoped_tensor_map_)
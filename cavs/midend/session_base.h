@@ -1,6 +1,7 @@
 #ifndef CAVS_MIDEND_SESSION_BASE_H_
 #define CAVS_MIDEND_SESSION_BASE_H_
 
+#include "cavs/midend/allocator.h"
 #include "cavs/midend/tensor.h"
 #include "cavs/midend/node.h"
 
@@ -21,6 +22,10 @@ class SessionBase {
                    const std::vector<Tensor>& input_tensors) {
     LOG(FATAL) << "Base Session";
   }
+  //hands the parent-idx tensor of a coming Run to the graph schedulers
+  //reading input_name, it is only a hint and ignored by default
+  virtual void PrefetchGraph(const std::string& input_name,
+                             const Tensor& graph) {}
 
   enum SessionType { SIMPLE=1, MPI=2, GRAPH=4 };
   virtual int session_type() const { return SIMPLE; }
@@ -28,12 +33,17 @@ class SessionBase {
   //void AddType(SessionType t) { type_ += (int)t; }
 
   void InsertTensor(const Tensor& t);
+  //tensors of this session on alloc->type() come from alloc
+  //instead of the device default
+  void SetAllocator(Allocator* alloc);
+  virtual Allocator* GetSessionAllocator(const OpDef& def) const;
   std::string debug_info() const ;
  protected:
   std::unordered_map<std::string, Tensor> raw_tensor_map_;
   std::unordered_map<std::string, Tensor> scoped_tensor_map_;
   //int type_;
   int opt_;
+  std::unordered_map<int, Allocator*> allocators_;
 };
 
 SessionBase* GetSession(const std::string& name, int opt);
@@ -1,9 +1,14 @@
 #include "cavs/midend/session_simple.h"
 #include "cavs/midend/statement.h"
 #include "cavs/backend/op_impl_mpi_functor.h"
+#include "cavs/util/communicator.h"
 #include "cavs/util/op_def_builder.h"
 
 #include <mpi.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <algorithm>
+#include <atomic>
 #include <unordered_map>
 #include <list>
 
@@ -11,6 +16,7 @@ using std::string;
 using std::vector;
 using std::list;
 using std::set;
+using std::unordered_map;
 
 using ::backend::MPIAllReduceFunctor;
 
@@ -28,14 +34,140 @@ class MPISession: public SimpleSession {
                    vector<Tensor>* output_tensors) override;
 };
 
+bool IsVariableGradient(const string& name) {
+  return (name.length() >= 13 && name.substr(0, 8) == "Variable")
+          && name.substr(name.length()-5, 5) == "_grad";
+}
+
+//the gradients are packed into buckets of at most this size,
+//and each bucket is reduced as soon as its last gradient is produced
+size_t BucketBytes() {
+  const char* env = getenv("CAVS_MPI_BUCKET_BYTES");
+  return (env && atol(env) > 0) ? atol(env) : (4 << 20);
+}
+
+struct GradientBucket {
+  vector<string> names;
+  vector<TensorShapeDef> shapes;
+  size_t bytes = 0;
+  int ready = -1;        //the position of the last producer
+  int needed = INT_MAX;  //the position of the first consumer
+};
+
+//the MPIAllReduceStart node is placed right after the bucket is ready,
+//the MPIAllReduceWait node right before its first consumer
+//(the Clip or the ApplyGradient), so that the reduction
+//overlaps the rest of the backward pass
+void AddBucketsOnPath(list<Node*>& critical_path,
+    const vector<Node*>& producers) {
+  //the names key the buckets of the whole process, which the threaded
+  //workers compile into concurrently, so they are unique in the process
+  static std::atomic<int> bucket_id(0);
+  vector<list<Node*>::iterator> pos2iter;
+  unordered_map<Node*, int> node2pos;
+  for (auto iter = critical_path.begin(); iter != critical_path.end(); iter++) {
+    node2pos[*iter] = pos2iter.size();
+    pos2iter.push_back(iter);
+  }
+
+  unordered_map<string, int> last_producer;
+  vector<string> names;
+  unordered_map<string, Edge*> grads;
+  for (Node* n : producers) {
+    const string& name = n->output(0)->name();
+    if (last_producer.find(name) == last_producer.end()) {
+      names.push_back(name);
+      grads[name] = n->output(0);
+    }
+    last_producer[name] = std::max(last_producer[name], node2pos.at(n));
+  }
+  std::stable_sort(names.begin(), names.end(),
+      [&last_producer](const string& a, const string& b) {
+        return last_producer.at(a) < last_producer.at(b);
+      });
+  auto first_consumer = [&](const string& name) {
+    int pos = INT_MAX;
+    for (int i = last_producer.at(name)+1; i < (int)pos2iter.size(); i++) {
+      for (Edge* e : (*pos2iter[i])->input()) {
+        if (e->name() == name) pos = std::min(pos, i);
+      }
+    }
+    return pos;
+  };
+
+  const size_t limit = BucketBytes();
+  vector<GradientBucket> buckets(1);
+  for (auto& name : names) {
+    size_t bytes = sizeof(float);
+    for (int d : grads.at(name)->shape().dim())
+      bytes *= d;
+    GradientBucket* b = &buckets.back();
+    //a bucket must be ready before any of its gradients is needed
+    if (!b->names.empty() &&
+        (b->bytes + bytes > limit || last_producer.at(name) >= b->needed)) {
+      buckets.emplace_back();
+      b = &buckets.back();
+    }
+    b->names.push_back(name);
+    b->shapes.push_back(grads.at(name)->shape());
+    b->bytes += bytes;
+    b->ready = std::max(b->ready, last_producer.at(name));
+    b->needed = std::min(b->needed, first_consumer(name));
+  }
+
+  Scope* scope = producers.front()->scope();
+  vector<Node*> waits;
+  for (auto& b : buckets) {
+    if (b.names.empty()) continue;
+    string bucket = "MPIBucket" + std::to_string(Communicator::Get()->rank())
+                  + "_" + std::to_string(bucket_id++);
+    VLOG(V_DEBUG) << bucket << ": " << b.names.size()
+                  << " gradients in " << b.bytes << " bytes";
+    OpDef start_def;
+    OpDefBuilder("MPIAllReduceStart")
+      .Input(b.names)
+      .AttrSingle("Bucket", bucket)
+      .Device("GPU")
+      .Finalize(&start_def);
+    Node* start = new SingleNode(start_def, scope);
+    OpDef wait_def;
+    OpDefBuilder("MPIAllReduceWait")
+      .Input(b.names)
+      .Output(b.names)
+      .Shape(b.shapes)
+      .AttrSingle("Bucket", bucket)
+      .Device("GPU")
+      .Finalize(&wait_def);
+    Node* wait = new SingleNode(wait_def, scope);
+    for (auto& name : b.names) {
+      Edge* grad = grads.at(name);
+      start->AddInput(grad);
+      wait->AddInput(grad);
+      wait->AddOutput(grad);
+    }
+    critical_path.insert(std::next(pos2iter[b.ready]), start);
+    waits.push_back(wait);
+  }
+  //the starts go first, in case a bucket is needed right after it is ready
+  int i = 0;
+  for (auto& b : buckets) {
+    if (b.names.empty()) continue;
+    Node* wait = waits[i++];
+    if (b.needed == INT_MAX)
+      critical_path.push_back(wait);
+    else
+      critical_path.insert(pos2iter[b.needed], wait);
+  }
+}
+
 void AddMPIOnPath(list<Node*>& critical_path) {
+  vector<Node*> producers;
   auto iter = critical_path.begin(); 
   while (iter != critical_path.end()) {
     if ((*iter)->IsSingleNode()) {
       string name = (*iter)->output(0)->name();
       LOG(INFO) << name;
-      if ((name.length() >= 13 && name.substr(0, 8) == "Variable")
-          && name.substr(name.length()-5, 5) == "_grad") {
+      if (IsVariableGradient(name)) {
         if ((*iter)->name() == "MatMul") {
           LOG(INFO) << "SFB mechanism ENABLing...";
           CHECK((*iter)->output_size() == 1);
@@ -58,18 +190,7 @@ void AddMPIOnPath(list<Node*>& critical_path) {
         }else {
           //we assume the output size of variable_grad node must equal 1
           CHECK((*iter)->output_size() == 1);
-          OpDef comm;
-          OpDefBuilder("MPIAllReduce")
-            .Input(name)
-            .Output(name)
-            .Shape((*iter)->output(0)->shape())
-            .Device("GPU")
-            .Finalize(&comm);
-          Node* comm_node = new SingleNode(comm, (*iter)->scope());
-          comm_node->AddInput((*iter)->output(0));
-          comm_node->AddOutput((*iter)->output(0));
-          critical_path.insert(++iter, comm_node);
-          continue;
+          producers.push_back(*iter);
         }
       }
     }else if ((*iter)->IsScopedNode()) {
@@ -77,15 +198,20 @@ void AddMPIOnPath(list<Node*>& critical_path) {
     }
     iter++;
   }
+  if (!producers.empty())
+    AddBucketsOnPath(critical_path, producers);
 }
 
+//the threaded workers(Communicator::RunThreaded) do not need MPI
 MPISession::MPISession(int opt) : SimpleSession(opt) {
   //type_ = (int)MPI;
-  MPI_Init(NULL, NULL);
+  if (!Communicator::Get()->IsThreaded())
+    MPI_Init(NULL, NULL);
 }
 
 MPISession::~MPISession() {
-  MPI_Finalize();
+  if (!Communicator::Get()->IsThreaded())
+    MPI_Finalize();
 }
 
 void MPISession::Compile(
@@ -1,8 +1,9 @@
 #include "cavs/midend/session_simple.h"
 #include "cavs/midend/allocator.h"
+#include "cavs/util/device.h"
 #include "cavs/util/logging.h"
-#include "cavs/util/macros_gpu.h"
 #include "cavs/util/op_def_builder.h"
+#include "cavs/proto/opt.pb.h"
 
 #include <iterator>
 
@@ -86,6 +87,20 @@ void SimpleSession::Compile(
   return;
 }
 
+void SimpleSession::PlanMemory(const vector<string>& output_names) {
+  vector<const Tensor*> fetched;
+  for (auto& name : output_names) {
+    const Edge* edge = s_->FindEdge(name);
+    if (!edge || edge->isVirtual())
+      continue;
+    const Tensor* t = GetTensor(edge->scoped_name());
+    if (t)
+      fetched.push_back(t);
+  }
+  memory_planner_.Plan(executors_[HashString(output_names)], fetched,
+                       opt_type() & OPT_INPLACE);
+}
+
 void SimpleSession::Run(const vector<string>& output_names,
     vector<Tensor>* output_tensors,
     const vector<string>& input_names,
@@ -93,18 +108,50 @@ void SimpleSession::Run(const vector<string>& output_names,
   VLOG(V_TIMING) << "Compiling for calculating the output ...";
   if (executors_.find(HashString(output_names)) == executors_.end()) {
     Compile(output_names);
+    //the planned tensors share memory in statement order,
+    //which the parallel executor does not keep
+    if ((opt_type() & OPT_MEMPLAN) && !(opt_type() & OPT_INTEROP))
+      PlanMemory(output_names);
   }
   VLOG(V_TIMING) << "Feeding inputs...";
   FeedInput(input_names, input_tensors);
   VLOG(V_TIMING) << "Executing...";
-  for (auto* exe : executors_[HashString(output_names)]) {
-    exe->Run();
+  //the collectives of MPI sessions must be issued in the same order
+  //on every rank, so only the simple session runs the DAG in parallel
+  if ((opt_type() & OPT_INTEROP) && session_type() == SIMPLE) {
+    const string& key = HashString(output_names);
+    if (parallel_executors_.find(key) == parallel_executors_.end())
+      parallel_executors_[key] = new ParallelExecutor(executors_[key]);
+    parallel_executors_[key]->Run();
+  }else {
+    for (auto* exe : executors_[HashString(output_names)]) {
+      exe->Run();
+    }
   }
   VLOG(V_TIMING) << "Fetching output..";
   FetchOutput(output_names, output_tensors);
   VLOG(V_TIMING) << "Execution completed";
   Statement::IncRound();
-  checkCudaError(cudaDeviceSynchronize());
+  TensorBufferPolicy::Get()->NextIteration();
+  DeviceContext::Synchronize();
+}
+
+void SimpleSession::PrefetchGraph(const string& input_name,
+    const Tensor& graph) {
+  const Edge* edge = s_->FindEdge(input_name);
+  CHECK(edge) << "Edge: " << input_name;
+  const Tensor* t = GetTensor(edge->scoped_name());
+  CHECK(t) << input_name << "\t" << debug_info();
+  set<GraphSchedulerBase*> visited;
+  for (auto& iter : executors_) {
+    for (auto* stmt : iter.second) {
+      GraphStatement* gstmt = dynamic_cast<GraphStatement*>(stmt);
+      if (gstmt && gstmt->graph_struct().buffer() == t->buffer() &&
+          visited.insert(gstmt->graph_scheduler()).second) {
+        gstmt->graph_scheduler()->Prefetch(graph);
+      }
+    }
+  }
 }
 
 void SimpleSession::FeedInput(const vector<string>& input_names,
@@ -4,6 +4,8 @@
 #include "cavs/midend/session_base.h"
 #include "cavs/midend/scope.h"
 #include "cavs/midend/statement.h"
+#include "cavs/midend/parallel_executor.h"
+#include "cavs/midend/memory_planner.h"
 
 #include <set>
 #include <list>
@@ -17,10 +19,15 @@ class SimpleSession : public SessionBase {
            std::vector<Tensor>* output_tensors,
            const std::vector<std::string>& input_names,
            const std::vector<Tensor>& input_tensors) override;
+  void PrefetchGraph(const std::string& input_name,
+                     const Tensor& graph) override;
   int session_type() const override { return SIMPLE; }
 
  protected:
   virtual void Compile(const std::vector<std::string>& output_names);
+  //shares the memory of the transient tensors(OPT_MEMPLAN),
+  //and of the dying inputs of elementwise operators(OPT_INPLACE)
+  void PlanMemory(const std::vector<std::string>& output_names);
   virtual void FeedInput(const std::vector<std::string>& input_names,
                  const std::vector<Tensor>& input_tensors);
   virtual void FetchOutput(const std::vector<std::string>& output_names,
@@ -30,6 +37,9 @@ class SimpleSession : public SessionBase {
                    std::set<Node*>* include);
   std::string HashString(const std::vector<std::string>& input);
   std::unordered_map<std::string, std::vector<Statement*>> executors_;
+  //built from executors_ when OPT_INTEROP is set
+  std::unordered_map<std::string, ParallelExecutor*> parallel_executors_;
+  MemoryPlanner memory_planner_;
 
  protected:
   const Scope* s_;
@@ -3,7 +3,7 @@
 
 namespace midend {
 
-int Statement::round_ = 0;
+thread_local int Statement::round_ = 0;
 
 void ExprStatement::Run() {
   CHECK(op_);
@@ -31,6 +31,11 @@ void ExprStatement::Run() {
   ctxt_->SetZero();
   VLOG(V_TIMING) << "Waiting for inputs--------------------";
   ctxt_->WaitForEvent();
+  if (!prepared_) {
+    VLOG(V_TIMING) << "Preparing-----------------------------";
+    op_->Prepare();
+    prepared_ = true;
+  }
   VLOG(V_TIMING) << "Computing-----------------------------";
   op_->Compute(ctxt_);
 
@@ -54,6 +59,8 @@ void GraphStatement::Run() {
   int output_length = gscheduler_->LoadGraph(global_ctxt_->Input(0));
   //LOG(INFO) << "Load graph done...";
   CHECK(output_length > 0);
+  //lets dynamic buffers reserve for the longest graph seen so far
+  TensorBufferPolicy::Get()->ObserveGraphLength(output_length);
   //we must clear the dynamic size in case previous ops have changed it;
   //The only case we have to reset the dynamic size is when the previous round sets
   //the dynamic size to a size larger than the gather output capacity,
@@ -66,11 +73,24 @@ void GraphStatement::Run() {
   int round = 0;
 
   Timing::TimingBegin("RNNForward");
+  if (!hoisted_.empty()) {
+    //the hoisted tensors are laid out in tensor id order,
+    //as the rounds would have written them
+    gscheduler_->PlanAhead();
+    gscheduler_->SetWholeGraphRound(true);
+    OpContext::SetDynDim(gscheduler_->GetJobId().size());
+    for (auto* stmt : hoisted_)
+      stmt->Run();
+    gscheduler_->SetWholeGraphRound(false);
+  }
   while (!gscheduler_->Terminate()) {
     //LOG(INFO) << "doing job_id: " << gscheduler_->GetJobId()[0];
     VLOG(V_DEBUG) << "round: " << round++
       << "\t job_counts:" << gscheduler_->GetJobId().size()
       << "\t job_id :" << gscheduler_->GetJobId()[0];
+    //the pulls setting the batch size of a round may have been hoisted
+    if (!hoisted_.empty())
+      OpContext::SetDynDim(gscheduler_->GetJobId().size());
     node_func_->Run();
     gscheduler_->ActivateNext();
   }
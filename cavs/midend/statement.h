@@ -4,8 +4,9 @@
 #include "cavs/midend/op_context.h"
 #include "cavs/midend/graph_scheduler.h"
 #include "cavs/backend/op_impl.h"
-#include "cavs/util/macros_gpu.h"
+#include "cavs/util/logging.h"
 
+#include <functional>
 #include <string>
 #include <vector>
 
@@ -19,35 +20,43 @@ class Statement {
   enum SType { EXPR = 0, BASICBLOCK = 1, FUNCCALL = 2 };
   virtual void Run() = 0;
   virtual SType type() const = 0;
+  //calls f on the context of every operator the statement runs
+  virtual void ForEachContext(const std::function<void(OpContext*)>& f) = 0;
   inline static void IncRound() { round_++; }
-
- protected:
+  //the iteration and the dynamic dimension belong to the thread running
+  //the session, the executors carry them over to their helper threads
   inline static int round() { return round_; }
+  inline static void SetRound(int r) { round_ = r; }
 
  private:
-  static int round_;
+  static thread_local int round_;
 };
 
 class ExprStatement : public Statement {
  public:
   ExprStatement(OpImpl* op, OpContext* ctxt)
-    : op_(op), ctxt_(ctxt)/*, custom_p_(NULL)*/ {}
+    : op_(op), ctxt_(ctxt), prepared_(false)/*, custom_p_(NULL)*/ {}
   ~ExprStatement() {
     if (op_) free(op_);
     if (ctxt_) free(ctxt_);
   }
   SType type() const override { return EXPR; }
-  inline void SetOp(OpImpl* op) { op_ = op; }
+  inline void SetOp(OpImpl* op) { op_ = op; prepared_ = false; }
   inline void SetContext(OpContext* ctxt) { ctxt_ = ctxt; }
   inline OpContext* GetContext() { return ctxt_; }
+  inline OpImpl* GetOp() { return op_; }
   inline std::string debug_info() { return op_->DebugInfo(0); }
+  void ForEachContext(const std::function<void(OpContext*)>& f) override {
+    if (ctxt_) f(ctxt_);
+  }
 
   void Run() override;
 
  protected:
-  ExprStatement() : op_(NULL), ctxt_(NULL) {}
+  ExprStatement() : op_(NULL), ctxt_(NULL), prepared_(false) {}
   OpImpl* op_;
   OpContext* ctxt_;
+  bool prepared_;
   //std::function<void(OpContext*)> custom_context_;
 };
 
@@ -76,6 +85,10 @@ class BasicBlock : public Statement {
     VLOG(V_TIMING) << "This Basic Block Ends";
   }
   SType type() const override { return BASICBLOCK; }
+  void ForEachContext(const std::function<void(OpContext*)>& f) override {
+    for (auto* stmt : stmts_)
+      stmt->ForEachContext(f);
+  }
 
   inline Statement* AppendStmt(Statement* stmt) {
     CHECK(stmt);
@@ -115,6 +128,11 @@ class FunctionCallStatement : public Statement {
     CHECK_NOTNULL(global_ctxt_);
   }
   SType type() const override { return FUNCCALL; }
+  void ForEachContext(const std::function<void(OpContext*)>& f) override {
+    if (push_arg_stmt_) push_arg_stmt_->ForEachContext(f);
+    if (pop_ret_stmt_)  pop_ret_stmt_->ForEachContext(f);
+    if (global_ctxt_)   f(global_ctxt_);
+  }
 
  protected:
   FunctionCallStatement()
@@ -131,10 +149,27 @@ class GraphStatement : public FunctionCallStatement {
   GraphStatement(Statement* node_func, GraphSchedulerBase* gs)
     : node_func_(node_func), gscheduler_(gs) {}
   void Run() override;
+  inline GraphSchedulerBase* graph_scheduler() const { return gscheduler_; }
+  //the round-invariant part of the node function,
+  //run once over all the vertices before the rounds
+  inline void SetHoistedStatements(std::vector<Statement*>&& hoisted) {
+    hoisted_ = std::move(hoisted);
+  }
+  inline const Tensor& graph_struct() const {
+    CHECK_NOTNULL(global_ctxt_);
+    return global_ctxt_->Input(0);
+  }
+  void ForEachContext(const std::function<void(OpContext*)>& f) override {
+    FunctionCallStatement::ForEachContext(f);
+    node_func_->ForEachContext(f);
+    for (auto* stmt : hoisted_)
+      stmt->ForEachContext(f);
+  }
 
  protected:
   Statement* node_func_;
   GraphSchedulerBase* gscheduler_;
+  std::vector<Statement*> hoisted_;
 };
 
 class GraphGradStatement : public GraphStatement {
@@ -145,6 +180,11 @@ class GraphGradStatement : public GraphStatement {
   inline void SetBatchWeightUpdate(std::vector<Statement*>&& wu) {
     batch_weight_updates_ = std::move(wu);
   }
+  void ForEachContext(const std::function<void(OpContext*)>& f) override {
+    GraphStatement::ForEachContext(f);
+    for (auto* stmt : batch_weight_updates_)
+      stmt->ForEachContext(f);
+  }
 
  private:
   std::vector<Statement*> batch_weight_updates_;
@@ -1,9 +1,11 @@
 #include "cavs/midend/tensor.h"
 #include "cavs/util/types.h"
 #include "cavs/util/logging.h"
-#include "cavs/util/macros_gpu.h"
+#include "cavs/util/device.h"
 
+#include <stdlib.h>
 #include <iomanip>
+#include <algorithm>
 
 using std::string;
 using std::vector;
@@ -30,32 +32,183 @@ namespace midend {
 template <typename T>
 class TensorBuffer : public TensorBufferBase {
  public:
-  TensorBuffer(Allocator* alloc, size_t elem) 
-      : TensorBufferBase(alloc), data_(NULL), elem_(elem) {
+  //only elastic buffers, whose size follows the dynamic dimension, may shrink;
+  //the others are addressed by offsets beyond the visible shape
+  TensorBuffer(Allocator* alloc, size_t elem, bool elastic = false) 
+      : TensorBufferBase(alloc), data_(NULL), elem_(elem), capacity_(elem),
+        peak_(elem), window_peak_(elem), idle_iterations_(0),
+        iteration_(TensorBufferPolicy::Get()->iteration()), elastic_(elastic),
+        aliased_(false) {
     if (elem_ > 0)
       data_ = alloc->Allocate<T>(elem_);   
   }
-  ~TensorBuffer() override { alloc_->Deallocate<T>(data_); }
+  ~TensorBuffer() override { if (!aliased_) alloc_->Deallocate<T>(data_); }
   FORCE_INLINE void* data() const override  { return data_; }
   FORCE_INLINE size_t size() const override { return elem_*sizeof(T); }
+  FORCE_INLINE size_t capacity() const override { return capacity_*sizeof(T); }
   FORCE_INLINE void InitWithZero() override {
     alloc_->InitWithZero(data(), size());
   }
-  FORCE_INLINE void Resize(size_t size) override {
+  void Resize(size_t size, size_t reserve) override {
+    CHECK(!aliased_);
     CHECK(size % sizeof(T) == 0);
     CHECK(size != elem_*sizeof(T));
+    TensorBufferPolicy* policy = TensorBufferPolicy::Get();
+    size_t elem = size/sizeof(T);
+    Track(elem);
+    if (elem <= capacity_) {
+      elem_ = elem;
+      policy->CountAvoidedResize();
+      return;
+    }
+    size_t capacity = policy->GrowCapacity(elem, capacity_, reserve/sizeof(T));
     if (data_) { alloc_->Deallocate<T>(data_); }
-    data_ = alloc_->Allocate<T>(size/sizeof(T));   
-    elem_ = size/sizeof(T);
+    data_ = alloc_->Allocate<T>(capacity);   
+    elem_ = elem;
+    capacity_ = capacity;
+    policy->CountResize();
+  }
+  void Touch(size_t size) override {
+    CHECK(size <= elem_*sizeof(T));
+    if (aliased_) return;
+    Track(size/sizeof(T));
+    TensorBufferPolicy* policy = TensorBufferPolicy::Get();
+    if (!elastic_ || policy->shrink_iterations() <= 0 ||
+        idle_iterations_ < policy->shrink_iterations())
+      return;
+    //whatever has been touched in this iteration is kept,
+    //the contents left from previous iterations are dropped
+    size_t elem = peak_;
+    size_t capacity = std::max(policy->ShrinkCapacity(std::max(window_peak_, elem)), elem);
+    if (capacity >= capacity_) {
+      idle_iterations_ = 0;
+      return;
+    }
+    T* data = (capacity > 0) ? alloc_->Allocate<T>(capacity) : NULL;
+    if (elem > 0) {
+      DeviceContext::Memcpy(data, device_type(), data_, device_type(),
+                            elem*sizeof(T));
+    }
+    alloc_->Deallocate<T>(data_);
+    VLOG(V_DEBUG) << "Shrinking buffer from " << capacity_*sizeof(T)
+                  << " to " << capacity*sizeof(T) << " Bytes";
+    data_ = data;
+    elem_ = elem;
+    capacity_ = capacity;
+    idle_iterations_ = 0;
+    window_peak_ = elem;
+    policy->CountShrink();
+  }
+  FORCE_INLINE bool IsAliased() const override { return aliased_; }
+  void Alias(void* data) override {
+    if (data) {
+      if (!aliased_ && data_)
+        alloc_->Deallocate<T>(data_);
+      data_ = reinterpret_cast<T*>(data);
+      aliased_ = true;
+    }else if (aliased_) {
+      data_ = (capacity_ > 0) ? alloc_->Allocate<T>(capacity_) : NULL;
+      aliased_ = false;
+    }
   }
 
  private:
+  //peak_ is the usage of the current iteration,
+  //window_peak_ the usage over the idle iterations so far
+  FORCE_INLINE void Track(size_t elem) {
+    TensorBufferPolicy* policy = TensorBufferPolicy::Get();
+    int iteration = policy->iteration();
+    if (iteration != iteration_) {
+      if (policy->IsIdle(peak_, capacity_)) {
+        idle_iterations_++;
+        window_peak_ = std::max(window_peak_, peak_);
+      }else {
+        idle_iterations_ = 0;
+        window_peak_ = 0;
+      }
+      peak_ = 0;
+      iteration_ = iteration;
+    }
+    peak_ = std::max(peak_, elem);
+  }
+
   T* data_;
-  int elem_;
+  size_t elem_;
+  size_t capacity_;
+  size_t peak_;
+  size_t window_peak_;
+  int idle_iterations_;
+  int iteration_;
+  bool elastic_;
+  //data_ points at external memory
+  bool aliased_;
 
   DISALLOW_COPY_AND_ASSIGN(TensorBuffer);
 };
 
+namespace {
+float EnvOrDefault(const char* name, float default_value) {
+  const char* env = getenv(name);
+  return env ? atof(env) : default_value;
+}
+} //namespace
+
+TensorBufferPolicy::TensorBufferPolicy()
+    : iteration_(0), max_graph_length_(0),
+      resizes_(0), avoided_resizes_(0), shrinks_(0),
+      last_resizes_(0), last_avoided_resizes_(0) {
+  growth_ = std::max(1.f, EnvOrDefault("CAVS_BUFFER_GROWTH", 1.5f));
+  prereserve_ = EnvOrDefault("CAVS_BUFFER_PRERESERVE", 0) != 0;
+  shrink_ratio_ = std::max(1.f, EnvOrDefault("CAVS_BUFFER_SHRINK_RATIO", 4.f));
+  shrink_iterations_ = EnvOrDefault("CAVS_BUFFER_SHRINK_ITERS", 16);
+}
+
+size_t TensorBufferPolicy::GrowCapacity(size_t required,
+    size_t capacity, size_t reserve) const {
+  size_t grown = capacity*growth_;
+  return std::max(required, std::max(grown, reserve));
+}
+
+size_t TensorBufferPolicy::ShrinkCapacity(size_t peak) const {
+  return peak*growth_;
+}
+
+bool TensorBufferPolicy::IsIdle(size_t peak, size_t capacity) const {
+  return capacity > 0 && capacity > peak*shrink_ratio_;
+}
+
+void TensorBufferPolicy::ObserveGraphLength(int total_length) {
+  int prev = max_graph_length_;
+  while (total_length > prev &&
+         !max_graph_length_.compare_exchange_weak(prev, total_length)) {}
+}
+
+void TensorBufferPolicy::NextIteration() {
+  size_t resizes = resizes_;
+  size_t avoided = avoided_resizes_;
+  VLOG(V_TIMING) << "[TensorBufferPolicy] iteration " << iteration_
+                 << "\tresizes: " << resizes - last_resizes_
+                 << "\tavoided: " << avoided - last_avoided_resizes_;
+  last_resizes_ = resizes;
+  last_avoided_resizes_ = avoided;
+  iteration_++;
+}
+
+TensorBufferPolicy::Stats TensorBufferPolicy::GetStats(bool reset) {
+  Stats stats;
+  stats.resizes = resizes_;
+  stats.avoided_resizes = avoided_resizes_;
+  stats.shrinks = shrinks_;
+  if (reset) {
+    resizes_ = 0;
+    avoided_resizes_ = 0;
+    shrinks_ = 0;
+    last_resizes_ = 0;
+    last_avoided_resizes_ = 0;
+  }
+  return stats;
+}
+
 string TensorShape::debug_info() const {
   string ret; 
   for (auto& s : shape_)
@@ -75,13 +228,8 @@ template <>
 void Tensor::DebugNumerical<float>() const {
   if (VLOG_IS_ON(V_EXHAUSTIVE_DEBUG)) {
     vector<float> res(count());
-    if (device_type() == GPU) {
-      checkCudaError(cudaMemcpy(res.data(), data<float>(),
-            count()*sizeof(float), cudaMemcpyDeviceToHost));
-    }else {
-      checkCudaError(cudaMemcpy(res.data(), data<float>(),
-            count()*sizeof(float), cudaMemcpyHostToHost));
-    }
+    DeviceContext::Memcpy(res.data(), CPU, data<float>(), device_type(),
+                          count()*sizeof(float));
     VLOG(V_EXHAUSTIVE_DEBUG) << debug_info();
     float L2_norm = 0;
     float checksum = 0;
@@ -123,7 +271,7 @@ Tensor::Tensor(const string& name, Allocator *a,
   if (shape.dim(0) == -1) {
     params_->dynamic = true;
     shape_ = shape;
-    CASES(params_->type, buf_.reset(new TensorBuffer<T>(a, 0)));
+    CASES(params_->type, buf_.reset(new TensorBuffer<T>(a, 0, true)));
   }else {
     CHECK(shape.n_elements() > 0);
     Rebase(a, params_->type, shape);
@@ -139,7 +287,7 @@ Tensor::Tensor(const string& name, Allocator *a,
   if (shape.dim(0) == -1) {
     params_->dynamic = true;
     shape_ = std::move(shape);
-    CASES(params_->type, buf_.reset(new TensorBuffer<T>(a, 0)));
+    CASES(params_->type, buf_.reset(new TensorBuffer<T>(a, 0, true)));
   }else {
     CHECK(shape.n_elements() > 0);
     Rebase(a, params_->type, std::move(shape));
@@ -263,18 +411,32 @@ void Tensor::ScaleDynamicDimension(int new_dim) {
   shape_.SetDim(0, new_dim);   
   size_t new_size = shape_.n_elements();
   CASES(params_->type, new_size *= sizeof(T));
+  CHECK_NOTNULL(buf_.get());
   if (old_dim < new_dim && buf_->size() < new_size) {
-    CHECK_NOTNULL(buf_.get());
     //VLOG(V_DEBUG) << "Resizing " << new_size << " Bytes";
-    buf_->Resize(new_size);
+    size_t reserve = (size_t)TensorBufferPolicy::Get()->ReservedRows()*new_size/new_dim;
+    buf_->Resize(new_size, reserve);
+  }else if (buf_->size() >= new_size) {
+    buf_->Touch(new_size);
   }
 }
 
+void Tensor::AliasExternal(const void* data) {
+  CHECK_NOTNULL(buf_.get());
+  CHECK(params_->offset == 0);
+  buf_->Alias(const_cast<void*>(data));
+}
+
 void Tensor::SetZeroInitEnforced() {
   CHECK_NOTNULL(params_.get());
   params_->zero_init_enforced = true;
 }
 
+void Tensor::UnsetZeroInitEnforced() {
+  CHECK_NOTNULL(params_.get());
+  params_->zero_init_enforced = false;
+}
+
 bool Tensor::ZeroInitEnforced() const {
   CHECK_NOTNULL(params_.get());
   return params_->zero_init_enforced;
@@ -329,25 +491,8 @@ void Tensor::SyncWith(const Tensor& t) {
   CHECK_NOTNULL(params_.get());
   CASES(params_->type, size*= sizeof(T));
   CHECK(size <= t.buf_->size());
-  //cudaMemcpyDefault can remove such a complexity
-  //but for development, specified it clearly is better.
-  if (t.device_type() == CPU && device_type() == GPU) {
-    //checkCudaError(cudaMemcpy(buf_->data(), t.buf_->data(), 
-                   //t.buf_->size(), cudaMemcpyHostToDevice));
-    checkCudaError(cudaMemcpy(buf_->data(), t.buf_->data(), 
-                   size, cudaMemcpyHostToDevice));
-  }else if (t.device_type() == GPU && device_type() == CPU) {
-    checkCudaError(cudaMemcpy(buf_->data(), t.buf_->data(), 
-                   size, cudaMemcpyDeviceToHost));
-  }else if (t.device_type() == CPU && device_type() == CPU) {
-    checkCudaError(cudaMemcpy(buf_->data(), t.buf_->data(), 
-                   size, cudaMemcpyHostToHost));
-  }else if (t.device_type() == GPU && device_type() == GPU) {
-    checkCudaError(cudaMemcpy(buf_->data(), t.buf_->data(), 
-                   size, cudaMemcpyDeviceToDevice));
-  }else{
-    LOG(FATAL) << "which device on earth?";
-  }
+  DeviceContext::Memcpy(buf_->data(), device_type(),
+                        t.buf_->data(), t.device_type(), size);
 }
 
 } //namespace midend
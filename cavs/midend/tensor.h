@@ -10,20 +10,84 @@
 #include <vector>
 #include <string>
 #include <memory>
+#include <atomic>
 
 
 namespace midend {
 
+//capacity policy shared by the buffers of dynamic tensors.
+//the batch dimension of a dynamic tensor changes from graph to graph,
+//so buffers grow geometrically (optionally up to the largest graph seen so far)
+//and are only shrunk after having been oversized for several iterations.
+//  CAVS_BUFFER_GROWTH:         growth factor, 1 restores exact-fit resizing
+//  CAVS_BUFFER_PRERESERVE:     reserve rows for the longest graph seen so far
+//  CAVS_BUFFER_SHRINK_RATIO:   a buffer is idle if capacity > ratio*peak usage
+//  CAVS_BUFFER_SHRINK_ITERS:   idle iterations before shrinking, 0 disables it
+class TensorBufferPolicy {
+ public:
+  struct Stats {
+    size_t resizes;
+    size_t avoided_resizes;
+    size_t shrinks;
+  };
+  static TensorBufferPolicy* Get() {
+    static TensorBufferPolicy policy;
+    return &policy;
+  }
+  size_t GrowCapacity(size_t required, size_t capacity, size_t reserve) const;
+  size_t ShrinkCapacity(size_t peak) const;
+  bool IsIdle(size_t peak, size_t capacity) const;
+  inline int shrink_iterations() const { return shrink_iterations_; }
+  inline int iteration() const { return iteration_; }
+  //called once per graph with GraphSchedulerBase::total_length()
+  void ObserveGraphLength(int total_length);
+  inline int ReservedRows() const { return prereserve_ ? max_graph_length_.load() : 0; }
+  void NextIteration();
+  Stats GetStats(bool reset);
+
+  inline void CountResize()        { resizes_++;         }
+  inline void CountAvoidedResize() { avoided_resizes_++; }
+  inline void CountShrink()        { shrinks_++;         }
+
+ private:
+  TensorBufferPolicy();
+  float growth_;
+  bool prereserve_;
+  float shrink_ratio_;
+  int shrink_iterations_;
+  std::atomic<int> iteration_;
+  std::atomic<int> max_graph_length_;
+  std::atomic<size_t> resizes_;
+  std::atomic<size_t> avoided_resizes_;
+  std::atomic<size_t> shrinks_;
+  //counters of the current iteration, for logging
+  size_t last_resizes_;
+  size_t last_avoided_resizes_;
+};
+
 //data
 class TensorBufferBase {
  public:
   TensorBufferBase(Allocator* alloc) : alloc_(alloc) {}
   FORCE_INLINE DeviceType device_type() const { return alloc_->type(); }
+  FORCE_INLINE Allocator* allocator() const { return alloc_; }
   virtual ~TensorBufferBase() {}
   virtual void* data()  const = 0;
   virtual size_t size() const = 0;
+  virtual size_t capacity() const = 0;
   virtual void InitWithZero() = 0;
-  virtual void Resize(size_t size) = 0;
+  //the contents are not preserved unless the capacity suffices
+  virtual void Resize(size_t size, size_t reserve) = 0;
+  FORCE_INLINE void Resize(size_t size) { Resize(size, 0); }
+  //records the bytes in use, the buffer may shrink (preserving them)
+  //when it has been oversized for several iterations
+  virtual void Touch(size_t size) = 0;
+  //points the buffer at memory owned by someone else(a file mapping,
+  //an arena of the memory planner), which must stay valid while it is in use,
+  //and releases its own. NULL gives the buffer memory of its own again,
+  //the contents are lost. An aliased buffer can not be resized.
+  virtual void Alias(void* data) = 0;
+  virtual bool IsAliased() const = 0;
 
  protected:
   Allocator* const alloc_;
@@ -80,6 +144,8 @@ class Tensor {
   inline int dims()          const { return shape_.dim();        }
   inline int dims(int idx)   const { return shape_.dim(idx);     }
   inline size_t debug_size() const { return buf_->size();        }
+  //tensors sharing memory return the same buffer
+  inline const TensorBufferBase* buffer() const { return buf_.get(); }
 
   //allocate a new buffer
   void Rebase(Allocator *a, DataType type, const TensorShape& shape);
@@ -92,6 +158,10 @@ class Tensor {
   //void Resize(const TensorShapeDef& shape);
   void Resize(const TensorShape& shape);
   void ScaleDynamicDimension(int new_dim);
+  //the buffer, and therefore all tensors sharing it, use external memory
+  //on the device of the tensor
+  void AliasExternal(const void* data);
+  inline bool IsAliased() const { return buf_->IsAliased(); }
   template <typename T>
     T* mutable_data() const {
       return reinterpret_cast<T*>((char*)(buf_->data()) + params_->offset); 
@@ -102,6 +172,8 @@ class Tensor {
   }
 
   void SetZeroInitEnforced();
+  //for buffers whose zeroing is taken over by the operator
+  void UnsetZeroInitEnforced();
   bool ZeroInitEnforced() const;
   bool InitWithZero(int iteration);
   void SetOffsetWithId(int id);
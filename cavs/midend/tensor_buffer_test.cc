@@ -0,0 +1,93 @@
+#include "cavs/midend/tensor.h"
+#include "cavs/midend/allocator.h"
+#include "cavs/midend/tensor_test.h"
+#include "cavs/util/logging.h"
+#include "cavs/util/op_util.h"
+
+#include <stdlib.h>
+
+using namespace midend;
+using namespace midend::test;
+
+const int kWidth = 4;
+const size_t kRowBytes = kWidth*sizeof(float);
+
+//an elastic tensor, whose first dimension follows the graph
+Tensor ElasticTensor(const string& name) {
+  return Tensor(name, GetAllocator(DeviceTypeToString(CPU)), DT_FLOAT,
+                TensorShape(vector<int>{-1, kWidth}));
+}
+
+//the capacity grows by the growth factor, so the rows that come
+//within it are taken without reallocating
+void TestGrowth() {
+  TensorBufferPolicy* policy = TensorBufferPolicy::Get();
+  policy->GetStats(true);
+  Tensor t = ElasticTensor("grow");
+  t.ScaleDynamicDimension(10);
+  CHECK(t.buffer()->capacity() == 10*kRowBytes);
+  t.ScaleDynamicDimension(1);
+  //11 rows outgrow the capacity, which doubles
+  t.ScaleDynamicDimension(11);
+  CHECK(t.buffer()->capacity() == 20*kRowBytes) << t.buffer()->capacity();
+  const void* data = t.buffer()->data();
+  t.ScaleDynamicDimension(1);
+  t.ScaleDynamicDimension(20);
+  CHECK(t.buffer()->data() == data);
+  CHECK(t.buffer()->capacity() == 20*kRowBytes);
+  TensorBufferPolicy::Stats stats = policy->GetStats(true);
+  CHECK(stats.resizes == 2 && stats.avoided_resizes == 1)
+    << stats.resizes << "\t" << stats.avoided_resizes;
+  LOG(INFO) << "Geometric growth passed";
+}
+
+//a buffer oversized by more than the shrink ratio for the idle iterations
+//shrinks to the growth factor times its peak, keeping the touched rows
+void TestShrink() {
+  TensorBufferPolicy* policy = TensorBufferPolicy::Get();
+  policy->GetStats(true);
+  Tensor t = ElasticTensor("shrink");
+  t.ScaleDynamicDimension(40);
+  CHECK(t.buffer()->capacity() == 40*kRowBytes);
+  policy->NextIteration();
+
+  vector<float> vals(2*kWidth);
+  for (size_t i = 0; i < vals.size(); i++)
+    vals[i] = i;
+  //iteration 1 counts as idle once iteration 2 begins,
+  //the buffer shrinks when iteration 3 finds two idle ones
+  for (int iter = 1; iter <= 3; iter++) {
+    t.ScaleDynamicDimension(2);
+    if (iter < 3) {
+      CHECK(t.buffer()->capacity() == 40*kRowBytes) << iter;
+      FillValues<float>(&t, vals);
+    }
+    policy->NextIteration();
+  }
+  CHECK(t.buffer()->capacity() == 4*kRowBytes) << t.buffer()->capacity();
+  vector<float> kept;
+  FetchValues<float>(&kept, t);
+  CHECK(kept == vals);
+  CHECK(policy->GetStats(true).shrinks == 1);
+
+  //a buffer in use is never shrunk
+  Tensor busy = ElasticTensor("busy");
+  for (int iter = 0; iter < 4; iter++) {
+    busy.ScaleDynamicDimension(40);
+    busy.ScaleDynamicDimension(2);
+    policy->NextIteration();
+  }
+  CHECK(busy.buffer()->capacity() == 40*kRowBytes);
+  CHECK(policy->GetStats(true).shrinks == 0);
+  LOG(INFO) << "Idle shrinking passed";
+}
+
+int main() {
+  //the policy reads them when it is first used
+  setenv("CAVS_BUFFER_GROWTH", "2", 1);
+  setenv("CAVS_BUFFER_SHRINK_RATIO", "4", 1);
+  setenv("CAVS_BUFFER_SHRINK_ITERS", "2", 1);
+  TestGrowth();
+  TestShrink();
+  return 0;
+}
@@ -2,7 +2,8 @@
 #define CAVS_MIDEND_TENSOR_TEST_H_
 
 #include "cavs/midend/tensor.h"
-#include "cavs/util/macros_gpu.h"
+#include "cavs/util/device.h"
+#include "cavs/util/logging.h"
 
 using namespace std;
 
@@ -10,13 +11,13 @@ namespace midend {
 
 namespace test {
 
-//Just implement the GPU routines up to now
 template <typename T>
 void FillValues(Tensor* tensor, const vector<T>& vals) {
   CHECK_NOTNULL(tensor);
   T* buf = tensor->mutable_data<T>();
   CHECK(tensor->count() == vals.size());
-  checkCudaError(cudaMemcpy(buf, vals.data(), vals.size()*sizeof(T), cudaMemcpyHostToDevice));
+  DeviceContext::Memcpy(buf, tensor->device_type(), vals.data(), CPU,
+                        vals.size()*sizeof(T));
 }
 
 template <typename T>
@@ -24,7 +25,8 @@ void FetchValues(vector<T>* vals, const Tensor& tensor) {
   const T* buf = tensor.data<T>();
   CHECK_NOTNULL(buf);
   vals->resize(tensor.count());
-  checkCudaError(cudaMemcpy(vals->data(), buf, vals->size()*sizeof(T), cudaMemcpyDeviceToHost));
+  DeviceContext::Memcpy(vals->data(), CPU, buf, tensor.device_type(),
+                        vals->size()*sizeof(T));
 }
 
 } //namespace test
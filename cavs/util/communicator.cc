@@ -0,0 +1,311 @@
+#include "cavs/util/communicator.h"
+#include "cavs/util/mpi_types.h"
+#include "cavs/util/logging.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+#include <string>
+
+using std::string;
+using std::vector;
+
+namespace {
+
+size_t SizeOf(DataType type) {
+  switch (type) {
+    case DT_FLOAT:  return sizeof(float);
+    case DT_DOUBLE: return sizeof(double);
+    case DT_INT32:  return sizeof(int);
+    default: LOG(FATAL) << "Unsupported type " << type;
+  }
+  return 0;
+}
+
+MPI_Datatype ToMPIType(DataType type) {
+  switch (type) {
+    case DT_FLOAT:  return MPI_FLOAT;
+    case DT_DOUBLE: return MPI_DOUBLE;
+    case DT_INT32:  return MPI_INT;
+    default: LOG(FATAL) << "Unsupported type " << type;
+  }
+  return MPI_DATATYPE_NULL;
+}
+
+class MPICommunicator : public Communicator {
+ public:
+  bool IsThreaded() const override { return false; }
+  int rank() const override {
+    int rank = 0;
+    checkMPIError(MPI_Comm_rank(MPI_COMM_WORLD, &rank));
+    return rank;
+  }
+  int size() const override {
+    int size = 1;
+    checkMPIError(MPI_Comm_size(MPI_COMM_WORLD, &size));
+    return size;
+  }
+  void AllReduce(const void* sendbuf, void* recvbuf,
+      int count, DataType type) override {
+    checkMPIError(MPI_Allreduce((sendbuf == recvbuf) ? MPI_IN_PLACE : sendbuf,
+          recvbuf, count, ToMPIType(type), MPI_SUM, MPI_COMM_WORLD));
+  }
+  void IAllReduce(void* buf, int count, DataType type,
+      CommRequest* request) override {
+    checkMPIError(MPI_Iallreduce(MPI_IN_PLACE, buf, count, ToMPIType(type),
+          MPI_SUM, MPI_COMM_WORLD, &request->mpi));
+  }
+  void Wait(CommRequest* request) override {
+    checkMPIError(MPI_Wait(&request->mpi, MPI_STATUS_IGNORE));
+  }
+  void Bcast(void* buf, int count, DataType type, int root) override {
+    checkMPIError(MPI_Bcast(buf, count, ToMPIType(type), root, MPI_COMM_WORLD));
+  }
+  void AllGather(const void* sendbuf, int sendcount,
+      void* recvbuf, int recvcount, DataType type) override {
+    checkMPIError(MPI_Allgather(sendbuf, sendcount, ToMPIType(type),
+          recvbuf, recvcount, ToMPIType(type), MPI_COMM_WORLD));
+  }
+};
+
+//"0-3,8-11" => {0, 1, 2, 3, 8, 9, 10, 11}
+vector<int> ParseList(const string& list) {
+  vector<int> ret;
+  std::stringstream ss(list);
+  string range;
+  while (std::getline(ss, range, ',')) {
+    if (range.empty() || !isdigit(range[0])) continue;
+    size_t dash = range.find('-');
+    int lo = atoi(range.c_str());
+    int hi = (dash == string::npos) ? lo : atoi(range.c_str()+dash+1);
+    for (int i = lo; i <= hi; i++)
+      ret.push_back(i);
+  }
+  return ret;
+}
+
+vector<int> ReadList(const string& path) {
+  std::ifstream f(path);
+  string line;
+  if (!f || !std::getline(f, line))
+    return vector<int>();
+  return ParseList(line);
+}
+
+//The workers are spread over the NUMA nodes in contiguous blocks
+//and pinned to the cpus of their node.
+//A reduction first sums up the workers of each node into a buffer
+//first-touched on that node, then sums up the nodes, so that only
+//one buffer per node crosses the interconnect instead of one per worker.
+//CAVS_COMM_NUMA=0 treats the machine as a single node.
+struct ThreadGroup {
+  explicit ThreadGroup(int n) : size(n), arrived(0), generation(0) {
+    vector<int> nodes;
+    const char* env = getenv("CAVS_COMM_NUMA");
+    if (!env || atoi(env) != 0)
+      nodes = ReadList("/sys/devices/system/node/online");
+    for (int node : nodes) {
+      vector<int> cpus = ReadList("/sys/devices/system/node/node"
+                                  + std::to_string(node) + "/cpulist");
+      if (!cpus.empty())
+        node_cpus.push_back(cpus);
+    }
+    if ((int)node_cpus.size() > size)
+      node_cpus.resize(size);
+    if (node_cpus.size() < 2)
+      node_cpus.clear();
+    const int num_nodes = std::max<int>(1, node_cpus.size());
+    members.resize(num_nodes);
+    for (int r = 0; r < size; r++) {
+      node_of_rank.push_back(r*num_nodes/size);
+      members[node_of_rank.back()].push_back(r);
+    }
+    slots.resize(size, NULL);
+    node_sums.resize(num_nodes);
+    VLOG(V_DEBUG) << "Threaded communicator with " << size
+                  << " workers on " << num_nodes << " nodes";
+  }
+
+  //the last one to arrive releases the others
+  void Barrier() {
+    std::unique_lock<std::mutex> lock(mu);
+    const long gen = generation;
+    if (++arrived == size) {
+      arrived = 0;
+      generation++;
+      cv.notify_all();
+    }else {
+      cv.wait(lock, [this, gen]{ return generation != gen; });
+    }
+  }
+
+  const int size;
+  vector<int> node_of_rank;
+  vector<vector<int>> members;
+  vector<vector<int>> node_cpus;
+  vector<const void*> slots;
+  vector<vector<char>> node_sums;
+  vector<char> result;
+
+  std::mutex mu;
+  std::condition_variable cv;
+  int arrived;
+  long generation;
+};
+
+template <typename T>
+void SumRange(char* dst, const vector<const char*>& srcs, size_t begin, size_t end) {
+  T* d = reinterpret_cast<T*>(dst);
+  const T* s0 = reinterpret_cast<const T*>(srcs[0]);
+  for (size_t i = begin; i < end; i++)
+    d[i] = s0[i];
+  for (size_t k = 1; k < srcs.size(); k++) {
+    const T* s = reinterpret_cast<const T*>(srcs[k]);
+    for (size_t i = begin; i < end; i++)
+      d[i] += s[i];
+  }
+}
+
+void Sum(DataType type, char* dst, const vector<const char*>& srcs,
+    size_t begin, size_t end) {
+  if (begin >= end) return;
+  switch (type) {
+    case DT_FLOAT:  SumRange<float >(dst, srcs, begin, end); break;
+    case DT_DOUBLE: SumRange<double>(dst, srcs, begin, end); break;
+    case DT_INT32:  SumRange<int   >(dst, srcs, begin, end); break;
+    default: LOG(FATAL) << "Unsupported type " << type;
+  }
+}
+
+//the idx-th of n even chunks of [0, count)
+inline size_t ChunkBegin(size_t count, int idx, int n) {
+  return count*idx/n;
+}
+
+class ThreadCommunicator : public Communicator {
+ public:
+  ThreadCommunicator(ThreadGroup* group, int rank)
+    : group_(group), rank_(rank), node_(group->node_of_rank[rank]) {}
+  bool IsThreaded() const override { return true; }
+  int rank() const override { return rank_; }
+  int size() const override { return group_->size; }
+
+  void AllReduce(const void* sendbuf, void* recvbuf,
+      int count, DataType type) override;
+  void IAllReduce(void* buf, int count, DataType type,
+      CommRequest*) override {
+    AllReduce(buf, buf, count, type);
+  }
+  void Wait(CommRequest*) override {}
+  void Bcast(void* buf, int count, DataType type, int root) override;
+  void AllGather(const void* sendbuf, int sendcount,
+      void* recvbuf, int recvcount, DataType type) override;
+
+ private:
+  ThreadGroup* group_;
+  const int rank_;
+  const int node_;
+};
+
+//every step ends with a barrier, the last one keeps the shared buffers
+//from being resized while others are still copying out of them
+void ThreadCommunicator::AllReduce(const void* sendbuf, void* recvbuf,
+    int count, DataType type) {
+  ThreadGroup* g = group_;
+  const size_t esize = SizeOf(type);
+  const size_t bytes = count*esize;
+  const vector<int>& members = g->members[node_];
+  const int idx = std::find(members.begin(), members.end(), rank_) - members.begin();
+  const bool multi_node = g->members.size() > 1;
+
+  g->slots[rank_] = sendbuf;
+  if (idx == 0 && multi_node && g->node_sums[node_].size() < bytes)
+    g->node_sums[node_].resize(bytes);
+  if (rank_ == 0 && g->result.size() < bytes)
+    g->result.resize(bytes);
+  g->Barrier();
+
+  //the workers of a node split the node sum among themselves
+  char* node_sum = multi_node ? g->node_sums[node_].data() : g->result.data();
+  vector<const char*> srcs;
+  for (int r : members)
+    srcs.push_back(static_cast<const char*>(g->slots[r]));
+  Sum(type, node_sum, srcs,
+      ChunkBegin(count, idx, members.size()), ChunkBegin(count, idx+1, members.size()));
+  g->Barrier();
+
+  if (multi_node) {
+    srcs.clear();
+    for (auto& s : g->node_sums)
+      srcs.push_back(s.data());
+    Sum(type, g->result.data(), srcs,
+        ChunkBegin(count, rank_, g->size), ChunkBegin(count, rank_+1, g->size));
+    g->Barrier();
+  }
+
+  memcpy(recvbuf, g->result.data(), bytes);
+  g->Barrier();
+}
+
+void ThreadCommunicator::Bcast(void* buf, int count, DataType type, int root) {
+  group_->slots[rank_] = buf;
+  group_->Barrier();
+  if (rank_ != root)
+    memcpy(buf, group_->slots[root], count*SizeOf(type));
+  group_->Barrier();
+}
+
+void ThreadCommunicator::AllGather(const void* sendbuf, int sendcount,
+    void* recvbuf, int recvcount, DataType type) {
+  CHECK(sendcount <= recvcount);
+  const size_t esize = SizeOf(type);
+  group_->slots[rank_] = sendbuf;
+  group_->Barrier();
+  for (int r = 0; r < group_->size; r++) {
+    char* dst = static_cast<char*>(recvbuf) + r*recvcount*esize;
+    if (dst != group_->slots[r])
+      memcpy(dst, group_->slots[r], sendcount*esize);
+  }
+  group_->Barrier();
+}
+
+thread_local Communicator* tls_comm = NULL;
+
+} //namespace
+
+Communicator* Communicator::Get() {
+  static MPICommunicator mpi;
+  return tls_comm ? tls_comm : &mpi;
+}
+
+void Communicator::RunThreaded(int size, const std::function<void(int)>& worker) {
+  CHECK(size > 0);
+  ThreadGroup group(size);
+  vector<std::thread> threads;
+  for (int r = 0; r < size; r++) {
+    threads.emplace_back([&group, &worker, r]() {
+      if (!group.node_cpus.empty()) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : group.node_cpus[group.node_of_rank[r]])
+          CPU_SET(cpu, &set);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+          LOG(WARNING) << "Failed to pin worker " << r;
+      }
+      ThreadCommunicator comm(&group, r);
+      tls_comm = &comm;
+      worker(r);
+      tls_comm = NULL;
+    });
+  }
+  for (auto& t : threads)
+    t.join();
+}
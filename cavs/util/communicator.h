@@ -0,0 +1,43 @@
+#ifndef CAVS_UTIL_COMMUNICATOR_H_
+#define CAVS_UTIL_COMMUNICATOR_H_
+
+#include "cavs/proto/types.pb.h"
+
+#include <mpi.h>
+#include <functional>
+
+struct CommRequest {
+  CommRequest() : mpi(MPI_REQUEST_NULL) {}
+  MPI_Request mpi;
+};
+
+//The collectives among the data-parallel workers.
+//By default a worker is a process of MPI_COMM_WORLD.
+//The workers started by RunThreaded are the threads of one process
+//instead, each building and running its own session, and their collectives
+//go through shared memory without any MPI launcher.
+//The buffers of the threaded workers must be host memory,
+//and only the sum is supported for the reduction.
+class Communicator {
+ public:
+  //the communicator of the calling worker
+  static Communicator* Get();
+  //runs worker(rank) on size threads and waits for all of them
+  static void RunThreaded(int size, const std::function<void(int)>& worker);
+
+  virtual ~Communicator() {}
+  virtual bool IsThreaded() const = 0;
+  virtual int rank() const = 0;
+  virtual int size() const = 0;
+  virtual void AllReduce(const void* sendbuf, void* recvbuf,
+      int count, DataType type) = 0;
+  //in place, the threaded workers complete it before returning
+  virtual void IAllReduce(void* buf, int count, DataType type,
+      CommRequest* request) = 0;
+  virtual void Wait(CommRequest* request) = 0;
+  virtual void Bcast(void* buf, int count, DataType type, int root) = 0;
+  virtual void AllGather(const void* sendbuf, int sendcount,
+      void* recvbuf, int recvcount, DataType type) = 0;
+};
+
+#endif
@@ -0,0 +1,35 @@
+#include "cavs/util/communicator.h"
+#include "cavs/util/logging.h"
+
+#include <vector>
+
+using std::vector;
+
+int main() {
+  const int size = 4;
+  const int count = 1000;
+  Communicator::RunThreaded(size, [=](int rank) {
+    Communicator* comm = Communicator::Get();
+    CHECK(comm->IsThreaded());
+    CHECK(comm->rank() == rank);
+    CHECK(comm->size() == size);
+
+    vector<float> buf(count, rank+1);
+    comm->AllReduce(buf.data(), buf.data(), count, DT_FLOAT);
+    for (float v : buf)
+      CHECK(v == size*(size+1)/2) << v;
+
+    vector<float> root(count, (rank == 2) ? 7.f : 0.f);
+    comm->Bcast(root.data(), count, DT_FLOAT, 2);
+    for (float v : root)
+      CHECK(v == 7.f) << v;
+
+    int mine = rank*10;
+    vector<int> all(size);
+    comm->AllGather(&mine, 1, all.data(), 1, DT_INT32);
+    for (int r = 0; r < size; r++)
+      CHECK(all[r] == r*10) << all[r];
+  });
+  LOG(INFO) << "Threaded communicator passed";
+  return 0;
+}
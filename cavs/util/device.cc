@@ -0,0 +1,73 @@
+#include "cavs/util/device.h"
+#include "cavs/util/logging.h"
+
+#ifdef CAVS_WITH_CUDA
+#include "cavs/util/macros_gpu.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+DeviceType DeviceContext::KernelDeviceType() {
+#ifdef CAVS_WITH_CUDA
+  return GPU;
+#else
+  return CPU;
+#endif
+}
+
+void* DeviceContext::Malloc(size_t size, DeviceType type) {
+  void* ptr = NULL;
+  if (type == GPU) {
+#ifdef CAVS_WITH_CUDA
+    checkCudaError(cudaMalloc(&ptr, size));
+#else
+    LOG(FATAL) << "GPU memory requested in a build without CUDA";
+#endif
+  }else {
+    ptr = malloc(size);
+    CHECK_NOTNULL(ptr);
+  }
+  return ptr;
+}
+
+void DeviceContext::Free(void* ptr, DeviceType type) {
+  if (type == GPU) {
+#ifdef CAVS_WITH_CUDA
+    checkCudaError(cudaFree(ptr));
+#else
+    LOG(FATAL) << "GPU memory released in a build without CUDA";
+#endif
+  }else {
+    free(ptr);
+  }
+}
+
+void DeviceContext::Memcpy(void* dst, DeviceType dst_type,
+    const void* src, DeviceType src_type, size_t size) {
+#ifdef CAVS_WITH_CUDA
+  //cudaMemcpyDefault can remove such a complexity
+  //but for development, specified it clearly is better.
+  if (src_type == CPU && dst_type == GPU) {
+    checkCudaError(cudaMemcpy(dst, src, size, cudaMemcpyHostToDevice));
+  }else if (src_type == GPU && dst_type == CPU) {
+    checkCudaError(cudaMemcpy(dst, src, size, cudaMemcpyDeviceToHost));
+  }else if (src_type == CPU && dst_type == CPU) {
+    checkCudaError(cudaMemcpy(dst, src, size, cudaMemcpyHostToHost));
+  }else if (src_type == GPU && dst_type == GPU) {
+    checkCudaError(cudaMemcpy(dst, src, size, cudaMemcpyDeviceToDevice));
+  }else {
+    LOG(FATAL) << "which device on earth?";
+  }
+#else
+  CHECK(src_type == CPU && dst_type == CPU)
+      << "GPU tensors in a build without CUDA";
+  memcpy(dst, src, size);
+#endif
+}
+
+void DeviceContext::Synchronize() {
+#ifdef CAVS_WITH_CUDA
+  checkCudaError(cudaDeviceSynchronize());
+#endif
+}
@@ -0,0 +1,23 @@
+#ifndef CAVS_UTIL_DEVICE_H_
+#define CAVS_UTIL_DEVICE_H_
+
+#include "cavs/proto/devices.pb.h"
+
+#include <stddef.h>
+
+//device-specific primitives used by the midend.
+//the CUDA path is only compiled in with CAVS_WITH_CUDA,
+//otherwise every device maps onto the host.
+class DeviceContext {
+ public:
+  //the device the backend kernels run on by default
+  static DeviceType KernelDeviceType();
+  static void* Malloc(size_t size, DeviceType type);
+  static void Free(void* ptr, DeviceType type);
+  static void Memcpy(void* dst, DeviceType dst_type,
+                     const void* src, DeviceType src_type,
+                     size_t size);
+  static void Synchronize();
+};
+
+#endif
@@ -0,0 +1,84 @@
+#include "cavs/util/mapped_file.h"
+#include "cavs/util/logging.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+
+using std::string;
+
+MappedFile::MappedFile(const string& filename, size_t offset, size_t length)
+    : filename_(filename), map_(NULL), map_length_(0),
+      data_(NULL), length_(0) {
+  page_size_ = sysconf(_SC_PAGESIZE);
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0)
+    LOG(FATAL) << "file[" << filename << "] does not exists";
+  struct stat st;
+  CHECK(fstat(fd, &st) == 0) << filename << ": " << strerror(errno);
+  CHECK(offset <= (size_t)st.st_size) << filename << ": " << offset
+                                      << " beyond " << st.st_size;
+  if (length == 0)
+    length = st.st_size - offset;
+  CHECK(offset + length <= (size_t)st.st_size)
+    << filename << ": " << offset << "+" << length << " beyond " << st.st_size;
+  //mmap takes page-aligned offsets only
+  const size_t aligned = offset/page_size_*page_size_;
+  map_length_ = length + (offset - aligned);
+  if (map_length_ > 0) {
+    void* p = mmap(NULL, map_length_, PROT_READ, MAP_PRIVATE, fd, aligned);
+    CHECK(p != MAP_FAILED) << filename << ": " << strerror(errno);
+    map_ = static_cast<char*>(p);
+  }
+  close(fd);
+  data_ = map_ + (offset - aligned);
+  length_ = length;
+  VLOG(V_DEBUG) << "Mapped " << length_ << " Bytes of " << filename_
+                << " at offset " << offset;
+}
+
+MappedFile::~MappedFile() {
+  if (map_)  munmap(map_, map_length_);
+}
+
+void MappedFile::PageRange(size_t offset, size_t length,
+    char** begin, size_t* bytes) const {
+  offset = std::min(offset, length_);
+  length = std::min(length, length_ - offset);
+  char* b = const_cast<char*>(data_) + offset;
+  char* e = b + length;
+  //the first page may begin before data_, but not before map_
+  b = map_ + (b - map_)/page_size_*page_size_;
+  *begin = b;
+  *bytes = e - b;
+}
+
+void MappedFile::WillNeed(size_t offset, size_t length) const {
+  char* begin;
+  size_t bytes;
+  PageRange(offset, length, &begin, &bytes);
+  if (bytes > 0 && madvise(begin, bytes, MADV_WILLNEED) != 0)
+    VLOG(V_DEBUG) << filename_ << ": madvise " << strerror(errno);
+}
+
+void MappedFile::FaultIn(size_t offset, size_t length) const {
+  char* begin;
+  size_t bytes;
+  PageRange(offset, length, &begin, &bytes);
+  volatile char sink = 0;
+  for (size_t i = 0; i < bytes; i += page_size_)
+    sink += begin[i];
+  (void)sink;
+}
+
+void MappedFile::DontNeed(size_t offset, size_t length) const {
+  char* begin;
+  size_t bytes;
+  PageRange(offset, length, &begin, &bytes);
+  if (bytes > 0 && madvise(begin, bytes, MADV_DONTNEED) != 0)
+    VLOG(V_DEBUG) << filename_ << ": madvise " << strerror(errno);
+}
@@ -0,0 +1,40 @@
+#ifndef CAVS_UTIL_MAPPED_FILE_H_
+#define CAVS_UTIL_MAPPED_FILE_H_
+
+#include "cavs/util/macros.h"
+
+#include <stddef.h>
+#include <string>
+
+//A read-only, private mapping of [offset, offset+length) of a file.
+//The pages are loaded on demand, so opening a multi-gigabyte file
+//neither reads it nor makes it resident.
+//Writing into the mapping faults.
+class MappedFile {
+ public:
+  //length 0 maps up to the end of the file
+  MappedFile(const std::string& filename, size_t offset = 0, size_t length = 0);
+  ~MappedFile();
+  inline const char* data() const { return data_; }
+  inline size_t size() const { return length_; }
+  //asks the kernel to read the range ahead(asynchronously)
+  void WillNeed(size_t offset, size_t length) const;
+  //reads one byte of each page, so that the range is resident on return
+  void FaultIn(size_t offset, size_t length) const;
+  //the range is not needed in the near future
+  void DontNeed(size_t offset, size_t length) const;
+
+ private:
+  //clips the range to whole pages of the mapping
+  void PageRange(size_t offset, size_t length, char** begin, size_t* bytes) const;
+  std::string filename_;
+  char* map_;
+  size_t map_length_;
+  const char* data_;
+  size_t length_;
+  size_t page_size_;
+
+  DISALLOW_COPY_AND_ASSIGN(MappedFile);
+};
+
+#endif
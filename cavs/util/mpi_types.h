@@ -1,8 +1,22 @@
 #ifndef CAVS_UTIL_MPI_TYPES_H_
 #define CAVS_UTIL_MPI_TYPES_H_
 
+#include "cavs/util/logging.h"
+
 #include <mpi.h>
 
+#define checkMPIError(stmt)                            \
+  do {                                                 \
+    char err_buffer[MPI_MAX_ERROR_STRING];             \
+    int result_len;                                    \
+    int ierr = (stmt);                                 \
+    if (ierr != MPI_SUCCESS) {                         \
+      MPI_Error_string(ierr, err_buffer, &result_len); \
+      LOG(INFO) << err_buffer;                         \
+      MPI_Finalize();                                  \
+    }                                                  \
+  }while(0)
+
 template <class T>
 struct DataTypeToMPIType {
 
@@ -1,4 +1,5 @@
 #include "cavs/util/op_def_builder.h"
+#include "cavs/util/device.h"
 #include "cavs/util/logging.h"
 
 using std::string;
@@ -41,14 +42,18 @@ OpDefBuilder& OpDefBuilder::Output(const OpDef& def) {
 
 OpDefBuilder& OpDefBuilder::Device(const string& dev) {
   if (dev == "GPU")
-    op_def_.set_device(GPU);
+    op_def_.set_device(DeviceContext::KernelDeviceType());
   else 
     op_def_.set_device(CPU);
   return *this;
 }
 
 OpDefBuilder& OpDefBuilder::Device(const DeviceType type) {
-  op_def_.set_device(type);
+  //GPU ops fall back to the host in builds without CUDA
+  if (type == GPU)
+    op_def_.set_device(DeviceContext::KernelDeviceType());
+  else
+    op_def_.set_device(type);
   return *this;
 }
 
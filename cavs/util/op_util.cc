@@ -1,6 +1,8 @@
 #include "cavs/util/op_util.h"
 #include "cavs/util/logging.h"
 
+#include <stdio.h>
+#include <stdint.h>
 #include <functional>
 
 using std::string;
@@ -34,6 +36,18 @@ size_t GetHash(const OpDef& op_def) {
   return hash_fn(s);
 }
 
+string GetFingerprint(const string& s) {
+  //FNV-1a
+  uint64_t h = 14695981039346656037ULL;
+  for (unsigned char c : s) {
+    h ^= c;
+    h *= 1099511628211ULL;
+  }
+  char buf[17];
+  snprintf(buf, sizeof(buf), "%016llx", (unsigned long long)h);
+  return buf;
+}
+
 bool IsVariableName(const string& edge) {
   return (edge.length() >= 8 && edge.substr(0, 8) == "Variable")
       || (edge.length() >= 3 && edge.substr(0, 3) == "DDV" );
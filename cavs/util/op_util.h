@@ -19,6 +19,9 @@ std::string GetOriginName(const std::string& op);
 const char* DeviceTypeToString(DeviceType type);
 
 size_t GetHash(const OpDef& op_def);
+//hex digest that is stable across processes and builds,
+//GetHash relies on std::hash which is not
+std::string GetFingerprint(const std::string& s);
 
 bool IsVariableName(const std::string& edge);
 bool IsGradientName(const std::string& edge);
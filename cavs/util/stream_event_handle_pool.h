@@ -1,9 +1,16 @@
 #ifndef CAVS_UTIL_STREAM_EVENT_HANDLE_POOL_H_
 #define CAVS_UTIL_STREAM_EVENT_HANDLE_POOL_H_
 
+#ifdef CAVS_WITH_CUDA
 #include "cavs/util/macros_gpu.h"
+#else
+#include "cavs/util/logging.h"
+#endif
 
 #include <vector>
+#include <unordered_map>
+
+#ifdef CAVS_WITH_CUDA
 
 class StreamEventHandlePool {
  public:
@@ -53,6 +60,14 @@ class StreamEventHandlePool {
     else
       return NULL;
   }
+  static void WaitForEvent(int stream_id, int event_id) {
+    checkCudaError(cudaStreamWaitEvent(GetCudaStream(stream_id),
+                                       GetCudaEvent(event_id), 0));
+  }
+  static void RecordEvent(int event_id, int stream_id) {
+    checkCudaError(cudaEventRecord(GetCudaEvent(event_id),
+                                   GetCudaStream(stream_id)));
+  }
 
  private:
   static StreamEventHandlePool* Get() {
@@ -64,5 +79,34 @@ class StreamEventHandlePool {
   std::unordered_map<int, cublasHandle_t>  handle_pool_;
 };
 
+#else
+
+//host ops run synchronously in issue order,
+//so streams and events only keep their ids
+class StreamEventHandlePool {
+ public:
+  static int GenNewStreamID() { return Get()->num_streams_++; }
+  static int GenNewEventID() { return Get()->num_events_++; }
+  static void WaitForEvent(int stream_id, int event_id) {
+    CHECK(stream_id < Get()->num_streams_) << stream_id;
+    CHECK(event_id < Get()->num_events_) << event_id;
+  }
+  static void RecordEvent(int event_id, int stream_id) {
+    CHECK(stream_id < Get()->num_streams_) << stream_id;
+    CHECK(event_id < Get()->num_events_) << event_id;
+  }
+
+ private:
+  StreamEventHandlePool() : num_streams_(0), num_events_(0) {}
+  static StreamEventHandlePool* Get() {
+    static StreamEventHandlePool p; 
+    return &p;
+  }
+  int num_streams_;
+  int num_events_;
+};
+
+#endif
+
 #endif
 
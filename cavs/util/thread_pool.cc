@@ -0,0 +1,168 @@
+#include "cavs/util/thread_pool.h"
+#include "cavs/util/logging.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+
+using std::function;
+
+namespace {
+//the worker queue owned by the current thread, if any
+thread_local const ThreadPool* tls_pool = NULL;
+thread_local int tls_worker_id = -1;
+} //namespace
+
+ThreadPool::ThreadPool(int num_threads)
+    : pending_(0), next_queue_(0), stop_(false) {
+  CHECK(num_threads > 0);
+  for (int i = 0; i < num_threads-1; i++)
+    queues_.emplace_back(new TaskQueue());
+  for (int i = 0; i < num_threads-1; i++)
+    workers_.emplace_back(&ThreadPool::WorkerLoop, this, i);
+  VLOG(V_DEBUG) << "Thread pool started with " << num_threads << " threads";
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  for (auto& t : workers_)
+    t.join();
+}
+
+int ThreadPool::DefaultNumThreads() {
+  const char* env = getenv("CAVS_NUM_THREADS");
+  if (env && atoi(env) > 0)
+    return atoi(env);
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+bool ThreadPool::PopOrSteal(int id, function<void()>* task) {
+  const int n = queues_.size();
+  for (int i = 0; i < n; i++) {
+    TaskQueue* q = queues_[(id+i)%n].get();
+    std::lock_guard<std::mutex> lock(q->mu);
+    if (q->tasks.empty())
+      continue;
+    if (i == 0) {
+      *task = std::move(q->tasks.back());
+      q->tasks.pop_back();
+    }else {
+      *task = std::move(q->tasks.front());
+      q->tasks.pop_front();
+    }
+    pending_--;
+    return true;
+  }
+  return false;
+}
+
+void ThreadPool::WorkerLoop(int id) {
+  tls_pool = this;
+  tls_worker_id = id;
+  while (true) {
+    function<void()> task;
+    if (PopOrSteal(id, &task)) {
+      task();
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(mu_);
+    cv_.wait(lock, [this]{ return stop_ || pending_ > 0; });
+    if (stop_ && pending_ == 0)
+      return;
+  }
+}
+
+void ThreadPool::Schedule(function<void()> task) {
+  if (workers_.empty()) {
+    task();
+    return;
+  }
+  int id = (tls_pool == this) ? tls_worker_id
+                              : next_queue_++ % queues_.size();
+  {
+    TaskQueue* q = queues_[id].get();
+    std::lock_guard<std::mutex> lock(q->mu);
+    q->tasks.push_back(std::move(task));
+  }
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    pending_++;
+  }
+  cv_.notify_one();
+}
+
+void AsyncTask::RunOnce(const std::shared_ptr<State>& state) {
+  if (state->claimed.exchange(true))
+    return;
+  state->fn();
+  state->fn = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(state->mu);
+    state->done = true;
+  }
+  state->cv.notify_all();
+}
+
+void AsyncTask::Wait() const {
+  CHECK(state_);
+  RunOnce(state_);
+  std::unique_lock<std::mutex> lock(state_->mu);
+  state_->cv.wait(lock, [this]{ return state_->done; });
+}
+
+AsyncTask ThreadPool::Async(function<void()> task) {
+  AsyncTask ret;
+  ret.state_ = std::make_shared<AsyncTask::State>();
+  ret.state_->fn = std::move(task);
+  ret.state_->claimed = false;
+  ret.state_->done = false;
+  std::shared_ptr<AsyncTask::State> state = ret.state_;
+  Schedule([state]() { AsyncTask::RunOnce(state); });
+  return ret;
+}
+
+void ThreadPool::ParallelFor(int n, int grain,
+    const function<void(int, int)>& fn) {
+  if (n <= 0) return;
+  grain = std::max(grain, 1);
+  const int chunks = std::min(NumThreads(), (n+grain-1)/grain);
+  if (chunks <= 1) {
+    fn(0, n);
+    return;
+  }
+
+  //the state outlives this frame because late workers still touch it
+  struct State {
+    std::atomic<int> next;
+    std::atomic<int> done;
+    std::mutex mu;
+    std::condition_variable cv;
+  };
+  std::shared_ptr<State> state = std::make_shared<State>();
+  state->next = 0;
+  state->done = 0;
+  const function<void(int, int)>* body = &fn;
+  auto drain = [state, body, n, chunks]() {
+    int c;
+    while ((c = state->next++) < chunks) {
+      int begin = (int64_t)n*c/chunks;
+      int end   = (int64_t)n*(c+1)/chunks;
+      (*body)(begin, end);
+      if (++state->done == chunks) {
+        std::lock_guard<std::mutex> lock(state->mu);
+        state->cv.notify_all();
+      }
+    }
+  };
+  for (int i = 0; i < chunks-1; i++)
+    Schedule(drain);
+  drain();
+  std::unique_lock<std::mutex> lock(state->mu);
+  state->cv.wait(lock, [&state, chunks]{ return state->done == chunks; });
+}
@@ -0,0 +1,82 @@
+#ifndef CAVS_UTIL_THREAD_POOL_H_
+#define CAVS_UTIL_THREAD_POOL_H_
+
+#include "cavs/util/macros.h"
+
+#include <functional>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+
+class ThreadPool;
+
+//a task handed to the pool whose completion is awaited later.
+//Wait() runs it on the caller if no worker has started it yet,
+//so waiting from inside a worker can not deadlock.
+class AsyncTask {
+ public:
+  AsyncTask() {}
+  inline bool valid() const { return state_ != NULL; }
+  void Wait() const;
+
+ private:
+  friend class ThreadPool;
+  struct State {
+    std::function<void()> fn;
+    std::atomic<bool> claimed;
+    bool done;
+    std::mutex mu;
+    std::condition_variable cv;
+  };
+  static void RunOnce(const std::shared_ptr<State>& state);
+  std::shared_ptr<State> state_;
+};
+
+//process-wide pool backing the host kernels and the inter-op executor.
+//the size is taken from CAVS_NUM_THREADS, or the hardware concurrency.
+//every worker owns a deque: tasks scheduled from a worker go to its own
+//deque and are taken LIFO, idle workers steal FIFO from the others.
+class ThreadPool {
+ public:
+  static ThreadPool* Get() {
+    static ThreadPool pool(DefaultNumThreads());
+    return &pool;
+  }
+  ~ThreadPool();
+
+  //including the calling thread
+  inline int NumThreads() const { return workers_.size() + 1; }
+  void Schedule(std::function<void()> task);
+  AsyncTask Async(std::function<void()> task);
+  //splits [0, n) into contiguous chunks of at least grain items,
+  //runs them on the pool together with the calling thread and waits.
+  //the caller keeps draining chunks itself, so nesting is safe.
+  void ParallelFor(int n, int grain, const std::function<void(int, int)>& fn);
+
+ private:
+  explicit ThreadPool(int num_threads);
+  static int DefaultNumThreads();
+  void WorkerLoop(int id);
+  bool PopOrSteal(int id, std::function<void()>* task);
+
+  struct TaskQueue {
+    std::mutex mu;
+    std::deque<std::function<void()>> tasks;
+  };
+  std::vector<std::thread> workers_;
+  std::vector<std::unique_ptr<TaskQueue>> queues_;
+  //tasks pushed but not taken yet, guards the sleeping workers
+  std::atomic<int> pending_;
+  std::atomic<unsigned> next_queue_;
+  std::mutex mu_;
+  std::condition_variable cv_;
+  bool stop_;
+
+  DISALLOW_COPY_AND_ASSIGN(ThreadPool);
+};
+
+#endif
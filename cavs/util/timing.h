@@ -1,8 +1,13 @@
 #ifndef CAVS_UTIL_TIMING_H_
 #define CAVS_UTIL_TIMING_H_
 
+#ifdef CAVS_WITH_CUDA
 #include "cavs/util/macros_gpu.h"
+#else
+#include "cavs/util/logging.h"
+#endif
 
+#include <chrono>
 #include <unordered_map>
 #include <string>
 #include <utility>
@@ -17,22 +22,29 @@ class Timing {
       Get()->status_[name] = true;
     }
 
+#ifdef CAVS_WITH_CUDA
     if (Get()->event_.find(name) == Get()->event_.end()) {
       cudaEvent_t start, stop;
       checkCudaError(cudaEventCreate(&start));
       checkCudaError(cudaEventCreate(&stop));
       Get()->event_[name] = std::make_pair(start, stop);
     }
+#endif
 
     if (Get()->time_in_ms_.find(name) == Get()->time_in_ms_.end())
       Get()->time_in_ms_[name] = 0;
+#ifdef CAVS_WITH_CUDA
     cudaEvent_t start = Get()->event_[name].first;
     checkCudaError(cudaEventRecord(start));
+#else
+    Get()->start_[name] = std::chrono::steady_clock::now();
+#endif
   }
   static void TimingEnd(const std::string& name) {
     CHECK(Get()->status_.find(name) != Get()->status_.end());
     CHECK(Get()->status_[name]);
     Get()->status_[name] = false;
+#ifdef CAVS_WITH_CUDA
     CHECK(Get()->event_.find(name) != Get()->event_.end());
     cudaEvent_t start = Get()->event_[name].first;
     cudaEvent_t stop = Get()->event_[name].second;
@@ -42,6 +54,11 @@ class Timing {
     checkCudaError(cudaEventSynchronize(stop));
     float ms = 0;
     checkCudaError(cudaEventElapsedTime(&ms, start, stop));
+#else
+    CHECK(Get()->start_.find(name) != Get()->start_.end());
+    float ms = std::chrono::duration<float, std::milli>(
+        std::chrono::steady_clock::now() - Get()->start_[name]).count();
+#endif
     CHECK(Get()->time_in_ms_.find(name) != Get()->time_in_ms_.end());
     Get()->time_in_ms_[name] += ms;
   }
@@ -61,7 +78,12 @@ class Timing {
     return &t;
   }
   std::unordered_map<std::string, bool> status_;//0 null; 1:timing
+#ifdef CAVS_WITH_CUDA
   std::unordered_map<std::string, std::pair<cudaEvent_t, cudaEvent_t>> event_;
+#else
+  std::unordered_map<std::string,
+                     std::chrono::steady_clock::time_point> start_;
+#endif
   std::unordered_map<std::string, float> time_in_ms_;
 
 };